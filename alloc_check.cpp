@@ -0,0 +1,347 @@
+// Allocation check of the frame path. A stream like the one protocol_soak's
+// synthetic backend sends (camera frames in every pixel format, recognition
+// results, a LiDAR sweep and telemetry, at a fixed geometry per channel) is
+// fed through ProtocolParser in socket-sized reads and decoded as
+// ControlApp::decodeFrame does it: pooled pyramid, pixel kernel, recognition
+// overlay, the level the tile shows and the hand-off that replaces the tile's
+// previous frame. After the warm-up passes, operator new must not be called
+// again on any thread.
+//
+//   alloc_check [--passes N] [--width W] [--height H]
+//
+// Each allocation is put down to its innermost caller outside the C++ runtime.
+// OpenCV keeps some bookkeeping of its own on the heap (a job per threaded
+// parallel_for_, drawing scratch); those are reported, not failed. Exits
+// non-zero if anything else allocated, listing where.
+#include "alloc_counter.hpp"
+#include "frame_hash.hpp"
+#include "frame_pool.hpp"
+#include "frame_pyramid.hpp"
+#include "lidar_bev.hpp"
+#include "memory_governor.hpp"
+#include "pixel_formats.hpp"
+#include "protocol_parser.hpp"
+#include "recognition_overlay.hpp"
+#include "synthetic_stream.hpp"
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr int kWarmUpPasses = 3;
+    constexpr size_t kReadBytes = 64 * 1024;  // what one socket read hands the parser
+    constexpr int kTileWidth = 640;
+    constexpr int kTileHeight = 360;
+    constexpr uint32_t kLidarPoints = 64 * 1024;
+    constexpr uint32_t kObjects = 16;
+    constexpr size_t kChannels = static_cast<size_t>(eSensorChannel::CHANNEL_MAX);
+
+    // Where the allocations seen while measuring came from
+    constexpr size_t kMaxSites = 64;
+    std::atomic<uint64_t> libraryAllocations{0};
+    std::atomic<uint64_t> ownAllocations{0};
+    std::array<std::atomic<void*>, kMaxSites> ownSites{};
+    std::array<std::atomic<uint64_t>, kMaxSites> ownSiteCounts{};
+
+    bool runtimeObject(const char* path) {
+        for (const char* name : {"libstdc++", "libc.so", "libc-", "libgcc_s", "ld-linux"}) {
+            if (std::strstr(path, name)) return true;
+        }
+        return false;
+    }
+
+    bool libraryObject(const char* path) {
+        for (const char* name : {"libopencv", "libtbb", "libgomp", "libippicv"}) {
+            if (std::strstr(path, name)) return true;
+        }
+        return false;
+    }
+
+    void recordSite(void* site) {
+        for (size_t i = 0; i < kMaxSites; ++i) {
+            void* expected = nullptr;
+            if (ownSites[i].compare_exchange_strong(expected, site) || expected == site) {
+                ownSiteCounts[i].fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    // Runs inside operator new, so it must not allocate with it; backtrace and
+    // dladdr only use malloc. Frame 0 is this function.
+    void attribute(std::size_t) {
+        void* frames[32];
+        int depth = backtrace(frames, 32);
+        void* newAddress = reinterpret_cast<void*>(static_cast<void* (*)(std::size_t)>(&::operator new));
+        for (int i = 1; i < depth; ++i) {
+            Dl_info info;
+            if (!dladdr(frames[i], &info) || !info.dli_fname) continue;
+            if (info.dli_saddr == newAddress || runtimeObject(info.dli_fname)) continue;
+            if (libraryObject(info.dli_fname)) {
+                libraryAllocations.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            ownAllocations.fetch_add(1, std::memory_order_relaxed);
+            recordSite(frames[i]);
+            return;
+        }
+        ownAllocations.fetch_add(1, std::memory_order_relaxed);
+        recordSite(nullptr);
+    }
+
+    std::string describe(void* site) {
+        Dl_info info;
+        if (!site || !dladdr(site, &info) || !info.dli_fname) return "unknown caller";
+        std::string name = "?";
+        if (info.dli_sname) {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            name = status == 0 ? demangled : info.dli_sname;
+            std::free(demangled);
+        }
+        char where[64];
+        std::snprintf(where, sizeof(where), " (%s+0x%zx)", std::strrchr(info.dli_fname, '/') ?
+            std::strrchr(info.dli_fname, '/') + 1 : info.dli_fname,
+            static_cast<size_t>(static_cast<char*>(site) - static_cast<char*>(info.dli_fbase)));
+        return name + where;
+    }
+
+    // One pass of the synthetic stream; every pass sends the same bytes
+    std::vector<char> buildStream(int width, int height) {
+        std::mt19937 random(2024);
+        std::vector<char> stream;
+        uint64_t sequence = 0;
+        uint64_t timestamp = 1000;
+        auto append = [&](stDataSensorReqMsg sensor, const void* payload) {
+            std::string head = synthetic_stream::encodeSensorHead(sequence++, sensor);
+            stream.insert(stream.end(), head.begin(), head.end());
+            const char* bytes = static_cast<const char*>(payload);
+            stream.insert(stream.end(), bytes, bytes + sensor.mPayloadSize);
+        };
+
+        for (size_t i = 0; i < synthetic_stream::kFormats.size(); ++i) {
+            const auto& format = synthetic_stream::kFormats[i];
+            stDataSensorReqMsg sensor{};
+            sensor.mTotalNumber = 1;
+            sensor.mFrameNumber = static_cast<uint32_t>(sequence);
+            sensor.mTimestamp = timestamp;
+            sensor.mChannel = static_cast<uint8_t>(i);
+
+            // Results for the frame that follows, so the overlay draws on it
+            std::vector<stRecognitionObject> objects(kObjects);
+            for (auto& object : objects) {
+                object.mX = static_cast<float>(random() % width);
+                object.mY = static_cast<float>(random() % height);
+                object.mWidth = static_cast<float>(16 + random() % 128);
+                object.mHeight = static_cast<float>(16 + random() % 128);
+                object.mScore = static_cast<float>(random() % 100) / 100.0f;
+                object.mClassId = static_cast<uint16_t>(random() % 8);
+                object.mTrackId = static_cast<uint16_t>(random());
+            }
+            sensor.mSensorType = 3;
+            sensor.mNumPoints = kObjects;
+            sensor.mPayloadSize = kObjects * sizeof(stRecognitionObject);
+            append(sensor, objects.data());
+
+            sensor.mSensorType = 1;
+            sensor.mImgWidth = static_cast<uint16_t>(width);
+            sensor.mImgHeight = static_cast<uint16_t>(height);
+            sensor.mImgFormat = static_cast<uint8_t>(format.format);
+            sensor.mImgDepth = format.depth;
+            sensor.mNumPoints = 0;
+            sensor.mPayloadSize = static_cast<uint32_t>(expectedPayloadSize(sensor.mImgFormat, sensor.mImgDepth,
+                width, height));
+            std::vector<uint8_t> image(sensor.mPayloadSize);
+            for (auto& byte : image) byte = static_cast<uint8_t>(random());
+            append(sensor, image.data());
+        }
+
+        stDataSensorReqMsg sweep{};
+        sweep.mTotalNumber = 1;
+        sweep.mTimestamp = timestamp;
+        sweep.mSensorType = 2;
+        sweep.mChannel = static_cast<uint8_t>(eSensorChannel::LIDAR_ROOF_CENTER);
+        sweep.mNumPoints = kLidarPoints;
+        sweep.mPayloadSize = kLidarPoints * sizeof(stLidarPoint);
+        std::uniform_real_distribution<float> across(-60.0f, 60.0f), up(-3.0f, 5.0f), intensity(0.0f, 255.0f);
+        std::vector<stLidarPoint> points(kLidarPoints);
+        for (auto& point : points) point = {across(random), across(random), up(random), intensity(random)};
+        append(sweep, points.data());
+
+        stDataSensorReqMsg resource{};
+        resource.mTotalNumber = 1;
+        resource.mSensorType = 4;
+        resource.mPayloadSize = sizeof(stResourceInfo);
+        stResourceInfo info{12.5f, 2048.0f, 100.0f, 55.0f, 0};
+        append(resource, &info);
+        return stream;
+    }
+
+    // ControlApp's decode stage and the viewer's hand-off, without the widgets
+    class FramePath {
+    public:
+        FramePath() :
+            framesBudget(MemoryGovernor::instance().registerBudget("frames", 256u << 20)) {
+            lidarBev.prepare();
+        }
+
+        bool feed(const std::vector<char>& stream) {
+            size_t offset = 0;
+            while (offset < stream.size()) {
+                auto span = parser.prepare();
+                size_t bytes = std::min({span.size, kReadBytes, stream.size() - offset});
+                std::memcpy(span.data, stream.data() + offset, bytes);
+                offset += bytes;
+                auto result = parser.commit(bytes);
+                if (result == ProtocolParser::Malformed) {
+                    std::fprintf(stderr, "[ALLOC] synthetic stream rejected: %s\n", parser.error());
+                    return false;
+                }
+                if (result == ProtocolParser::Complete && parser.hasSensorMessage()) {
+                    dispatch();
+                }
+            }
+            return true;
+        }
+
+        uint64_t frames = 0;
+        uint64_t refused = 0;  // turned away by the memory governor, so not decoded
+
+    private:
+        void dispatch() {
+            const stDataSensorReqMsg& sensor = parser.sensorMessage();
+            auto payload = parser.takePayload();
+            if (!payload) {
+                ++refused;
+                return;
+            }
+            const char* data = payload.get();
+            ++frames;
+            if (sensor.mSensorType == 1) {
+                hashes ^= hashPayload(data, sensor.mPayloadSize);
+                decodeCamera(sensor, data);
+            } else if (sensor.mSensorType == 2) {
+                size_t bytes = static_cast<size_t>(LidarBevRasterizer::kGridSize) * LidarBevRasterizer::kGridSize * 3 * 4 / 3;
+                if (!MemoryGovernor::instance().acquire(framesBudget, sensor.mChannel, bytes)) {
+                    ++refused;
+                    return;
+                }
+                auto pyramid = pyramidPools[sensor.mChannel].acquire();
+                lidarBev.addSweep(sensor.mChannel, reinterpret_cast<const stLidarPoint*>(data), sensor.mNumPoints,
+                    pyramid->base());
+                handOff(sensor.mChannel, std::move(pyramid), bytes);
+            } else if (sensor.mSensorType == 3) {
+                recognition.addResults(sensor.mChannel, sensor.mTimestamp,
+                    reinterpret_cast<const stRecognitionObject*>(data), sensor.mNumPoints);
+            }
+        }
+
+        void decodeCamera(const stDataSensorReqMsg& sensor, const char* data) {
+            int width = sensor.mImgWidth;
+            int height = sensor.mImgHeight;
+            const PixelKernel* kernel = findPixelKernel(sensor.mImgFormat, sensor.mImgDepth);
+            cv::Size output = kernel->outputSize(width, height);
+            size_t bytes = static_cast<size_t>(output.width) * output.height * 3 * 4 / 3;
+            if (!MemoryGovernor::instance().acquire(framesBudget, sensor.mChannel, bytes)) {
+                ++refused;
+                return;
+            }
+            auto pyramid = pyramidPools[sensor.mChannel].acquire();
+            cv::Mat& bgr = pyramid->base();
+            kernel->convert(reinterpret_cast<const uint8_t*>(data), width, height, bgr);
+            pyramid->sensorSize = cv::Size(width, height);
+            pyramid->region = cv::Rect(0, 0, width, height);
+            recognition.draw(sensor.mChannel, sensor.mTimestamp, bgr,
+                static_cast<float>(output.width) / width, static_cast<float>(output.height) / height);
+            handOff(sensor.mChannel, std::move(pyramid), bytes);
+        }
+
+        // publishFrame builds the level the tile shows; the viewer then lets go
+        // of the frame the tile showed before, which returns to its pool
+        void handOff(uint8_t channel, std::shared_ptr<FramePyramid> pyramid, size_t bytes) {
+            pyramid->rebuild();
+            pyramid->budgetBytes = bytes;
+            pyramid->fit(kTileWidth, kTileHeight);
+            pyramid.swap(shown[channel]);
+            if (pyramid) {
+                MemoryGovernor::instance().release(framesBudget, pyramid->budgetBytes);
+            }
+        }
+
+        FramePool payloadPool{"reassembly", 256u << 20};
+        ReceiveStats stats;
+        ProtocolParser parser{payloadPool, stats};
+        int framesBudget;
+        std::array<FramePyramidPool, kChannels> pyramidPools;
+        std::array<std::shared_ptr<FramePyramid>, kChannels> shown;
+        LidarBevRasterizer lidarBev;
+        RecognitionOverlay recognition;
+        uint64_t hashes = 0;
+    };
+}
+
+int main(int argc, char** argv) {
+    int passes = 5;
+    int width = 1280;
+    int height = 720;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--passes") passes = std::atoi(argv[i + 1]);
+        else if (flag == "--width") width = std::atoi(argv[i + 1]);
+        else if (flag == "--height") height = std::atoi(argv[i + 1]);
+        else {
+            std::fprintf(stderr, "usage: %s [--passes N] [--width W] [--height H]\n", argv[0]);
+            return 2;
+        }
+    }
+    // Every layout needs whole 2x2 sample groups
+    width = std::max(2, std::min<int>(width, kMaxImageDimension) & ~1);
+    height = std::max(2, std::min<int>(height, kMaxImageDimension) & ~1);
+    passes = std::max(1, passes);
+
+    std::vector<char> stream = buildStream(width, height);
+    FramePath path;
+    // Pools, pyramids, scratch buffers and OpenCV's thread pool settle here
+    for (int pass = 0; pass < kWarmUpPasses; ++pass) {
+        if (!path.feed(stream)) return 1;
+    }
+    uint64_t warmFrames = path.frames;
+
+    void* frames[4];
+    backtrace(frames, 4);  // loads the unwinder before it is needed inside operator new
+    uint64_t before = AllocCounter::allocations();
+    AllocCounter::setObserver(&attribute);
+    bool parsed = true;
+    for (int pass = 0; pass < passes && parsed; ++pass) {
+        parsed = path.feed(stream);
+    }
+    AllocCounter::setObserver(nullptr);
+    uint64_t counted = AllocCounter::allocations() - before;
+
+    uint64_t own = ownAllocations.load();
+    uint64_t library = libraryAllocations.load();
+    for (size_t i = 0; i < kMaxSites; ++i) {
+        uint64_t count = ownSiteCounts[i].load();
+        if (count == 0) continue;
+        std::printf("[ALLOC]   %6llu x %s\n", static_cast<unsigned long long>(count),
+            describe(ownSites[i].load()).c_str());
+    }
+    bool ok = parsed && own == 0;
+    std::printf("[ALLOC] %d passes, %llu frames at %dx%d: %llu allocations on the frame path, %llu inside OpenCV "
+                "(%llu counted), %llu refused by the governor: %s\n",
+        passes, static_cast<unsigned long long>(path.frames - warmFrames), width, height,
+        static_cast<unsigned long long>(own), static_cast<unsigned long long>(library),
+        static_cast<unsigned long long>(counted), static_cast<unsigned long long>(path.refused),
+        ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
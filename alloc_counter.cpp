@@ -0,0 +1,25 @@
+#include "alloc_counter.hpp"
+#include <cstdlib>
+#include <new>
+
+thread_local int AllocCounter::depth = 0;
+std::atomic<uint64_t> AllocCounter::count{0};
+std::atomic<AllocCounter::Observer> AllocCounter::observer{nullptr};
+
+// The array and nothrow forms forward here; the default operator delete frees
+// with std::free, which matches the malloc below
+void* operator new(std::size_t size) {
+    AllocCounter::onAllocate(size);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Counts heap allocations made while a thread is inside the frame path.
+// Global operator new is replaced for the whole program; outside a FrameScope
+// it costs one thread-local read. OpenCV image buffers come from cv::fastMalloc
+// and are not seen here; the frame path keeps those in FramePyramidPool instead.
+class AllocCounter {
+public:
+    // Receive, decode and hand-off of one frame, or a refresh tick painting
+    // the tiles, on the calling thread
+    class FrameScope {
+    public:
+        FrameScope() { ++depth; }
+        ~FrameScope() { --depth; }
+        FrameScope(const FrameScope&) = delete;
+        FrameScope& operator=(const FrameScope&) = delete;
+    };
+
+    // Sees the size of every counted allocation. While one is set, allocations
+    // on every thread are counted, so work OpenCV hands to its pool threads is
+    // seen too; for alloc_check, which attributes them to their callers
+    using Observer = void (*)(std::size_t bytes);
+    static void setObserver(Observer next) { observer.store(next, std::memory_order_relaxed); }
+
+    static uint64_t allocations() { return count.load(std::memory_order_relaxed); }
+    static void onAllocate(std::size_t bytes) {
+        Observer current = observer.load(std::memory_order_relaxed);
+        if (depth > 0 || current) {
+            count.fetch_add(1, std::memory_order_relaxed);
+            if (current) current(bytes);
+        }
+    }
+
+private:
+    static thread_local int depth;
+    static std::atomic<uint64_t> count;
+    static std::atomic<Observer> observer;
+};
@@ -0,0 +1,91 @@
+#include "app_style.hpp"
+#include <QtWidgets/QStyle>
+
+QString app_style::sheet() {
+    return QStringLiteral(
+        "ControlApp QGroupBox {"
+        "    font-size: 32px;"
+        "    font-weight: bold;"
+        "    margin-top: 1ex;"
+        "}"
+        "ControlApp QGroupBox::title {"
+        "    subcontrol-origin: margin;"
+        "    subcontrol-position: top center;"
+        "    padding: 0 3px;"
+        "}"
+        "ControlApp QLabel {"
+        "    font-size: 32px;"
+        "}"
+        "ControlApp QLabel[role=\"status\"] {"
+        "    font-size: 24px;"
+        "}"
+        "ControlApp QLabel[role=\"detail\"] {"
+        "    font-size: 20px;"
+        "}"
+        "QLabel[link=\"up\"] {"
+        "    color: green;"
+        "}"
+        "QLabel[link=\"down\"] {"
+        "    color: red;"
+        "}"
+        "QLabel[link=\"degraded\"] {"
+        "    color: orange;"
+        "}"
+        "ControlApp QLineEdit {"
+        "    font-size: 32px;"
+        "    padding: 5px;"
+        "    border: 1px solid #999;"
+        "    border-radius: 3px;"
+        "}"
+        "ControlApp QLineEdit:focus {"
+        "    border: 2px solid #008CBA;"
+        "}"
+        "ControlApp QPushButton {"
+        "    font-size: 32px;"
+        "    padding: 5px;"
+        "}"
+        "ControlApp QPushButton[role=\"playback\"] {"
+        "    font-size: 24px;"
+        "}"
+        "QPushButton[role=\"primary\"], QPushButton[role=\"start\"], QPushButton[role=\"stop\"] {"
+        "    font-weight: bold;"
+        "    color: white;"
+        "    border-radius: 5px;"
+        "}"
+        "QPushButton[role=\"primary\"] {"
+        "    background-color: #008CBA;"
+        "}"
+        "QPushButton[role=\"primary\"]:hover {"
+        "    background-color: #007399;"
+        "}"
+        "QPushButton[role=\"primary\"]:disabled {"
+        "    background-color: #cccccc;"
+        "    color: #666666;"
+        "}"
+        "QPushButton[role=\"start\"] {"
+        "    background-color: #4CAF50;"
+        "}"
+        "QPushButton[role=\"start\"]:hover {"
+        "    background-color: #45a049;"
+        "}"
+        "QPushButton[role=\"stop\"] {"
+        "    background-color: #ff9999;"
+        "}"
+        "QPushButton[role=\"stop\"]:hover {"
+        "    background-color: #ff8080;"
+        "}"
+        "ImageViewer QLabel {"
+        "    background-color: black;"
+        "}"
+        "ImageViewer QLabel[stalled=\"true\"] {"
+        "    border: 3px solid red;"
+        "}"
+    );
+}
+
+void app_style::setState(QWidget* widget, const char* property, const QVariant& value) {
+    if (widget->property(property) == value) return;
+    widget->setProperty(property, value);
+    widget->style()->unpolish(widget);
+    widget->style()->polish(widget);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <QtCore/QString>
+#include <QtCore/QVariant>
+#include <QtWidgets/QWidget>
+
+// The application's only style sheet, set once on QApplication. Widgets do not
+// carry their own sheets; they set a role or state property that the rules
+// select on, so a state change re-matches rules instead of parsing CSS again.
+namespace app_style {
+    QString sheet();
+    // Sets a state property and re-polishes the widget; a no-op if unchanged
+    void setState(QWidget* widget, const char* property, const QVariant& value);
+}
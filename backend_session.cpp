@@ -0,0 +1,305 @@
+#include "backend_session.hpp"
+#include "tcp_client.hpp"
+#include "trace.hpp"
+#include <boost/archive/text_iarchive.hpp>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+using boost::asio::ip::tcp;
+using boost::system::error_code;
+
+namespace {
+    constexpr auto kReconnectDelay = std::chrono::milliseconds(1000);
+    // A lost heartbeat re-links at once; if the backend is still gone, the failed
+    // connect falls back to kReconnectDelay
+    constexpr auto kRelinkDelay = std::chrono::milliseconds(0);
+}
+
+BackendSession::BackendSession(TcpClient& client, Backend& backend, size_t index, boost::asio::io_context& io) :
+    client(client), backendRef(backend), backendIndex(index),
+    strand(boost::asio::make_strand(io)), timer(strand), heartbeatTimer(strand),
+    host(backend.host), dataPort(backend.ports[0]), controlPort(backend.ports[1]) {
+    const auto& specs = client.getStreamSpecs();
+    for (size_t i = 0; i < specs.size(); ++i) {
+        streams.push_back(std::make_shared<DataStream>(client, backend, index, specs[i], i == 0, io));
+    }
+}
+
+void BackendSession::start() {
+    boost::asio::post(strand, [self = shared_from_this()]() {
+        if (self->running) return;
+        self->running = true;
+        self->connect();
+    });
+}
+
+void BackendSession::stop() {
+    boost::asio::post(strand, [self = shared_from_this()]() {
+        self->running = false;
+        ++self->generation;
+        self->timer.cancel();
+        self->closeConnections();
+    });
+}
+
+void BackendSession::reconfigure(const std::string& newHost, uint16_t newDataPort, uint16_t newControlPort) {
+    boost::asio::post(strand, [self = shared_from_this(), newHost, newDataPort, newControlPort]() {
+        self->host = newHost;
+        self->dataPort = newDataPort;
+        self->controlPort = newControlPort;
+        if (self->running) {
+            self->closeConnections();
+            self->connect();
+        }
+    });
+}
+
+void BackendSession::sendDataRequest() {
+    for (auto& stream : streams) {
+        stream->requestData();
+    }
+}
+
+void BackendSession::sendCommand(std::shared_ptr<const std::string> frame, SentHandler onSent) {
+    boost::asio::post(strand, [self = shared_from_this(), frame, onSent]() {
+        auto& socket = self->backendRef.sockets[1];
+        if (!socket || !socket->is_open()) {
+            onSent(false);
+            return;
+        }
+        self->queueWrite(frame, onSent);
+    });
+}
+
+void BackendSession::connect() {
+    uint64_t gen = ++generation;
+    startStream(0, gen);
+}
+
+void BackendSession::startStream(size_t streamIdx, uint64_t gen) {
+    std::weak_ptr<BackendSession> weak = shared_from_this();
+    auto onFail = [weak, streamIdx, gen](const std::string& reason) {
+        if (auto self = weak.lock()) {
+            boost::asio::post(self->strand, [self, streamIdx, gen, reason]() {
+                self->onStreamFailed(streamIdx, gen, reason);
+            });
+        }
+    };
+    DataStream::StreamingHandler onStreaming;
+    if (streamIdx == 0) {
+        onStreaming = [weak, gen]() {
+            if (auto self = weak.lock()) {
+                boost::asio::post(self->strand, [self, gen]() { self->onPrimaryStreaming(gen); });
+            }
+        };
+    }
+    streams[streamIdx]->start(host, dataPort, onFail, onStreaming);
+}
+
+void BackendSession::onPrimaryStreaming(uint64_t gen) {
+    if (gen != generation) return;
+    connectControl(gen);
+    for (size_t i = 1; i < streams.size(); ++i) {
+        startStream(i, gen);
+    }
+}
+
+void BackendSession::onStreamFailed(size_t streamIdx, uint64_t gen, const std::string& reason) {
+    if (gen != generation) return;
+    if (streamIdx == 0) {
+        fail(reason, kReconnectDelay);
+        return;
+    }
+
+    // A side stream retries alone; the primary stream and the others keep running
+    std::cerr << "Error with " << backendRef.name << " (" << streams[streamIdx]->spec().name
+              << "): " << reason << std::endl;
+    auto retry = std::make_shared<boost::asio::steady_timer>(strand, kReconnectDelay);
+    retry->async_wait([self = shared_from_this(), retry, streamIdx, gen](const error_code& error) {
+        if (error || gen != self->generation || !self->running) return;
+        self->startStream(streamIdx, gen);
+    });
+}
+
+void BackendSession::connectControl(uint64_t gen) {
+    auto socket = std::make_shared<tcp::socket>(strand);
+    backendRef.sockets[1] = socket;
+    tcp::endpoint endpoint(boost::asio::ip::make_address(host), controlPort);
+    socket->async_connect(endpoint, [self = shared_from_this(), gen](const error_code& error) {
+        if (gen != self->generation) return;
+        if (error) {
+            // Streaming works without the control port; only commands are unavailable
+            std::cerr << "Error connecting to second port of " << self->backendRef.name
+                      << ": " << error.message() << std::endl;
+            return;
+        }
+        std::string frame;
+        uint64_t sequenceNumber;
+        if (self->client.serializeLoggingMessage(MessageType::CONFIG_INFO, frame, sequenceNumber)) {
+            self->queueWrite(std::make_shared<const std::string>(std::move(frame)));
+        }
+        self->readControl(gen);
+        self->startHeartbeat(gen);
+    });
+}
+
+void BackendSession::startHeartbeat(uint64_t gen) {
+    beatsInFlight.clear();
+    beatAcked = false;
+    beatsUnsupported = false;
+    beat(gen);
+}
+
+// A LINK on the control port is acked like any command; its round trip is the
+// link's RTT. Too many unanswered beats mean the backend or the cable is gone,
+// long before a read on an idle socket would fail. Only a backend that has
+// answered a beat on this link is held to that; one that never acks them keeps
+// streaming and is only probed.
+void BackendSession::beat(uint64_t gen) {
+    if (gen != generation || !running) return;
+    const HeartbeatConfig& config = client.getHeartbeatConfig();
+    LinkHealth& health = client.getLinkHealth(backendIndex);
+    if (beatsInFlight.size() >= config.misses && !beatAcked) {
+        if (!beatsUnsupported) {
+            std::cerr << "[HEARTBEAT] " << backendRef.name << ": no beat answered yet, "
+                      << "not checking liveness until one is" << std::endl;
+            beatsUnsupported = true;
+        }
+        beatsInFlight.pop_front();
+    } else if (beatsInFlight.size() >= config.misses) {
+        health.alive = false;
+        health.linksLost.fetch_add(1, std::memory_order_relaxed);
+        std::cerr << "[HEARTBEAT] " << backendRef.name << ": " << beatsInFlight.size()
+                  << " beats unanswered, re-linking" << std::endl;
+        fail("heartbeat lost", kRelinkDelay);
+        return;
+    }
+
+    std::string frame;
+    uint64_t sequenceNumber;
+    if (client.serializeHeartbeat(frame, sequenceNumber)) {
+        beatsInFlight.emplace_back(sequenceNumber, Tracer::now());
+        health.beatsSent.fetch_add(1, std::memory_order_relaxed);
+        queueWrite(std::make_shared<const std::string>(std::move(frame)));
+    }
+    heartbeatTimer.expires_after(config.interval);
+    heartbeatTimer.async_wait([self = shared_from_this(), gen](const error_code& error) {
+        if (error) return;
+        self->beat(gen);
+    });
+}
+
+bool BackendSession::onBeatAnswered(uint64_t sequenceNumber) {
+    auto answered = std::find_if(beatsInFlight.begin(), beatsInFlight.end(),
+        [sequenceNumber](const auto& inFlight) { return inFlight.first == sequenceNumber; });
+    if (answered == beatsInFlight.end()) return false;
+
+    uint64_t rttNs = Tracer::now() - answered->second;
+    LinkHealth& health = client.getLinkHealth(backendIndex);
+    health.rtt.add(rttNs);
+    health.lastRttNs.store(rttNs, std::memory_order_relaxed);
+    health.beatsAnswered.fetch_add(1, std::memory_order_relaxed);
+    health.alive = true;
+    beatAcked = true;
+    // An answer also vouches for the link while the older beats were out
+    beatsInFlight.erase(beatsInFlight.begin(), answered + 1);
+    return true;
+}
+
+// Acks come back on the control port framed like our commands: an 8-digit
+// hex length followed by a text-archived Header echoing the sequence number.
+void BackendSession::readControl(uint64_t gen) {
+    auto& socket = *backendRef.sockets[1];
+    boost::asio::async_read(socket, boost::asio::buffer(controlHeader),
+        [self = shared_from_this(), gen](const error_code& error, std::size_t) {
+            if (gen != self->generation || error) return;
+            size_t length = 0;
+            std::istringstream lengthStream(std::string(self->controlHeader.data(), header_length));
+            if (!(lengthStream >> std::hex >> length) || length == 0 || length > kMaxBodyLength) {
+                std::cerr << "Invalid ACK length from " << self->backendRef.name << std::endl;
+                error_code ignored;
+                self->backendRef.sockets[1]->close(ignored);
+                return;
+            }
+            self->controlBody.resize(length);
+            boost::asio::async_read(*self->backendRef.sockets[1], boost::asio::buffer(self->controlBody),
+                [self, gen](const error_code& error, std::size_t) {
+                    if (gen != self->generation || error) return;
+                    Header ack{};
+                    try {
+                        std::istringstream archiveStream(self->controlBody);
+                        boost::archive::text_iarchive archive(archiveStream);
+                        archive >> ack;
+                        if (!self->onBeatAnswered(ack.sequenceNumber)) {
+                            self->client.handleAck(self->backendIndex, ack.sequenceNumber);
+                        }
+                    } catch (const std::exception& e) {
+                        std::cerr << "Invalid ACK body from " << self->backendRef.name << ": " << e.what() << std::endl;
+                    }
+                    self->readControl(gen);
+                });
+        });
+}
+
+void BackendSession::queueWrite(Buffer data, SentHandler onSent) {
+    controlQueue.push_back(PendingWrite{std::move(data), std::move(onSent)});
+    if (controlQueue.size() == 1) {
+        writeNext(generation);
+    }
+}
+
+void BackendSession::writeNext(uint64_t gen) {
+    auto& socket = backendRef.sockets[1];
+    if (controlQueue.empty()) return;
+    if (!socket || !socket->is_open()) {
+        for (auto& pending : controlQueue) {
+            if (pending.onSent) pending.onSent(false);
+        }
+        controlQueue.clear();
+        return;
+    }
+
+    Buffer data = controlQueue.front().data;
+    boost::asio::async_write(*socket, boost::asio::buffer(*data),
+        [self = shared_from_this(), gen, data](const error_code& error, std::size_t) {
+            if (gen != self->generation) return;
+            auto pending = std::move(self->controlQueue.front());
+            self->controlQueue.pop_front();
+            if (pending.onSent) pending.onSent(!error);
+            if (error) {
+                std::cerr << "Async write error: " << error.message() << std::endl;
+            }
+            self->writeNext(gen);
+        });
+}
+
+void BackendSession::closeConnections() {
+    for (auto& stream : streams) {
+        stream->stop();
+    }
+    if (backendRef.sockets[1]) {
+        error_code ignored;
+        backendRef.sockets[1]->close(ignored);
+    }
+    for (auto& pending : controlQueue) {
+        if (pending.onSent) pending.onSent(false);
+    }
+    controlQueue.clear();
+    heartbeatTimer.cancel();
+    beatsInFlight.clear();
+    client.getLinkHealth(backendIndex).alive = false;
+}
+
+void BackendSession::fail(const std::string& reason, std::chrono::milliseconds retryAfter) {
+    std::cerr << "Error with " << backendRef.name << ": " << reason << std::endl;
+    uint64_t gen = ++generation;
+    closeConnections();
+    if (!running) return;
+
+    timer.expires_after(retryAfter);
+    timer.async_wait([self = shared_from_this(), gen](const error_code& error) {
+        if (error || gen != self->generation || !self->running) return;
+        self->connect();
+    });
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include "messages.hpp"
+#include "data_stream.hpp"
+
+class TcpClient;
+struct Backend;
+
+// One backend: its data streams (one connection per StreamSpec) and the control
+// connection. The first stream carries the session state; the others and the
+// control port come up once it streams and fail or retry on their own.
+// Every session handler runs on the session's strand, so backends progress,
+// fail and reconnect independently of each other.
+class BackendSession : public std::enable_shared_from_this<BackendSession> {
+public:
+    using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
+    using SentHandler = std::function<void(bool ok)>;
+
+    BackendSession(TcpClient& client, Backend& backend, size_t index, boost::asio::io_context& io);
+
+    void start();
+    void stop();
+    void reconfigure(const std::string& host, uint16_t dataPort, uint16_t controlPort);
+    void sendDataRequest();
+    void sendCommand(std::shared_ptr<const std::string> frame, SentHandler onSent);
+
+    SessionState state() const { return streams.front()->state(); }
+    size_t index() const { return backendIndex; }
+    Backend& backend() { return backendRef; }
+
+private:
+    using Buffer = std::shared_ptr<const std::string>;
+
+    struct PendingWrite {
+        Buffer data;
+        SentHandler onSent;
+    };
+
+    void connect();
+    void startStream(size_t streamIdx, uint64_t gen);
+    void onStreamFailed(size_t streamIdx, uint64_t gen, const std::string& reason);
+    void onPrimaryStreaming(uint64_t gen);
+    void connectControl(uint64_t gen);
+    void readControl(uint64_t gen);
+    void queueWrite(Buffer data, SentHandler onSent = nullptr);
+    void writeNext(uint64_t gen);
+    void startHeartbeat(uint64_t gen);
+    void beat(uint64_t gen);
+    bool onBeatAnswered(uint64_t sequenceNumber);
+    void closeConnections();
+    void fail(const std::string& reason, std::chrono::milliseconds retryAfter);
+
+    TcpClient& client;
+    Backend& backendRef;
+    size_t backendIndex;
+    Strand strand;
+    boost::asio::steady_timer timer;
+    boost::asio::steady_timer heartbeatTimer;
+    std::vector<std::shared_ptr<DataStream>> streams;
+
+    std::string host;
+    uint16_t dataPort;
+    uint16_t controlPort;
+
+    uint64_t generation = 0;  // bumped on every (re)connect so stale handlers bail out
+    bool running = false;
+    std::deque<PendingWrite> controlQueue;
+    std::array<char, header_length> controlHeader;
+    std::string controlBody;
+    // Unanswered heartbeats, oldest first: sequence number and send time
+    std::deque<std::pair<uint64_t, uint64_t>> beatsInFlight;
+    bool beatAcked = false;         // liveness is enforced once a beat on this link was answered
+    bool beatsUnsupported = false;  // said so once for a backend that has not answered yet
+};
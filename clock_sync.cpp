@@ -0,0 +1,120 @@
+#include "clock_sync.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+void ClockSync::addRoundTrip(uint64_t localSendNs, uint64_t backendMs, uint64_t localReceiveNs) {
+    if (localReceiveNs < localSendNs) return;
+    int64_t backendNs = static_cast<int64_t>(backendMs) * 1000000 + ClockMapping::kHalfTickNs;
+    int64_t midpoint = static_cast<int64_t>(localSendNs + (localReceiveNs - localSendNs) / 2);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    roundTrips[roundTripNext] = RoundTrip{midpoint - backendNs, localReceiveNs - localSendNs};
+    roundTripNext = (roundTripNext + 1) % kRoundTrips;
+    roundTripCount = std::min(roundTripCount + 1, kRoundTrips);
+    refit();
+}
+
+void ClockSync::addArrival(uint64_t backendMs, uint64_t localReceiveNs) {
+    // The minimum over many arrivals comes from messages sent right at the start
+    // of their millisecond tick, so the lower envelope is measured from the tick start
+    uint64_t backendNs = backendMs * 1000000;
+    int64_t delta = static_cast<int64_t>(localReceiveNs) - static_cast<int64_t>(backendNs);
+    uint64_t second = backendNs / 1000000000;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (bucketCount > 0 && second == currentSecond) {
+        Bucket& open = buckets[(bucketNext + kBuckets - 1) % kBuckets];
+        open.minDeltaNs = std::min(open.minDeltaNs, delta);
+        return;
+    }
+
+    // A new second closes the previous bucket, which then joins the fit
+    bool hadBuckets = bucketCount > 0;
+    currentSecond = second;
+    buckets[bucketNext] = Bucket{backendNs, delta};
+    bucketNext = (bucketNext + 1) % kBuckets;
+    bucketCount = std::min(bucketCount + 1, kBuckets);
+    if (hadBuckets) {
+        refit();
+    }
+}
+
+ClockMapping ClockSync::mapping() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+void ClockSync::resetArrivals() {
+    bucketCount = 0;
+    bucketNext = 0;
+}
+
+void ClockSync::refit() {
+    if (roundTripCount == 0) return;
+    const RoundTrip* best = &roundTrips[0];
+    for (size_t i = 1; i < roundTripCount; ++i) {
+        if (roundTrips[i].rttNs < best->rttNs) best = &roundTrips[i];
+    }
+
+    ClockMapping next;
+    next.valid = true;
+    next.offsetNs = best->offsetNs;
+    next.uncertaintyNs = best->rttNs / 2;
+
+    // Closed buckets only; the newest one may still be filling
+    size_t closed = bucketCount > 0 ? bucketCount - 1 : 0;
+    if (closed >= 4) {
+        auto at = [this](size_t i) -> const Bucket& {
+            return buckets[(bucketNext + kBuckets - bucketCount + i) % kBuckets];
+        };
+        const int64_t originX = static_cast<int64_t>(at(0).backendNs);
+        const int64_t originY = at(0).minDeltaNs;
+
+        // Least-squares line through the first count minima, evaluated at backend time x
+        auto fit = [&](size_t count, uint64_t x, double& slope) {
+            double meanX = 0.0;
+            double meanY = 0.0;
+            for (size_t i = 0; i < count; ++i) {
+                meanX += static_cast<double>(static_cast<int64_t>(at(i).backendNs) - originX);
+                meanY += static_cast<double>(at(i).minDeltaNs - originY);
+            }
+            meanX /= count;
+            meanY /= count;
+
+            double sxy = 0.0;
+            double sxx = 0.0;
+            for (size_t i = 0; i < count; ++i) {
+                double dx = static_cast<double>(static_cast<int64_t>(at(i).backendNs) - originX) - meanX;
+                double dy = static_cast<double>(at(i).minDeltaNs - originY) - meanY;
+                sxy += dx * dy;
+                sxx += dx * dx;
+            }
+            slope = sxx > 0.0 ? sxy / sxx : 0.0;
+            double dx = static_cast<double>(static_cast<int64_t>(x) - originX) - meanX;
+            return originY + static_cast<int64_t>(meanY + slope * dx);
+        };
+
+        // A backend clock step shows up as a whole second far off the earlier trend
+        const Bucket& newest = at(closed - 1);
+        double slope = 0.0;
+        int64_t expected = fit(closed - 1, newest.backendNs, slope);
+        if (std::abs(newest.minDeltaNs - expected) > kStepThresholdNs) {
+            std::cout << "[CLOCK] backend clock stepped; restarting drift estimate" << std::endl;
+            Bucket keepClosed = newest;
+            Bucket keepOpen = at(closed);
+            resetArrivals();
+            buckets[0] = keepClosed;
+            buckets[1] = keepOpen;
+            bucketNext = 2;
+            bucketCount = 2;
+        } else {
+            // Minimum one-way delay is taken as half the best round trip
+            int64_t fitted = fit(closed, newest.backendNs, slope);
+            next.offsetNs = fitted - static_cast<int64_t>(best->rttNs / 2);
+            next.drift = slope;
+            next.referenceNs = newest.backendNs;
+        }
+    }
+    current = next;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+// Backend clock -> local monotonic clock (Tracer::now()) for one backend.
+struct ClockMapping {
+    bool valid = false;
+    int64_t offsetNs = 0;        // local minus backend time at referenceNs
+    double drift = 0.0;          // local ns gained per backend ns
+    uint64_t referenceNs = 0;    // backend time the offset was estimated at
+    uint64_t uncertaintyNs = 0;  // half the best round trip: the asymmetry bound
+
+    uint64_t toLocal(uint64_t backendMs) const {
+        int64_t backendNs = static_cast<int64_t>(backendMs) * 1000000 + kHalfTickNs;
+        double elapsed = static_cast<double>(backendNs - static_cast<int64_t>(referenceNs));
+        return static_cast<uint64_t>(backendNs + offsetNs + static_cast<int64_t>(drift * elapsed));
+    }
+
+    // Inverse of toLocal: the backend millisecond tick a local instant falls in
+    uint64_t toBackendMs(uint64_t localNs) const {
+        double backendNs = (static_cast<double>(static_cast<int64_t>(localNs) - offsetNs)
+                            + drift * static_cast<double>(referenceNs)) / (1.0 + drift);
+        return static_cast<uint64_t>(backendNs) / 1000000;
+    }
+
+    // Backend stamps are whole milliseconds; assume the middle of the tick
+    static constexpr int64_t kHalfTickNs = 500000;
+};
+
+// Local times of one received message, all on the local monotonic clock.
+struct FrameTiming {
+    uint64_t receivedNs = 0;  // end of our read
+    uint64_t sentNs = 0;      // header timestamp, mapped
+    uint64_t capturedNs = 0;  // mTimestamp, mapped
+};
+
+// NTP-style offset and drift estimate for one backend. LINK/LINK_ACK round
+// trips give the offset with a symmetric-delay bound; the minimum one-way
+// delay of the data stream, taken per second of backend time and fitted with
+// a line, tracks drift between handshakes. Sub-millisecond precision comes
+// from the minimum filter averaging over the backend's 1 ms stamp ticks.
+class ClockSync {
+public:
+    void addRoundTrip(uint64_t localSendNs, uint64_t backendMs, uint64_t localReceiveNs);
+    void addArrival(uint64_t backendMs, uint64_t localReceiveNs);
+    ClockMapping mapping() const;
+
+private:
+    static constexpr size_t kRoundTrips = 16;
+    static constexpr size_t kBuckets = 64;  // seconds of drift history
+    static constexpr int64_t kStepThresholdNs = 50000000;
+
+    struct RoundTrip {
+        int64_t offsetNs;
+        uint64_t rttNs;
+    };
+
+    struct Bucket {
+        uint64_t backendNs;
+        int64_t minDeltaNs;  // local receive minus backend send
+    };
+
+    void refit();
+    void resetArrivals();
+
+    mutable std::mutex mutex;
+    std::array<RoundTrip, kRoundTrips> roundTrips{};
+    size_t roundTripCount = 0;
+    size_t roundTripNext = 0;
+
+    std::array<Bucket, kBuckets> buckets{};
+    size_t bucketCount = 0;
+    size_t bucketNext = 0;
+    uint64_t currentSecond = 0;
+
+    ClockMapping current;
+};
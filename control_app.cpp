@@ -1,17 +1,37 @@
 #include "control_app.hpp"
 #include "tcp_client.hpp"
+#include "memory_governor.hpp"
+#include "trace.hpp"
+#include "alloc_counter.hpp"
+#include "telemetry_panel.hpp"
+#include "app_style.hpp"
+#include "pcap_ingest.hpp"
 #include <QApplication>
 #include <QDesktopWidget>
+#include <QDateTime>
+#include <QFileDialog>
 #include <QMessageBox>
+#include <algorithm>
 #include <iostream>
 #include <opencv2/opencv.hpp>
 #include <thread>
 #include <atomic>
+#include <cmath>
+#include <cstdlib>
 
-ControlApp::ControlApp(QWidget* parent) : QMainWindow(parent), 
-    isToggleOn(false), eventSent(false), messageCounter(0), serverConnected(false) {
+ControlApp::ControlApp(std::chrono::steady_clock::time_point launchTime, QWidget* parent) : QMainWindow(parent), 
+    isToggleOn(false), eventSent(false), messageCounter(0), serverConnected(false), launched(launchTime) {
     
+    framesBudget = MemoryGovernor::instance().registerBudget("frames", 256u << 20,
+        [this](uint8_t channel) { return dropOldestFrame(channel); });
+    allocCheck = std::getenv("CONTROL_APP_ALLOC_CHECK") != nullptr;
     tcpClient = new TcpClient(this);
+    if (const char* shmName = std::getenv("CONTROL_APP_SHM")) {
+        framePublisher = FrameShmPublisher::create(shmName);
+    }
+    if (const char* capture = std::getenv("CONTROL_APP_PCAP")) {
+        pcapIngest = std::make_unique<PcapIngest>(*tcpClient, capture);
+    }
     setupUI();
 
     // Setup timers
@@ -20,23 +40,26 @@ ControlApp::ControlApp(QWidget* parent) : QMainWindow(parent),
 
     statusTimer = new QTimer(this);
     QObject::connect(statusTimer, &QTimer::timeout, this, &ControlApp::connectToServer);
-    statusTimer->start(1000);  // Check every 1 second
+    if (!pcapIngest) {
+        statusTimer->start(1000);  // Refresh every 1 second
+    }
 
-    // Initialize and show image viewer in a separate window
-    imageViewer = new ImageViewer(nullptr);
-    imageViewer->setWindowFlags(Qt::Window);
-    imageViewer->show();
+    memoryTimer = new QTimer(this);
+    QObject::connect(memoryTimer, &QTimer::timeout, this, &ControlApp::updateMemoryStatus);
+    memoryTimer->start(500);
+
+    // Everything not needed for the first paint runs once the event loop is up
+    QTimer::singleShot(0, this, &ControlApp::finishStartup);
 }
 
 ControlApp::~ControlApp() {
-    stopDataThread = true;
-    stopReceiveThread = true;
-    if (dataThread.joinable()) {
-        dataThread.join();
+    if (pcapIngest) {
+        pcapIngest->stop();
     }
-    if (receiveThread.joinable()) {
-        receiveThread.join();
+    if (pipelineInit.joinable()) {
+        pipelineInit.join();
     }
+    playback.reset();
     delete tcpClient;
 }
 
@@ -47,93 +70,17 @@ void ControlApp::setupUI() {
     QVBoxLayout* mainLayout = new QVBoxLayout(centralWidget);
     mainLayout->setSpacing(20);
 
-    // Create IP configuration group
+    // Backend rows are added by buildBackendRows once the window is up
     QGroupBox* configGroup = new QGroupBox("Backend Configuration", this);
-    QGridLayout* configLayout = new QGridLayout;
+    configLayout = new QGridLayout;
     configLayout->setSpacing(10);
-
-    // Create input fields for each backend
     auto& backends = tcpClient->getBackends();
-    for (size_t i = 0; i < backends.size(); ++i) {
-        QLabel* ipLabel = new QLabel(QString::fromStdString(backends[i].name + " IP:"), this);
-        ipLabel->setStyleSheet("font-size: 32px;");
-        
-        QLineEdit* ipInput = new QLineEdit(QString::fromStdString(backends[i].host), this);
-        ipInput->setPlaceholderText("Enter IP address");
-        ipInput->setStyleSheet(
-            "QLineEdit {"
-            "    font-size: 32px;"
-            "    padding: 5px;"
-            "    border: 1px solid #999;"
-            "    border-radius: 3px;"
-            "}"
-            "QLineEdit:focus {"
-            "    border: 2px solid #008CBA;"
-            "}"
-        );
-        
-        QLabel* portLabel1 = new QLabel("Port 1:", this);
-        portLabel1->setStyleSheet("font-size: 32px;");
-        
-        QLineEdit* portInput1 = new QLineEdit(QString::number(backends[i].ports[0]), this);
-        portInput1->setPlaceholderText("Enter port 1");
-        portInput1->setStyleSheet(
-            "QLineEdit {"
-            "    font-size: 32px;"
-            "    padding: 5px;"
-            "    border: 1px solid #999;"
-            "    border-radius: 3px;"
-            "}"
-            "QLineEdit:focus {"
-            "    border: 2px solid #008CBA;"
-            "}"
-        );
-        
-        QLabel* portLabel2 = new QLabel("Port 2:", this);
-        portLabel2->setStyleSheet("font-size: 32px;");
-        
-        QLineEdit* portInput2 = new QLineEdit(QString::number(backends[i].ports[1]), this);
-        portInput2->setPlaceholderText("Enter port 2");
-        portInput2->setStyleSheet(
-            "QLineEdit {"
-            "    font-size: 32px;"
-            "    padding: 5px;"
-            "    border: 1px solid #999;"
-            "    border-radius: 3px;"
-            "}"
-            "QLineEdit:focus {"
-            "    border: 2px solid #008CBA;"
-            "}"
-        );
-        
-        configLayout->addWidget(ipLabel, i, 0);
-        configLayout->addWidget(ipInput, i, 1);
-        configLayout->addWidget(portLabel1, i, 2);
-        configLayout->addWidget(portInput1, i, 3);
-        configLayout->addWidget(portLabel2, i, 4);
-        configLayout->addWidget(portInput2, i, 5);
-        
-        ipInputs.push_back(ipInput);
-        portInputs1.push_back(portInput1);
-        portInputs2.push_back(portInput2);
-    }
 
     // Add apply button
     applyBtn = new QPushButton("Apply Configuration", this);
     applyBtn->setMinimumSize(200, 50);
-    applyBtn->setStyleSheet(
-        "QPushButton {"
-        "    font-size: 32px;"
-        "    font-weight: bold;"
-        "    padding: 5px;"
-        "    background-color: #008CBA;"
-        "    color: white;"
-        "    border-radius: 5px;"
-        "}"
-        "QPushButton:hover {"
-        "    background-color: #007399;"
-        "}"
-    );
+    applyBtn->setProperty("role", "primary");
+    applyBtn->setEnabled(false);
     connect(applyBtn, &QPushButton::clicked, this, &ControlApp::applyConfiguration);
     configLayout->addWidget(applyBtn, backends.size(), 0, 1, 6);
 
@@ -147,7 +94,7 @@ void ControlApp::setupUI() {
     // Create status labels
     for (size_t i = 0; i < backends.size(); ++i) {
         QLabel* label = new QLabel(QString::fromStdString(backends[i].name + ": Not Connected"), this);
-        label->setStyleSheet("color: red; font-size: 32px;");
+        label->setProperty("link", "down");
         controlLayout->addWidget(label, 0, i, Qt::AlignCenter);
         statusLabels.push_back(label);
     }
@@ -155,136 +102,218 @@ void ControlApp::setupUI() {
     // Create buttons
     toggleBtn = new QPushButton("Start", this);
     toggleBtn->setMinimumSize(200, 50);
-    toggleBtn->setStyleSheet(
-        "QPushButton {"
-        "    font-size: 32px;"
-        "    font-weight: bold;"
-        "    padding: 5px;"
-        "    background-color: #4CAF50;"
-        "    color: white;"
-        "    border-radius: 5px;"
-        "}"
-        "QPushButton:hover {"
-        "    background-color: #45a049;"
-        "}"
-    );
+    toggleBtn->setProperty("role", "start");
     connect(toggleBtn, &QPushButton::clicked, this, &ControlApp::toggleAction);
 
     eventBtn = new QPushButton("Send Event", this);
     eventBtn->setMinimumSize(200, 50);
-    eventBtn->setStyleSheet(
-        "QPushButton {"
-        "    font-size: 32px;"
-        "    font-weight: bold;"
-        "    padding: 5px;"
-        "    background-color: #008CBA;"
-        "    color: white;"
-        "    border-radius: 5px;"
-        "}"
-        "QPushButton:hover {"
-        "    background-color: #007399;"
-        "}"
-        "QPushButton:disabled {"
-        "    background-color: #cccccc;"
-        "    color: #666666;"
-        "}"
-    );
+    eventBtn->setProperty("role", "primary");
     connect(eventBtn, &QPushButton::clicked, this, &ControlApp::sendEvent);
 
+    traceBtn = new QPushButton("Start Trace", this);
+    traceBtn->setMinimumSize(200, 50);
+    connect(traceBtn, &QPushButton::clicked, this, &ControlApp::toggleTracing);
+
     controlLayout->addWidget(toggleBtn, 1, 0, 1, 2, Qt::AlignCenter);
     controlLayout->addWidget(eventBtn, 2, 0, 1, 2, Qt::AlignCenter);
+    controlLayout->addWidget(traceBtn, 4, 0, 1, 2, Qt::AlignCenter);
+
+    memoryLabel = new QLabel("Memory: -", this);
+    memoryLabel->setProperty("role", "status");
+    controlLayout->addWidget(memoryLabel, 3, 0, 1, 2, Qt::AlignCenter);
+
+    receiveLabel = new QLabel("Receive: -", this);
+    receiveLabel->setProperty("role", "status");
+    controlLayout->addWidget(receiveLabel, 5, 0, 1, 2, Qt::AlignCenter);
+
+    recordBtn = new QPushButton("Record Locally", this);
+    recordBtn->setMinimumSize(200, 50);
+    connect(recordBtn, &QPushButton::clicked, this, &ControlApp::toggleRecording);
+
+    exportBtn = new QPushButton("Export Video", this);
+    exportBtn->setMinimumSize(200, 50);
+    connect(exportBtn, &QPushButton::clicked, this, &ControlApp::exportSession);
+
+    controlLayout->addWidget(recordBtn, 6, 0, Qt::AlignCenter);
+    controlLayout->addWidget(exportBtn, 6, 1, Qt::AlignCenter);
+
+    recordLabel = new QLabel("Recording: off", this);
+    recordLabel->setProperty("role", "status");
+    controlLayout->addWidget(recordLabel, 7, 0, 1, 2, Qt::AlignCenter);
 
     controlGroup->setLayout(controlLayout);
     mainLayout->addWidget(controlGroup);
 
+    QGroupBox* playbackGroup = new QGroupBox("Playback", this);
+    QGridLayout* playbackLayout = new QGridLayout;
+    openSessionBtn = new QPushButton("Open Session", this);
+    playBtn = new QPushButton("Play", this);
+    stepBackBtn = new QPushButton("< Frame", this);
+    stepForwardBtn = new QPushButton("Frame >", this);
+    speedBtn = new QPushButton("1x", this);
+    timelineSlider = new QSlider(Qt::Horizontal, this);
+    timelineSlider->setRange(0, 1000);
+    playbackLabel = new QLabel("No session open", this);
+    playbackLabel->setProperty("role", "status");
+
+    QPushButton* playbackButtons[] = {openSessionBtn, stepBackBtn, playBtn, stepForwardBtn, speedBtn};
+    for (int i = 0; i < 5; ++i) {
+        playbackButtons[i]->setMinimumSize(120, 50);
+        playbackButtons[i]->setProperty("role", "playback");
+        playbackLayout->addWidget(playbackButtons[i], 0, i);
+    }
+    playbackLayout->addWidget(timelineSlider, 1, 0, 1, 5);
+    playbackLayout->addWidget(playbackLabel, 2, 0, 1, 5, Qt::AlignCenter);
+    playbackGroup->setLayout(playbackLayout);
+    mainLayout->addWidget(playbackGroup);
+
+    connect(openSessionBtn, &QPushButton::clicked, this, &ControlApp::openSession);
+    connect(playBtn, &QPushButton::clicked, this, &ControlApp::togglePlayback);
+    connect(stepBackBtn, &QPushButton::clicked, this, [this]() { if (playback) playback->step(-1); });
+    connect(stepForwardBtn, &QPushButton::clicked, this, [this]() { if (playback) playback->step(1); });
+    connect(speedBtn, &QPushButton::clicked, this, &ControlApp::cycleSpeed);
+    connect(timelineSlider, &QSlider::sliderMoved, this, &ControlApp::seekTimeline);
+
+    playbackTimer = new QTimer(this);
+    connect(playbackTimer, &QTimer::timeout, this, &ControlApp::updatePlaybackStatus);
+
+    QGroupBox* telemetryGroup = new QGroupBox("Backend Telemetry", this);
+    QVBoxLayout* telemetryLayout = new QVBoxLayout;
+    telemetryPanel = new TelemetryPanel(*tcpClient, this);
+    telemetryLayout->addWidget(telemetryPanel);
+    telemetryGroup->setLayout(telemetryLayout);
+    mainLayout->addWidget(telemetryGroup);
+
     // Set window properties
     setMinimumSize(1200, 800);
     resize(1200, 800);
     centerWindow();
     eventBtn->setEnabled(true);
+}
+
+void ControlApp::buildBackendRows() {
+    auto& backends = tcpClient->getBackends();
+    for (size_t i = 0; i < backends.size(); ++i) {
+        QLabel* ipLabel = new QLabel(QString::fromStdString(backends[i].name + " IP:"), this);
+        QLineEdit* ipInput = new QLineEdit(QString::fromStdString(backends[i].host), this);
+        ipInput->setPlaceholderText("Enter IP address");
+
+        QLabel* portLabel1 = new QLabel("Port 1:", this);
+        QLineEdit* portInput1 = new QLineEdit(QString::number(backends[i].ports[0]), this);
+        portInput1->setPlaceholderText("Enter port 1");
+
+        QLabel* portLabel2 = new QLabel("Port 2:", this);
+        QLineEdit* portInput2 = new QLineEdit(QString::number(backends[i].ports[1]), this);
+        portInput2->setPlaceholderText("Enter port 2");
+
+        configLayout->addWidget(ipLabel, i, 0);
+        configLayout->addWidget(ipInput, i, 1);
+        configLayout->addWidget(portLabel1, i, 2);
+        configLayout->addWidget(portInput1, i, 3);
+        configLayout->addWidget(portLabel2, i, 4);
+        configLayout->addWidget(portInput2, i, 5);
 
-    // Set window style
-    setStyleSheet(
-        "QGroupBox {"
-        "    font-size: 32px;"
-        "    font-weight: bold;"
-        "    margin-top: 1ex;"
-        "}"
-        "QGroupBox::title {"
-        "    subcontrol-origin: margin;"
-        "    subcontrol-position: top center;"
-        "    padding: 0 3px;"
-        "}"
-        "QLineEdit {"
-        "    padding: 5px;"
-        "    border: 1px solid #999;"
-        "    border-radius: 3px;"
-        "}"
-    );
+        ipInputs.push_back(ipInput);
+        portInputs1.push_back(portInput1);
+        portInputs2.push_back(portInput2);
+    }
+    applyBtn->setEnabled(true);
 }
 
-void ControlApp::toggleAction() {
-    if (!isToggleOn) {  // Sending START
-        std::vector<bool> results;
-        int idx = 0;
-        for (auto& backend : tcpClient->getBackends()) {
-            results.push_back(tcpClient->sendLoggingMessage(MessageType::START, backend, idx++));
-        }
-        if (std::all_of(results.begin(), results.end(), [](bool result) { return result; })) {
-            toggleBtn->setText("End");
-            toggleBtn->setStyleSheet(
-                "QPushButton {"
-                "    font-size: 32px;"
-                "    font-weight: bold;"
-                "    padding: 5px;"
-                "    background-color: #ff9999;"
-                "    color: white;"
-                "    border-radius: 5px;"
-                "}"
-                "QPushButton:hover {"
-                "    background-color: #ff8080;"
-                "}"
-            );
-            isToggleOn = true;
-            eventBtn->setEnabled(false);
-        }
-    } else {  // Sending END
-        std::vector<bool> results;
-        int idx = 0;
-        for (auto& backend : tcpClient->getBackends()) {
-            results.push_back(tcpClient->sendLoggingMessage(MessageType::STOP, backend, idx++));
+void ControlApp::finishStartup() {
+    // The window is on screen and taking input from here on
+    double interactiveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - launched).count();
+    std::cout << "[STARTUP] window interactive after " << interactiveMs << " ms" << std::endl;
+
+    buildBackendRows();
+
+    // Initialize and show image viewer in a separate window
+    imageViewer = new ImageViewer(nullptr);
+    imageViewer->setFrameReleased([this](const FramePyramid& pyramid) {
+        MemoryGovernor::instance().release(framesBudget, pyramid.budgetBytes);
+    });
+    tileViews.fill(QRectF(0.0, 0.0, 1.0, 1.0));
+    roiTimer = new QTimer(this);
+    roiTimer->setSingleShot(true);
+    roiTimer->setInterval(100);
+    connect(roiTimer, &QTimer::timeout, this, &ControlApp::sendRegionsOfInterest);
+    imageViewer->setViewChanged([this](int tile, const QRectF& view) {
+        tileViews[tile] = view;
+        roiTimer->start();
+    });
+    imageViewer->setWindowFlags(Qt::Window);
+    imageViewer->show();
+
+    // OpenCV's first call spins up its thread pool and probes the CPU; that and
+    // the decode targets are set up here instead of in front of the first paint
+    pipelineInit = std::thread([this]() {
+        cv::Mat warm(16, 16, CV_8UC3, cv::Scalar::all(0));
+        cv::Mat converted;
+        cv::cvtColor(warm, converted, cv::COLOR_BGR2RGB);
+        cv::parallel_for_(cv::Range(0, cv::getNumThreads()), [](const cv::Range&) {});
+        lidarBev.prepare();
+        assignTiles(tcpClient->getRequestedChannels());
+        preallocateFrames(tcpClient->getRequestedChannels());
+        pipelineReady.store(true, std::memory_order_release);
+
+        double readyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - launched).count();
+        std::cout << "[STARTUP] image pipeline ready after " << readyMs << " ms" << std::endl;
+        if (std::getenv("CONTROL_APP_STARTUP_BENCH")) {
+            QMetaObject::invokeMethod(qApp, "quit", Qt::QueuedConnection);
         }
-        if (std::all_of(results.begin(), results.end(), [](bool result) { return result; })) {
-            toggleBtn->setText("Start");
-            toggleBtn->setStyleSheet(
-                "QPushButton {"
-                "    font-size: 32px;"
-                "    font-weight: bold;"
-                "    padding: 5px;"
-                "    background-color: #4CAF50;"
-                "    color: white;"
-                "    border-radius: 5px;"
-                "}"
-                "QPushButton:hover {"
-                "    background-color: #45a049;"
-                "}"
-            );
-            isToggleOn = false;
-            eventBtn->setEnabled(true);
+
+        // Replayed on this thread; CONTROL_APP_PCAP_EXIT quits once the report is out
+        if (pcapIngest && pcapIngest->run() && std::getenv("CONTROL_APP_PCAP_EXIT")) {
+            QMetaObject::invokeMethod(qApp, "quit", Qt::QueuedConnection);
         }
-    }
+    });
+}
+
+void ControlApp::toggleAction() {
+    bool starting = !isToggleOn;
+    const char* command = starting ? "START" : "STOP";
+    // The button comes back when the backends have answered
+    toggleBtn->setEnabled(false);
+    tcpClient->broadcastLoggingMessage(starting ? MessageType::START : MessageType::STOP, kCommandDeadline,
+        [this, command, starting](const FanOutResult& result) {
+            QMetaObject::invokeMethod(this, [this, command, starting, result]() {
+                reportFanOut(command, result);
+                toggleBtn->setEnabled(true);
+                if (!result.allSent()) return;
+                toggleBtn->setText(starting ? "End" : "Start");
+                app_style::setState(toggleBtn, "role", starting ? "stop" : "start");
+                isToggleOn = starting;
+                eventBtn->setEnabled(!starting);
+            }, Qt::QueuedConnection);
+        });
 }
 
 void ControlApp::sendEvent() {
-    std::vector<bool> results;
-    int idx = 0;
-    for (auto& backend : tcpClient->getBackends()) {
-        results.push_back(tcpClient->sendLoggingMessage(MessageType::EVENT, backend, idx++));
-    }
-    if (std::all_of(results.begin(), results.end(), [](bool result) { return result; })) {
-        eventBtn->setEnabled(false);
-        timer->start(30000);  // 30 seconds
+    eventBtn->setEnabled(false);
+    tcpClient->broadcastLoggingMessage(MessageType::EVENT, kCommandDeadline, [this](const FanOutResult& result) {
+        QMetaObject::invokeMethod(this, [this, result]() {
+            reportFanOut("EVENT", result);
+            if (result.allSent()) {
+                timer->start(30000);  // 30 seconds
+            } else {
+                eventBtn->setEnabled(!isToggleOn);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ControlApp::reportFanOut(const char* command, const FanOutResult& result) {
+    commandStatus.resize(result.acked.size());
+    for (size_t i = 0; i < result.acked.size(); ++i) {
+        if (result.acked[i]) {
+            commandStatus[i] = QString("%1 ACK %2 ms").arg(command).arg(result.ackLatencyMs[i], 0, 'f', 1);
+        } else if (result.sent[i]) {
+            commandStatus[i] = QString("%1 no ACK").arg(command);
+        } else {
+            commandStatus[i] = QString("%1 failed").arg(command);
+        }
     }
+    updateStatusLabels();
 }
 
 void ControlApp::enableEventButton() {
@@ -342,11 +371,8 @@ void ControlApp::applyConfiguration() {
             continue;  // Skip if configuration hasn't changed
         }
 
-        // Update configuration
-        backends[i].host = ip.toStdString();
-        backends[i].ports[0] = portNum1;
-        backends[i].ports[1] = portNum2;
-        tcpClient->cleanupSockets();
+        // Update configuration; only this backend's session reconnects
+        tcpClient->reconfigureBackend(i, ip.toStdString(), portNum1, portNum2);
     }
 
     if (!allValid) {
@@ -360,63 +386,460 @@ void ControlApp::applyConfiguration() {
 }
 
 void ControlApp::connectToServer() {
-    if (tcpClient->connectToServer()) {
-        statusTimer->stop();
-        eventSent = false;
-        eventBtn->setEnabled(true);
-        toggleBtn->setEnabled(true);
-
-        auto& backends = tcpClient->getBackends();
-        for (size_t i = 0; i < backends.size(); ++i) {
-            statusLabels[i]->setText(QString::fromStdString(backends[i].name + ": Connected"));
-            statusLabels[i]->setStyleSheet("color: green; font-size: 32px;");
+    // Sessions connect, handshake and reconnect on their own; this starts them once
+    serverConnected = tcpClient->connectToServer();
+    updateStatusLabels();
+}
+
+void ControlApp::updateStatusLabels() {
+    auto& backends = tcpClient->getBackends();
+    for (size_t i = 0; i < backends.size(); ++i) {
+        SessionState state = tcpClient->sessionState(i);
+        QString text = QString::fromStdString(backends[i].name + ": " + toString(state));
+        ClockMapping clock = tcpClient->getClockSync(i).mapping();
+        if (clock.valid && state == SessionState::Streaming) {
+            // How far the backend clock runs ahead of our wall clock
+            int64_t aheadNs = Tracer::instance().wallClockOffsetNs() - clock.offsetNs;
+            text = text + QString(" | clock %1 ms \u00b1%2, %3 ppm")
+                .arg(aheadNs / 1e6, 0, 'f', 3)
+                .arg(clock.uncertaintyNs / 1e6, 0, 'f', 3)
+                .arg(clock.drift * 1e6, 0, 'f', 1);
+        }
+        const LinkHealth& link = tcpClient->getLinkHealth(i);
+        bool linkDown = state == SessionState::Streaming && link.beatsSent.load() > 0 && !link.alive;
+        if (link.alive) {
+            text = text + QString(" | RTT %1 ms (p50 %2, p99 %3)")
+                .arg(link.lastRttNs.load() / 1e6, 0, 'f', 2)
+                .arg(link.rtt.percentileNs(0.5) / 1e6, 0, 'f', 2)
+                .arg(link.rtt.percentileNs(0.99) / 1e6, 0, 'f', 2);
+        } else if (linkDown) {
+            text = text + " | no heartbeat";
+        }
+        if (uint64_t lost = link.linksLost.load()) {
+            text = text + QString(" | relinked %1x").arg(static_cast<unsigned long long>(lost));
+        }
+        if (i < commandStatus.size() && !commandStatus[i].isEmpty()) {
+            text = text + " | " + commandStatus[i];
+        }
+        statusLabels[i]->setText(text);
+        if (state == SessionState::Streaming && !linkDown) {
+            app_style::setState(statusLabels[i], "link", "up");
+        } else if (state == SessionState::Disconnected) {
+            app_style::setState(statusLabels[i], "link", "down");
+        } else {
+            app_style::setState(statusLabels[i], "link", "degraded");
         }
+    }
+}
 
-        serverConnected = true;
-        // Initialize data threads
-        dataThread = std::thread([this]() {
-            while (!stopDataThread || !serverConnected) {
-                if (serverConnected) {
-                    tcpClient->sendData();
-                    // std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                    break;
-                }
-            }
-        });
+void ControlApp::closeEvent(QCloseEvent* event) {
+    playback.reset();
+    tcpClient->cleanupSockets();
+    event->accept();
+}
 
-        receiveThread = std::thread([this]() {
-            while (!stopReceiveThread || !serverConnected) {
-                if (serverConnected) {
-                    tcpClient->receiveData();
-                    break;
-                }
-            }
-        });
+void ControlApp::toggleTracing() {
+    auto& tracer = Tracer::instance();
+    if (!Tracer::enabled()) {
+        tracer.setEnabled(true);
+        traceBtn->setText("Save Trace");
+        return;
+    }
+
+    tracer.setEnabled(false);
+    traceBtn->setText("Start Trace");
+    if (!tracer.flush("control_app_trace.json")) {
+        QMessageBox::warning(this, "Trace", "Could not write control_app_trace.json");
+    }
+}
 
+void ControlApp::toggleRecording() {
+    if (!recorder) {
+        std::string directory = "recordings/session_" +
+            QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss").toStdString();
+        auto next = std::make_shared<SessionRecorder>(directory);
+        if (!next->ok()) {
+            QMessageBox::warning(this, "Record", QString::fromStdString("Could not create " + directory));
+            return;
+        }
+        recorder = next;
+        tcpClient->setRecorder(recorder);
+        recordBtn->setText("Stop Recording");
+        return;
+    }
+
+    // Frames already queued are still written before the recorder goes away
+    tcpClient->setRecorder(nullptr);
+    recorder.reset();
+    recordBtn->setText("Record Locally");
+}
+
+void ControlApp::exportSession() {
+    QString directory = QFileDialog::getExistingDirectory(this, "Export recorded session", "recordings");
+    if (directory.isEmpty()) {
+        return;
+    }
+    std::string session = directory.toStdString();
+    exporter = std::make_unique<VideoExporter>(session, session + "/video");
+    if (!exporter->start()) {
+        QMessageBox::warning(this, "Export", QString::fromStdString(exporter->progress().error));
+        exporter.reset();
+        return;
+    }
+    exportBtn->setEnabled(false);
+}
+
+void ControlApp::openSession() {
+    if (playback) {
+        closeSession();
+        return;
+    }
+    QString directory = QFileDialog::getExistingDirectory(this, "Open recorded session", "recordings");
+    if (directory.isEmpty()) {
+        return;
+    }
+    auto next = std::make_unique<SessionPlayback>(directory.toStdString());
+    if (!next->ok()) {
+        QMessageBox::warning(this, "Playback", QString("No recorded channels in ") + directory);
+        return;
+    }
+
+    playback = std::move(next);
+    playbackActive = true;
+    assignTiles(playback->channelMask());
+    playback->start([this](const char* payload, const stDataSensorReqMsg& sensor) {
+        FrameTiming timing;
+        timing.receivedNs = Tracer::now();
+        timing.capturedNs = timing.receivedNs;
+        decodeFrame(payload, sensor, timing);
+    });
+    openSessionBtn->setText("Close Session");
+    playbackTimer->start(100);
+}
+
+void ControlApp::closeSession() {
+    if (!playback) {
+        return;
+    }
+    playbackTimer->stop();
+    playback.reset();
+    playbackActive = false;
+    assignTiles(tcpClient->getRequestedChannels());
+    openSessionBtn->setText("Open Session");
+    playBtn->setText("Play");
+    playbackLabel->setText("No session open");
+}
+
+void ControlApp::togglePlayback() {
+    if (!playback) {
+        return;
+    }
+    if (playback->playing()) {
+        playback->pause();
     } else {
-        auto& backends = tcpClient->getBackends();
-        for (size_t i = 0; i < backends.size(); ++i) {
-            statusLabels[i]->setText(QString::fromStdString(backends[i].name + ": Not Connected"));
-            statusLabels[i]->setStyleSheet("color: red; font-size: 32px;");
+        playback->play();
+    }
+    updatePlaybackStatus();
+}
+
+void ControlApp::cycleSpeed() {
+    if (!playback) {
+        return;
+    }
+    double next = playback->speed() >= 16.0 ? 1.0 : playback->speed() * 2.0;
+    playback->setSpeed(next);
+    speedBtn->setText(QString("%1x").arg(next, 0, 'f', 0));
+}
+
+void ControlApp::seekTimeline(int value) {
+    if (!playback) {
+        return;
+    }
+    uint64_t span = playback->endTime() - playback->startTime();
+    playback->seek(playback->startTime() + span * static_cast<uint64_t>(value) / 1000);
+}
+
+void ControlApp::updatePlaybackStatus() {
+    if (!playback) {
+        return;
+    }
+    uint64_t span = playback->endTime() - playback->startTime();
+    uint64_t offset = playback->position() - playback->startTime();
+    if (!timelineSlider->isSliderDown() && span > 0) {
+        timelineSlider->setValue(static_cast<int>(offset * 1000 / span));
+    }
+    playBtn->setText(playback->playing() ? "Pause" : "Play");
+    playbackLabel->setText(QString("%1 / %2 s | %3")
+        .arg(offset / 1000.0, 0, 'f', 2)
+        .arg(span / 1000.0, 0, 'f', 2)
+        .arg(QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(playback->position())).toString("yyyy-MM-dd HH:mm:ss.zzz")));
+}
+
+void ControlApp::updateMemoryStatus() {
+    memoryLabel->setText(QString::fromStdString("Memory: " + MemoryGovernor::instance().summary()));
+    updateStatusLabels();  // keeps RTT and link health current between connection checks
+
+    // Called every 500 ms
+    const auto& stats = tcpClient->getReceiveStats();
+    uint64_t frames = stats.frames.load(std::memory_order_relaxed);
+    uint64_t bytes = stats.bytes.load(std::memory_order_relaxed);
+    receiveLabel->setText(QString("Receive: %1 frames/s | %2 MB/s | %3 malformed | %4 dropped | %5 repeated | %6 coalesced")
+        .arg((frames - lastFrameCount) * 2)
+        .arg((bytes - lastByteCount) * 2 / 1048576.0, 0, 'f', 1)
+        .arg(stats.malformed.load(std::memory_order_relaxed))
+        .arg(stats.dropped.load(std::memory_order_relaxed))
+        .arg(stats.duplicates.load(std::memory_order_relaxed))
+        .arg(imageViewer ? imageViewer->replacedFrames() : 0));
+    if (allocCheck) {
+        uint64_t allocations = AllocCounter::allocations();
+        if (allocations != lastAllocCount) {
+            std::cout << "[ALLOC] " << allocations - lastAllocCount << " heap allocations on the frame path over "
+                      << frames - lastFrameCount << " frames" << std::endl;
         }
+        lastAllocCount = allocations;
     }
+    lastFrameCount = frames;
+    lastByteCount = bytes;
+
+    // A tile is stalled while any camera channel drawn on it repeats its frame
+    std::array<bool, ImageViewer::kTileCount> stalled{};
+    for (uint8_t channel = 0; channel < static_cast<uint8_t>(eSensorChannel::CHANNEL_MAX); ++channel) {
+        uint8_t tile = channelTiles[channel].load(std::memory_order_relaxed);
+        if (tile != kNoTile && tcpClient->isStalled(channel)) {
+            stalled[tile] = true;
+        }
+    }
+    for (int tile = 0; imageViewer && tile < ImageViewer::kTileCount; ++tile) {
+        imageViewer->setStalled(tile, stalled[tile]);
+    }
+
+    QString recording("Recording: off");
+    if (recorder) {
+        recording = QString("Recording: %1 frames | %2 MB | %3 dropped")
+            .arg(static_cast<unsigned long long>(recorder->recordedFrames()))
+            .arg(static_cast<unsigned long long>(recorder->recordedBytes() >> 20))
+            .arg(static_cast<unsigned long long>(recorder->droppedFrames()));
+        if (recorder->compressing() && recorder->recordedBytes() > 0) {
+            recording += QString(" | %1:1 zstd")
+                .arg(static_cast<double>(recorder->payloadBytes()) / recorder->recordedBytes(), 0, 'f', 1);
+        }
+    }
+    if (exporter) {
+        ExportProgress progress = exporter->progress();
+        recording += QString(" | Export: %1/%2 channels, %3/%4 frames, %5 fps")
+            .arg(static_cast<unsigned long long>(progress.channelsDone))
+            .arg(static_cast<unsigned long long>(progress.channels))
+            .arg(static_cast<unsigned long long>(progress.framesDone))
+            .arg(static_cast<unsigned long long>(progress.framesTotal))
+            .arg(progress.framesPerSecond(), 0, 'f', 0);
+        if (!progress.error.empty()) {
+            recording += QString::fromStdString(" | " + progress.error);
+        }
+        if (progress.finished) {
+            exportBtn->setEnabled(true);
+        }
+    }
+    recordLabel->setText(recording);
 }
 
-void ControlApp::closeEvent(QCloseEvent* event) {
-    tcpClient->cleanupSockets();
-    event->accept();
+bool ControlApp::dropOldestFrame(uint8_t channel) {
+    // Only the newest frame per tile waits for the compositor
+    if (!pipelineReady.load(std::memory_order_acquire)) return false;
+    uint8_t tile = channel < channelTiles.size() ? channelTiles[channel].load(std::memory_order_relaxed) : kNoTile;
+    return tile != kNoTile && imageViewer->dropPending(tile);
 }
 
-void ControlApp::processData(const char* imageData, int sensorType, int width, int height) {
-    
-    if (sensorType == 1) {
-        // YUV422UYVY를 RGB로 변환
-        cv::Mat yuv(height, width, CV_8UC2, const_cast<void*>(static_cast<const void*>(imageData)));
-        cv::Mat rgb;
-        cv::cvtColor(yuv, rgb, cv::COLOR_YUV2BGR_UYVY);
-        
-        // QImage로 변환
-        QImage img(rgb.data, rgb.cols, rgb.rows, rgb.step, QImage::Format_RGB888);
-        imageViewer->updateImage(0, rgb);
+void ControlApp::assignTiles(uint32_t channelMask) {
+    // Cameras take their own side's tile in channel order; one that finds it
+    // taken moves to any free camera tile, or is not shown if there is none
+    std::array<bool, ImageViewer::kCameraTiles> taken{};
+    std::vector<const SensorChannelInfo*> displaced;
+    for (const auto& sensor : sensor_channels::kTable) {
+        size_t channel = static_cast<size_t>(sensor.channel);
+        uint8_t tile = sensor.isImage() ? kNoTile : sensor.tile;
+        if (sensor.isImage() && (channelMask & sensor.mask())) {
+            if (taken[sensor.tile]) {
+                displaced.push_back(&sensor);
+            } else {
+                taken[sensor.tile] = true;
+                tile = sensor.tile;
+            }
+        }
+        channelTiles[channel].store(tile, std::memory_order_relaxed);
+    }
+    for (const SensorChannelInfo* sensor : displaced) {
+        auto free = std::find(taken.begin(), taken.end(), false);
+        if (free == taken.end()) {
+            std::cout << "[VIEWER] no free tile for " << sensor->name << "; it is not shown" << std::endl;
+            continue;
+        }
+        *free = true;
+        uint8_t tile = static_cast<uint8_t>(free - taken.begin());
+        channelTiles[static_cast<size_t>(sensor->channel)].store(tile, std::memory_order_relaxed);
+        std::cout << "[VIEWER] " << sensor->name << " shown on tile " << static_cast<int>(tile) << std::endl;
+    }
+}
+
+void ControlApp::preallocateFrames(uint32_t channelMask) {
+    for (const auto& sensor : sensor_channels::kTable) {
+        if (!(channelMask & sensor.mask())) continue;
+        size_t channel = static_cast<size_t>(sensor.channel);
+        if (!sensor.isImage()) {
+            pyramidPools[channel].reserve(sensor.poolFrames,
+                cv::Size(LidarBevRasterizer::kGridSize, LidarBevRasterizer::kGridSize));
+            continue;
+        }
+        // Only the pool size depends on this; decodeFrame follows the stream's real format
+        const PixelKernel* kernel = findPixelKernel(static_cast<uint8_t>(sensor.format), sensor.depth);
+        if (!kernel) continue;
+        channelKernels[channel].store(kernel, std::memory_order_relaxed);
+        pyramidPools[channel].reserve(sensor.poolFrames, kernel->outputSize(sensor.width, sensor.height));
+    }
+}
+
+void ControlApp::processData(const char* imageData, const stDataSensorReqMsg& sensorMsg, const FrameTiming& timing) {
+    // Playback owns the camera tiles until the session is closed
+    if (sensorMsg.mSensorType == 1 && playbackActive.load(std::memory_order_relaxed)) {
+        return;
+    }
+    decodeFrame(imageData, sensorMsg, timing);
+}
+
+void ControlApp::decodeFrame(const char* imageData, const stDataSensorReqMsg& sensorMsg, const FrameTiming& timing) {
+    // Frames that arrive while startup is still setting up the pipeline are not shown
+    if (!pipelineReady.load(std::memory_order_acquire)) {
+        return;
+    }
+    if (sensorMsg.mSensorType == 1) {
+        TraceSpan span("convert");
+        int channel = sensorMsg.mChannel;
+        int width = sensorMsg.mImgWidth;
+        int height = sensorMsg.mImgHeight;
+        uint8_t tile = channelTiles[channel].load(std::memory_order_relaxed);
+        if (tile == kNoTile) {
+            return;
+        }
+
+        // Resolved per (format, depth) once, depth fallbacks included; a
+        // channel's kernel is only reported when it changes
+        const PixelKernel* kernel = findPixelKernel(sensorMsg.mImgFormat, sensorMsg.mImgDepth);
+        if (!kernel) {
+            return;
+        }
+        if (channelKernels[channel].exchange(kernel, std::memory_order_relaxed) != kernel) {
+            std::cout << "[DECODE] channel " << channel << ": " << kernel->name;
+            if (kernel->depth != sensorMsg.mImgDepth) {
+                std::cout << " (no " << static_cast<int>(sensorMsg.mImgDepth) << "-bit kernel)";
+            }
+            std::cout << std::endl;
+        }
+
+        // Full BGR level plus roughly a third more for the smaller pyramid levels
+        cv::Size output = kernel->outputSize(width, height);
+        size_t bytes = static_cast<size_t>(output.width) * output.height * 3 * 4 / 3;
+        if (!MemoryGovernor::instance().acquire(framesBudget, channel, bytes)) {
+            return;
+        }
+
+        // A region of interest sits at its origin within the sensor image
+        cv::Point origin;
+        if (isRoiFrame(sensorMsg)) {
+            origin = cv::Point(roiOriginX(sensorMsg), roiOriginY(sensorMsg));
+        } else {
+            sensorSizes[channel].store((static_cast<uint32_t>(width) << 16) | static_cast<uint32_t>(height),
+                                       std::memory_order_relaxed);
+        }
+        uint32_t sensorSize = sensorSizes[channel].load(std::memory_order_relaxed);
+        const SensorChannelInfo& info = sensor_channels::info(channel);
+
+        // 센서 포맷을 BGR로 변환
+        auto pyramid = pyramidPools[channel].acquire();
+        cv::Mat& bgr = pyramid->base();
+        try {
+            kernel->convert(reinterpret_cast<const uint8_t*>(imageData), width, height, bgr);
+        } catch (...) {
+            // The frame never reaches a tile, so nothing else gives its budget back
+            MemoryGovernor::instance().release(framesBudget, bytes);
+            throw;
+        }
+        pyramid->sensorSize = sensorSize ? cv::Size(sensorSize >> 16, sensorSize & 0xFFFF)
+                                         : cv::Size(info.width, info.height);
+        pyramid->region = cv::Rect(origin.x, origin.y, width, height);
+        {
+            TraceSpan overlaySpan("overlay");
+            recognition.draw(sensorMsg.mChannel, sensorMsg.mTimestamp, bgr,
+                static_cast<float>(output.width) / width, static_cast<float>(output.height) / height, origin);
+        }
+        if (framePublisher && bgr.isContinuous()) {
+            // One copy whatever the number of readers; they map the slot directly
+            frame_shm::FrameMeta meta{};
+            meta.frameNumber = sensorMsg.mFrameNumber;
+            meta.capturedNs = timing.capturedNs;
+            meta.traceId = Tracer::currentId();
+            meta.width = bgr.cols;
+            meta.height = bgr.rows;
+            meta.stride = static_cast<uint32_t>(bgr.step);
+            meta.format = bgr.type();
+            meta.bytes = bgr.total() * bgr.elemSize();
+            framePublisher->publish(sensorMsg.mChannel, meta, bgr.data);
+        }
+        publishFrame(tile, std::move(pyramid), bytes, timing.capturedNs);
+    }
+    else if (sensorMsg.mSensorType == 2) {
+        TraceSpan span("rasterize");
+        size_t bytes = static_cast<size_t>(LidarBevRasterizer::kGridSize) * LidarBevRasterizer::kGridSize * 3 * 4 / 3;
+        if (!MemoryGovernor::instance().acquire(framesBudget, sensorMsg.mChannel, bytes)) {
+            return;
+        }
+
+        auto pyramid = pyramidPools[sensorMsg.mChannel].acquire();
+        lidarBev.addSweep(sensorMsg.mChannel, reinterpret_cast<const stLidarPoint*>(imageData),
+            sensorMsg.mNumPoints, pyramid->base());
+        publishFrame(ImageViewer::kLidarTile, std::move(pyramid), bytes, timing.capturedNs);
+    }
+    else if (sensorMsg.mSensorType == 3) {
+        recognition.addResults(sensorMsg.mChannel, sensorMsg.mTimestamp,
+            reinterpret_cast<const stRecognitionObject*>(imageData), sensorMsg.mNumPoints);
     }
 }
+
+void ControlApp::sendRegionsOfInterest() {
+    std::vector<stChannelRoi> rois;
+    uint32_t requested = tcpClient->getRequestedChannels();
+    for (const auto& sensor : sensor_channels::kTable) {
+        if (!sensor.isImage() || !(requested & sensor.mask())) continue;
+        size_t channel = static_cast<size_t>(sensor.channel);
+        uint8_t tile = channelTiles[channel].load(std::memory_order_relaxed);
+        if (tile == kNoTile) continue;
+        const QRectF& view = tileViews[tile];
+        if (view.width() >= 1.0 && view.height() >= 1.0) continue;
+
+        uint32_t size = sensorSizes[channel].load(std::memory_order_relaxed);
+        int width = size ? static_cast<int>(size >> 16) : sensor.width;
+        int height = size ? static_cast<int>(size & 0xFFFF) : sensor.height;
+        // An eighth of the view on every side, so a short pan stays inside the
+        // region until the next one arrives; rounded outwards to even pixels
+        double marginX = view.width() / 8;
+        double marginY = view.height() / 8;
+        int x0 = std::max(0, static_cast<int>(std::floor((view.left() - marginX) * width))) & ~1;
+        int y0 = std::max(0, static_cast<int>(std::floor((view.top() - marginY) * height))) & ~1;
+        int x1 = std::min(width, (static_cast<int>(std::ceil((view.right() + marginX) * width)) + 1) & ~1);
+        int y1 = std::min(height, (static_cast<int>(std::ceil((view.bottom() + marginY) * height)) + 1) & ~1);
+        if (x1 - x0 < 2 || y1 - y0 < 2) continue;
+        rois.push_back(stChannelRoi{static_cast<uint8_t>(channel), static_cast<uint16_t>(x0), static_cast<uint16_t>(y0),
+                                    static_cast<uint16_t>(x1 - x0), static_cast<uint16_t>(y1 - y0)});
+    }
+    tcpClient->setChannelRois(std::move(rois));
+}
+
+void ControlApp::publishFrame(int tile, std::shared_ptr<FramePyramid> pyramid, size_t bytes, uint64_t capturedNs) {
+    // Build the pyramid level the tile currently needs here, off the GUI thread
+    pyramid->rebuild();
+    pyramid->traceId = Tracer::currentId();
+    pyramid->capturedNs = capturedNs;
+    pyramid->budgetBytes = bytes;
+    QSize target = imageViewer->tileSize(tile);
+    pyramid->fit(target.width(), target.height());
+
+    imageViewer->post(tile, std::move(pyramid));
+}
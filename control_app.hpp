@@ -7,6 +7,7 @@
 #include <QtWidgets/QPushButton>
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QLineEdit>
+#include <QtWidgets/QSlider>
 #include <QtCore/QTimer>
 #include <QtGui/QCloseEvent>
 #include <vector>
@@ -15,11 +16,25 @@
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
 #include <boost/asio.hpp>
 #include "messages.hpp"
 #include "image_viewer.hpp"
+#include "pixel_formats.hpp"
+#include "lidar_bev.hpp"
+#include "recognition_overlay.hpp"
+#include "clock_sync.hpp"
+#include "frame_shm.hpp"
+#include "session_file.hpp"
+#include "video_export.hpp"
+#include "session_playback.hpp"
 
 class TcpClient;
+class TelemetryPanel;
+class PcapIngest;
+struct FanOutResult;
 
 struct Backend {
     std::string host;
@@ -33,9 +48,9 @@ class ControlApp : public QMainWindow {
     Q_OBJECT
 
 public:
-    ControlApp(QWidget* parent = nullptr);
+    explicit ControlApp(std::chrono::steady_clock::time_point launchTime, QWidget* parent = nullptr);
     ~ControlApp();
-    void processData(const char* imageData, int sensorType, int width, int height);
+    void processData(const char* imageData, const stDataSensorReqMsg& sensorMsg, const FrameTiming& timing);
 
 protected:
     void closeEvent(QCloseEvent* event) override;
@@ -46,30 +61,108 @@ private slots:
     void toggleAction();
     void sendEvent();
     void enableEventButton();
+    void updateMemoryStatus();
+    void toggleTracing();
+    void toggleRecording();
+    void exportSession();
+    void openSession();
+    void closeSession();
+    void togglePlayback();
+    void cycleSpeed();
+    void seekTimeline(int value);
+    void updatePlaybackStatus();
 
 private:
     void setupUI();
+    void buildBackendRows();
+    void finishStartup();
     void centerWindow();
+    bool dropOldestFrame(uint8_t channel);
+    void preallocateFrames(uint32_t channelMask);
+    void assignTiles(uint32_t channelMask);
+    void decodeFrame(const char* imageData, const stDataSensorReqMsg& sensorMsg, const FrameTiming& timing);
+    void publishFrame(int tile, std::shared_ptr<FramePyramid> pyramid, size_t bytes, uint64_t capturedNs);
+    void sendRegionsOfInterest();
+    void reportFanOut(const char* command, const FanOutResult& result);
+    void updateStatusLabels();
+
+    static constexpr std::chrono::milliseconds kCommandDeadline{500};
     std::vector<Backend> backends;
     std::vector<QLineEdit*> ipInputs;
     std::vector<QLineEdit*> portInputs1;
     std::vector<QLineEdit*> portInputs2;
     std::vector<QLabel*> statusLabels;
+    std::vector<QString> commandStatus;
+    QLabel* memoryLabel;
+    QLabel* receiveLabel;
     QPushButton* toggleBtn;
     QPushButton* eventBtn;
     QPushButton* applyBtn;
+    QPushButton* traceBtn;
+    QPushButton* recordBtn;
+    QPushButton* exportBtn;
+    QLabel* recordLabel;
+    QPushButton* openSessionBtn;
+    QPushButton* playBtn;
+    QPushButton* stepBackBtn;
+    QPushButton* stepForwardBtn;
+    QPushButton* speedBtn;
+    QSlider* timelineSlider;
+    QLabel* playbackLabel;
+    QTimer* playbackTimer;
     QTimer* timer;
     QTimer* statusTimer;
-    ImageViewer* imageViewer;
+    QTimer* memoryTimer;
+    QTimer* roiTimer = nullptr;  // coalesces pan/zoom into one data request
+    ImageViewer* imageViewer = nullptr;  // created once the main window is up
+    QGridLayout* configLayout;
+    TelemetryPanel* telemetryPanel;
     TcpClient* tcpClient;
 
     bool isToggleOn;
     bool eventSent;
     uint32_t messageCounter;
     bool serverConnected;
+    std::chrono::steady_clock::time_point launched;  // process start, for the startup report
+    // OpenCV warm-up and decode targets, built off the GUI thread after the first paint
+    std::thread pipelineInit;
+    std::atomic<bool> pipelineReady{false};
+    // Set by CONTROL_APP_PCAP: the capture replaces the backends and runs once the pipeline is ready
+    std::unique_ptr<PcapIngest> pcapIngest;
+    uint64_t lastFrameCount = 0;
+    uint64_t lastByteCount = 0;
+    // Set by CONTROL_APP_ALLOC_CHECK: report heap allocations on the frame path
+    bool allocCheck = false;
+    uint64_t lastAllocCount = 0;
+
+    // Decoded frames waiting for the compositor are charged to the "frames" budget
+    int framesBudget;
+    // Decode targets per sensor channel, reused once the viewer has moved on
+    std::array<FramePyramidPool, static_cast<size_t>(eSensorChannel::CHANNEL_MAX)> pyramidPools;
+
+    // Pixel kernel each sensor channel last decoded with, to report format changes once
+    std::array<std::atomic<const PixelKernel*>, static_cast<size_t>(eSensorChannel::CHANNEL_MAX)> channelKernels{};
+
+    // Viewer tile per channel. Cameras get one tile each so no two overwrite
+    // each other; kNoTile for cameras not shown. LiDARs share the merged view.
+    static constexpr uint8_t kNoTile = 0xFF;
+    std::array<std::atomic<uint8_t>, static_cast<size_t>(eSensorChannel::CHANNEL_MAX)> channelTiles{};
+
+    // Zoomed tiles stream their visible region at full resolution; the sensor
+    // size (width << 16 | height) comes from the last whole frame of each channel
+    std::array<QRectF, sensor_tile::kCount> tileViews;
+    std::array<std::atomic<uint32_t>, static_cast<size_t>(eSensorChannel::CHANNEL_MAX)> sensorSizes{};
+
+    LidarBevRasterizer lidarBev;
+    RecognitionOverlay recognition;
+
+    // Decoded camera frames for local consumer processes; set when CONTROL_APP_SHM names a segment
+    std::unique_ptr<FrameShmPublisher> framePublisher;
+
+    std::shared_ptr<SessionRecorder> recorder;
+    std::unique_ptr<VideoExporter> exporter;
 
-    std::thread dataThread;
-    std::thread receiveThread;
-    std::atomic<bool> stopDataThread{false};
-    std::atomic<bool> stopReceiveThread{false};
+    // While a session plays back, live camera frames stay off the tiles
+    std::unique_ptr<SessionPlayback> playback;
+    std::atomic<bool> playbackActive{false};
 }; 
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "data_stream.hpp"
+#include "tcp_client.hpp"
+#include "trace.hpp"
+#include <iostream>
+
+using boost::asio::ip::tcp;
+using boost::system::error_code;
+
+namespace {
+    constexpr auto kHandshakeTimeout = std::chrono::seconds(3);
+    constexpr int kBulkReceiveBuffer = 4 << 20;
+    constexpr int kLatencyReceiveBuffer = 64 << 10;
+}
+
+const char* toString(SessionState state) {
+    switch (state) {
+        case SessionState::Disconnected: return "Not Connected";
+        case SessionState::Connecting: return "Connecting";
+        case SessionState::Linking: return "Linking";
+        case SessionState::RecInfo: return "Configuring";
+        case SessionState::Streaming: return "Streaming";
+    }
+    return "Unknown";
+}
+
+DataStream::DataStream(TcpClient& client, Backend& backend, size_t backendIndex, const StreamSpec& spec,
+                       bool primary, boost::asio::io_context& io) :
+    client(client), backendRef(backend), backendIndex(backendIndex), streamSpec(spec), primary(primary),
+    strand(boost::asio::make_strand(io)), timer(strand),
+    parser(client.getPayloadPool(spec.latencySensitive), client.getMutableReceiveStats()) {
+}
+
+void DataStream::start(const std::string& newHost, uint16_t newPort, FailHandler failHandler, StreamingHandler streamingHandler) {
+    boost::asio::post(strand, [self = shared_from_this(), newHost, newPort, failHandler, streamingHandler]() {
+        self->host = newHost;
+        self->port = newPort;
+        self->onFail = failHandler;
+        self->onStreaming = streamingHandler;
+        self->connect();
+    });
+}
+
+void DataStream::stop() {
+    boost::asio::post(strand, [self = shared_from_this()]() {
+        ++self->generation;
+        self->timer.cancel();
+        self->closeSocket();
+        self->enter(SessionState::Disconnected);
+        // Drop the handlers; they hold the owning session
+        self->onFail = nullptr;
+        self->onStreaming = nullptr;
+    });
+}
+
+void DataStream::requestData() {
+    boost::asio::post(strand, [self = shared_from_this()]() {
+        if (self->state() == SessionState::Streaming) {
+            self->sendDataRequest();
+        }
+    });
+}
+
+void DataStream::connect() {
+    uint64_t gen = ++generation;
+    closeSocket();
+    enter(SessionState::Connecting);
+    parser.reset();
+
+    tcp::endpoint endpoint;
+    try {
+        endpoint = tcp::endpoint(boost::asio::ip::make_address(host), port);
+    } catch (const std::exception& e) {
+        fail(std::string("invalid address: ") + e.what());
+        return;
+    }
+
+    socket = std::make_shared<tcp::socket>(strand);
+    if (primary) {
+        backendRef.sockets[0] = socket;
+    }
+    socket->async_connect(endpoint, [self = shared_from_this(), gen](const error_code& error) {
+        if (gen != self->generation) return;
+        if (error) {
+            self->fail("connect: " + error.message());
+            return;
+        }
+
+        error_code ignored;
+        if (self->streamSpec.latencySensitive) {
+            self->socket->set_option(tcp::no_delay(true), ignored);
+            self->socket->set_option(boost::asio::socket_base::receive_buffer_size(kLatencyReceiveBuffer), ignored);
+        } else {
+            self->socket->set_option(boost::asio::socket_base::receive_buffer_size(kBulkReceiveBuffer), ignored);
+        }
+
+        if (self->primary) {
+            self->backendRef.ready = true;
+        }
+        self->readData(gen);
+        self->enter(SessionState::Linking);
+        self->linkSentNs = Tracer::now();
+        self->queueWrite(std::make_shared<const std::string>(self->client.encodeHeader(MessageType::LINK)));
+        std::cout << "[SEND] LINK " << self->backendRef.name << " (" << self->streamSpec.name << ")" << std::endl;
+    });
+}
+
+void DataStream::enter(SessionState next) {
+    currentState.store(next, std::memory_order_relaxed);
+    if (next != SessionState::Linking && next != SessionState::RecInfo) {
+        if (next != SessionState::Disconnected) timer.cancel();
+        return;
+    }
+
+    uint64_t gen = generation;
+    timer.expires_after(kHandshakeTimeout);
+    timer.async_wait([self = shared_from_this(), gen, next](const error_code& error) {
+        if (error || gen != self->generation || self->state() != next) return;
+        self->fail(std::string("no reply while ") + toString(next));
+    });
+}
+
+void DataStream::readData(uint64_t gen) {
+    auto span = parser.prepare();
+    uint64_t readBeginNs = Tracer::enabled() ? Tracer::now() : 0;
+    boost::asio::async_read(*socket, boost::asio::buffer(span.data, span.size),
+        [self = shared_from_this(), gen, readBeginNs](const error_code& error, std::size_t bytes) {
+            if (gen != self->generation) return;
+            if (error) {
+                self->fail("read: " + error.message());
+                return;
+            }
+            // socket_read is the wait for the bytes, parse the framing of them;
+            // the read that completes a frame carries that frame's trace id
+            uint64_t readEndNs = readBeginNs ? Tracer::now() : 0;
+            TraceSpan parseSpan("parse");
+            auto result = self->parser.commit(bytes);
+            uint64_t traceId = Tracer::currentId();
+            if (result == ProtocolParser::Complete && self->parser.hasSensorMessage()) {
+                traceId = Tracer::makeTraceId(self->parser.header().timestamp,
+                                              self->parser.sensorMessage().mFrameNumber);
+            }
+            parseSpan.setTraceId(traceId);
+            parseSpan.end();
+            if (readEndNs && Tracer::enabled()) {
+                Tracer::instance().record("socket_read", traceId, readBeginNs, readEndNs);
+            }
+            if (result == ProtocolParser::Malformed) {
+                // Without a sync marker the stream cannot be re-framed; reconnect
+                self->fail(std::string("malformed message: ") + self->parser.error());
+                return;
+            }
+            if (result == ProtocolParser::Complete) {
+                self->onMessage();
+                if (gen != self->generation) return;
+            }
+            self->readData(gen);
+        });
+}
+
+void DataStream::onMessage() {
+    uint8_t type = parser.header().messageType;
+    switch (state()) {
+        case SessionState::Linking:
+            if (type == MessageType::LINK_ACK) {
+                client.getClockSync(backendIndex).addRoundTrip(linkSentNs, parser.header().timestamp, Tracer::now());
+                std::cout << "[RECV] LINK_ACK " << backendRef.name << " (" << streamSpec.name << ")" << std::endl;
+                enter(SessionState::RecInfo);
+                queueWrite(std::make_shared<const std::string>(client.encodeHeader(MessageType::REC_INFO)));
+            }
+            break;
+        case SessionState::RecInfo:
+            if (type == MessageType::REC_INFO_ACK) {
+                std::cout << "[RECV] REC_INFO_ACK " << backendRef.name << " (" << streamSpec.name << ")" << std::endl;
+                enter(SessionState::Streaming);
+                sendDataRequest();
+                if (onStreaming) onStreaming();
+            }
+            break;
+        case SessionState::Streaming:
+            if (parser.hasSensorMessage()) {
+                client.dispatchFrame(backendIndex, streamSpec.dataType, parser);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void DataStream::sendDataRequest() {
+    queueWrite(std::make_shared<const std::string>(
+        client.encodeDataRequest(streamSpec.dataType, streamSpec.channelMask)));
+}
+
+void DataStream::queueWrite(Buffer data) {
+    writeQueue.push_back(std::move(data));
+    if (writeQueue.size() == 1) {
+        writeNext(generation);
+    }
+}
+
+void DataStream::writeNext(uint64_t gen) {
+    if (writeQueue.empty()) return;
+    if (!socket || !socket->is_open()) {
+        writeQueue.clear();
+        return;
+    }
+
+    Buffer data = writeQueue.front();
+    boost::asio::async_write(*socket, boost::asio::buffer(*data),
+        [self = shared_from_this(), gen, data](const error_code& error, std::size_t) {
+            if (gen != self->generation) return;
+            self->writeQueue.pop_front();
+            if (error) {
+                self->fail("write: " + error.message());
+                return;
+            }
+            self->writeNext(gen);
+        });
+}
+
+void DataStream::closeSocket() {
+    if (socket) {
+        error_code ignored;
+        socket->close(ignored);
+    }
+    writeQueue.clear();
+    if (primary) {
+        backendRef.ready = false;
+    }
+}
+
+void DataStream::fail(const std::string& reason) {
+    ++generation;
+    timer.cancel();
+    closeSocket();
+    enter(SessionState::Disconnected);
+    if (onFail) onFail(reason);
+}
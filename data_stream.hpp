@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+#include "messages.hpp"
+#include "protocol_parser.hpp"
+
+class TcpClient;
+struct Backend;
+
+enum class SessionState : uint8_t {
+    Disconnected,
+    Connecting,
+    Linking,    // LINK sent, waiting for LINK_ACK
+    RecInfo,    // REC_INFO sent, waiting for REC_INFO_ACK
+    Streaming,  // DATA_SEND_REQUEST sent, receiving DATA_SENSOR
+};
+
+const char* toString(SessionState state);
+
+// What one data connection carries. Latency-sensitive streams run with Nagle
+// off, small socket buffers and their own reassembly pool, so they never wait
+// behind bulk camera payloads.
+struct StreamSpec {
+    uint8_t dataType;
+    uint32_t channelMask;  // subset of the requested channels, 0 for all of them
+    bool latencySensitive;
+    const char* name;
+};
+
+// One data connection of a backend and its LINK -> REC_INFO -> DATA_SEND_REQUEST
+// handshake. Each stream has its own strand, parser and write queue, so a large
+// payload on one connection never delays messages on another.
+class DataStream : public std::enable_shared_from_this<DataStream> {
+public:
+    using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
+    using FailHandler = std::function<void(const std::string& reason)>;
+    using StreamingHandler = std::function<void()>;
+
+    // The primary stream publishes its socket as backend.sockets[0]
+    DataStream(TcpClient& client, Backend& backend, size_t backendIndex, const StreamSpec& spec,
+               bool primary, boost::asio::io_context& io);
+
+    void start(const std::string& host, uint16_t port, FailHandler onFail, StreamingHandler onStreaming);
+    void stop();
+    void requestData();
+
+    SessionState state() const { return currentState.load(std::memory_order_relaxed); }
+    const StreamSpec& spec() const { return streamSpec; }
+
+private:
+    using Buffer = std::shared_ptr<const std::string>;
+
+    void connect();
+    void enter(SessionState next);
+    void readData(uint64_t gen);
+    void onMessage();
+    void sendDataRequest();
+    void queueWrite(Buffer data);
+    void writeNext(uint64_t gen);
+    void closeSocket();
+    void fail(const std::string& reason);
+
+    TcpClient& client;
+    Backend& backendRef;
+    size_t backendIndex;
+    StreamSpec streamSpec;
+    bool primary;
+    Strand strand;
+    boost::asio::steady_timer timer;
+    ProtocolParser parser;
+    std::shared_ptr<boost::asio::ip::tcp::socket> socket;
+
+    std::string host;
+    uint16_t port = 0;
+    FailHandler onFail;
+    StreamingHandler onStreaming;
+
+    std::atomic<SessionState> currentState{SessionState::Disconnected};
+    uint64_t generation = 0;  // bumped on every (re)connect so stale handlers bail out
+    uint64_t linkSentNs = 0;  // LINK/LINK_ACK doubles as a clock-sync round trip
+    std::deque<Buffer> writeQueue;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit hash of a whole payload for spotting byte-identical frames. Four
+// independent xxHash64-style lanes keep the multipliers busy, so a 4 MiB
+// UYVY frame hashes in well under a millisecond.
+uint64_t hashPayload(const void* data, size_t size, uint64_t seed = 0);
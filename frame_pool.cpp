@@ -0,0 +1,65 @@
+#include "frame_pool.hpp"
+#include "memory_governor.hpp"
+
+void FramePool::Recycler::operator()(char* data) const {
+    if (pool) {
+        MemoryGovernor::instance().release(pool->budgetId, capacity);
+        pool->recycle(data, capacity);
+    } else {
+        delete[] data;
+    }
+}
+
+FramePool::FramePool(const std::string& name, size_t budgetBytes, size_t maxCached) :
+    maxCached(maxCached) {
+    budgetId = MemoryGovernor::instance().registerBudget(name, budgetBytes);
+}
+
+FramePool::~FramePool() {
+    for (auto& entry : freeList) {
+        delete[] entry.first;
+    }
+}
+
+FramePool::Buffer FramePool::acquire(uint8_t channel, size_t size) {
+    char* data = nullptr;
+    size_t capacity = size;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < freeList.size(); ++i) {
+            if (freeList[i].second >= size) {
+                data = freeList[i].first;
+                capacity = freeList[i].second;
+                freeList[i] = freeList.back();
+                freeList.pop_back();
+                break;
+            }
+        }
+    }
+
+    if (!MemoryGovernor::instance().acquire(budgetId, channel, capacity)) {
+        if (data) recycle(data, capacity);
+        return Buffer(nullptr, Recycler{});
+    }
+    if (!data) {
+        data = new char[capacity];
+    }
+    return Buffer(data, Recycler{this, capacity});
+}
+
+void FramePool::reserve(size_t size, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    freeList.reserve(maxCached);
+    for (size_t i = 0; i < count && freeList.size() < maxCached; ++i) {
+        freeList.emplace_back(new char[size], size);
+    }
+}
+
+void FramePool::recycle(char* data, size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeList.size() < maxCached) {
+        freeList.emplace_back(data, capacity);
+    } else {
+        delete[] data;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Recycles large receive buffers instead of allocating one per frame.
+// Buffers handed out are charged to a MemoryGovernor budget until returned.
+class FramePool {
+public:
+    struct Recycler {
+        FramePool* pool = nullptr;
+        size_t capacity = 0;
+        void operator()(char* data) const;
+    };
+    using Buffer = std::unique_ptr<char[], Recycler>;
+
+    FramePool(const std::string& name, size_t budgetBytes, size_t maxCached = 8);
+    ~FramePool();
+
+    // Returns an empty Buffer when the governor refuses the allocation.
+    Buffer acquire(uint8_t channel, size_t size);
+    // Caches count buffers of size up front, within maxCached; they are charged when acquired
+    void reserve(size_t size, size_t count);
+    int budget() const { return budgetId; }
+
+private:
+    void recycle(char* data, size_t capacity);
+
+    std::mutex mutex;
+    std::vector<std::pair<char*, size_t>> freeList;
+    size_t maxCached;
+    int budgetId;
+};
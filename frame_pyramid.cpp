@@ -0,0 +1,69 @@
+#include "frame_pyramid.hpp"
+#include <algorithm>
+#include <atomic>
+
+FramePyramid::FramePyramid(cv::Mat base) :
+    baseWidth(base.cols), baseHeight(base.rows) {
+    levels[0] = std::move(base);
+}
+
+void FramePyramid::rebuild() {
+    std::lock_guard<std::mutex> lock(mutex);
+    builtLevels = 1;
+    baseWidth = levels[0].cols;
+    baseHeight = levels[0].rows;
+}
+
+const cv::Mat& FramePyramid::level(int index) {
+    if (index < 0) index = 0;
+    if (index >= kLevels) index = kLevels - 1;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = builtLevels; i <= index; ++i) {
+        const cv::Mat& src = levels[i - 1];
+        if (src.cols < 2 || src.rows < 2) return src;
+        // An exact 2:1 INTER_AREA resize is OpenCV's vectorized 2x2 box filter
+        cv::resize(src, levels[i], cv::Size(src.cols / 2, src.rows / 2), 0, 0, cv::INTER_AREA);
+        builtLevels = i + 1;
+    }
+    return levels[index];
+}
+
+int FramePyramid::levelFor(int targetWidth, int targetHeight) const {
+    int index = 0;
+    while (index + 1 < kLevels &&
+           (baseWidth >> (index + 1)) >= targetWidth &&
+           (baseHeight >> (index + 1)) >= targetHeight) {
+        ++index;
+    }
+    return index;
+}
+
+const cv::Mat& FramePyramid::fit(int targetWidth, int targetHeight) {
+    return level(levelFor(targetWidth, targetHeight));
+}
+
+void FramePyramidPool::reserve(size_t count, cv::Size frameSize) {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (pyramids.size() < std::min(count, capacity)) {
+        auto pyramid = std::make_shared<FramePyramid>();
+        pyramid->base().create(frameSize, CV_8UC3);
+        pyramids.push_back(std::move(pyramid));
+    }
+}
+
+std::shared_ptr<FramePyramid> FramePyramidPool::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& pyramid : pyramids) {
+        if (pyramid.use_count() == 1) {
+            // The last other owner's reads happen before its release of the count
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return pyramid;
+        }
+    }
+    auto pyramid = std::make_shared<FramePyramid>();
+    if (pyramids.size() < capacity) {
+        pyramids.push_back(pyramid);
+    }
+    return pyramid;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Multi-resolution cache of one decoded frame (1/1, 1/2, 1/4, 1/8).
+// Level 0 is the full BGR frame; smaller levels are built on first use.
+class FramePyramid {
+public:
+    static constexpr int kLevels = 4;
+
+    FramePyramid() = default;
+    explicit FramePyramid(cv::Mat base);
+
+    // Level 0 for the decoder to write into; its buffer and those of the smaller
+    // levels are reused when the pyramid is recycled at the same frame size
+    cv::Mat& base() { return levels[0]; }
+    // Drops the smaller levels after base() was rewritten
+    void rebuild();
+
+    const cv::Mat& level(int index);
+    int levelFor(int targetWidth, int targetHeight) const;
+    const cv::Mat& fit(int targetWidth, int targetHeight);
+
+    int width() const { return baseWidth; }
+    int height() const { return baseHeight; }
+
+    uint64_t traceId = 0;
+    uint64_t capturedNs = 0;  // capture time on the local monotonic clock
+    cv::Size sensorSize;      // full sensor image, in sensor pixels
+    cv::Rect region;          // part of it the base level shows; all of it unless cut to an ROI
+    size_t budgetBytes = 0;   // charged to the memory governor until displayed or replaced
+
+private:
+    std::mutex mutex;
+    std::array<cv::Mat, kLevels> levels;
+    int builtLevels = 1;  // levels[0, builtLevels) belong to the current frame
+    int baseWidth = 0;
+    int baseHeight = 0;
+};
+
+// Pyramids of one stream, handed out again once nothing else holds them, so a
+// steady stream decodes and downsamples into the same buffers every frame.
+class FramePyramidPool {
+public:
+    explicit FramePyramidPool(size_t capacity = 6) : capacity(capacity) {}
+
+    // A pyramid with no other owners; beyond the capacity a temporary one
+    std::shared_ptr<FramePyramid> acquire();
+    // Builds count pyramids with a BGR base of the given size ahead of the first frame
+    void reserve(size_t count, cv::Size frameSize);
+
+private:
+    std::mutex mutex;
+    std::vector<std::shared_ptr<FramePyramid>> pyramids;
+    size_t capacity;
+};
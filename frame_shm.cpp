@@ -0,0 +1,217 @@
+#include "frame_shm.hpp"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <new>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace frame_shm;
+
+namespace {
+    constexpr uint64_t kPageSize = 4096;
+
+    uint64_t dataOffset() {
+        return (sizeof(SegmentHeader) + kPageSize - 1) / kPageSize * kPageSize;
+    }
+
+    uint64_t monotonicNs() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    // Shared (not FUTEX_PRIVATE) operations: the word lives in a mapping of several processes
+    void futexWake(std::atomic<uint32_t>* word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    void futexWait(std::atomic<uint32_t>* word, uint32_t expected, const timespec* timeout) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+    }
+}
+
+std::unique_ptr<FrameShmPublisher> FrameShmPublisher::create(const std::string& name, uint64_t slotBytes) {
+    // Whole pages per slot so every frame starts page-aligned
+    slotBytes = (slotBytes + kPageSize - 1) / kPageSize * kPageSize;
+    size_t size = dataOffset() + static_cast<uint64_t>(kChannels) * kSlotsPerChannel * slotBytes;
+
+    // A segment left over from a crashed run is replaced, not reused
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "[SHM] shm_open " << name << ": " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+    // Sparse: only slots that are actually written take memory
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        std::cerr << "[SHM] ftruncate " << name << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "[SHM] mmap " << name << ": " << std::strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    auto* header = new (base) SegmentHeader();
+    header->channelCount = kChannels;
+    header->slotsPerChannel = kSlotsPerChannel;
+    header->slotBytes = slotBytes;
+    header->dataOffset = dataOffset();
+    // Readers check the magic last, so they never see a half-initialized header
+    header->version = kVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = kMagic;
+
+    std::cout << "[SHM] publishing frames to " << name << " (" << (slotBytes >> 20)
+              << " MiB x " << kSlotsPerChannel << " slots per channel)" << std::endl;
+    return std::unique_ptr<FrameShmPublisher>(new FrameShmPublisher(name, base, size));
+}
+
+FrameShmPublisher::FrameShmPublisher(std::string name, void* base, size_t size) :
+    name(std::move(name)), base(base), size(size), header(static_cast<SegmentHeader*>(base)) {
+}
+
+FrameShmPublisher::~FrameShmPublisher() {
+    // Readers keep their mapping; the name goes away so no new reader attaches to a dead segment
+    munmap(base, size);
+    shm_unlink(name.c_str());
+}
+
+bool FrameShmPublisher::publish(uint8_t channel, const FrameMeta& meta, const void* data) {
+    if (channel >= kChannels || meta.bytes > header->slotBytes) return false;
+
+    // Channels normally have one writer; this only guards a reconnect overlap
+    if (writing[channel].test_and_set(std::memory_order_acquire)) return false;
+
+    Channel& ch = header->channels[channel];
+    uint32_t index = (ch.latestSlot.load(std::memory_order_relaxed) + 1) % kSlotsPerChannel;
+    Slot& slot = ch.ring[index];
+    uint8_t* dst = static_cast<uint8_t*>(base) + header->dataOffset
+                 + (static_cast<uint64_t>(channel) * kSlotsPerChannel + index) * header->slotBytes;
+
+    uint64_t seq = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.meta = meta;
+    slot.meta.publishedNs = monotonicNs();
+    std::memcpy(dst, data, meta.bytes);
+    slot.sequence.store(seq + 2, std::memory_order_release);
+
+    ch.latestSlot.store(index, std::memory_order_release);
+    ch.published.fetch_add(1, std::memory_order_seq_cst);
+    if (ch.waiters.load(std::memory_order_seq_cst) > 0) {
+        futexWake(&ch.published);
+    }
+    writing[channel].clear(std::memory_order_release);
+    return true;
+}
+
+FrameShmReader::~FrameShmReader() {
+    close();
+}
+
+bool FrameShmReader::open(const std::string& name) {
+    close();
+    // Read-write only for the waiter count; readers never touch slots or frames
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SegmentHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    auto* candidate = static_cast<SegmentHeader*>(mapped);
+    bool compatible = candidate->magic == kMagic;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    compatible = compatible && candidate->version == kVersion
+        && candidate->channelCount == kChannels && candidate->slotsPerChannel == kSlotsPerChannel
+        && candidate->dataOffset + static_cast<uint64_t>(kChannels) * kSlotsPerChannel * candidate->slotBytes
+               <= static_cast<uint64_t>(st.st_size);
+    if (!compatible) {
+        munmap(mapped, st.st_size);
+        return false;
+    }
+
+    base = mapped;
+    size = st.st_size;
+    header = candidate;
+    return true;
+}
+
+void FrameShmReader::close() {
+    if (base) {
+        munmap(base, size);
+    }
+    base = nullptr;
+    size = 0;
+    header = nullptr;
+}
+
+bool FrameShmReader::latest(uint8_t channel, Frame& frame) const {
+    if (!header || channel >= kChannels) return false;
+    const Channel& ch = header->channels[channel];
+    if (ch.published.load(std::memory_order_acquire) == 0) return false;
+
+    // A slot overwritten while we copy its metadata is retried with the newer latest slot
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        uint32_t index = ch.latestSlot.load(std::memory_order_acquire);
+        const Slot& slot = ch.ring[index];
+        uint64_t seq = slot.sequence.load(std::memory_order_acquire);
+        if (seq & 1) continue;
+        frame.meta = slot.meta;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != seq) continue;
+
+        frame.slot = &slot;
+        frame.sequence = seq;
+        frame.data = static_cast<const uint8_t*>(base) + header->dataOffset
+                   + (static_cast<uint64_t>(channel) * kSlotsPerChannel + index) * header->slotBytes;
+        return true;
+    }
+    return false;
+}
+
+bool FrameShmReader::stillValid(const Frame& frame) const {
+    if (!frame.slot) return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return frame.slot->sequence.load(std::memory_order_relaxed) == frame.sequence;
+}
+
+uint32_t FrameShmReader::waitForFrame(uint8_t channel, uint32_t seen, std::chrono::milliseconds timeout) const {
+    if (!header || channel >= kChannels) return seen;
+    Channel& ch = header->channels[channel];
+
+    uint32_t current = ch.published.load(std::memory_order_acquire);
+    if (current != seen) return current;
+
+    // Registering before the re-check pairs with the publisher's increment-then-load:
+    // either it sees the waiter, or we see its new counter
+    ch.waiters.fetch_add(1, std::memory_order_seq_cst);
+    current = ch.published.load(std::memory_order_seq_cst);
+    if (current == seen) {
+        auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+        timespec ts{static_cast<time_t>(secs.count()),
+                    static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - secs).count())};
+        futexWait(&ch.published, seen, &ts);
+        current = ch.published.load(std::memory_order_acquire);
+    }
+    ch.waiters.fetch_sub(1, std::memory_order_seq_cst);
+    return current;
+}
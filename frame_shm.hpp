@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Decoded frames shared with local processes through one POSIX shared-memory
+// segment. Every sensor channel has a small ring of slots, each guarded by a
+// seqlock; the publisher copies a frame in once and any number of readers map
+// it without copying. Readers block on a futex over the channel's publish
+// counter; the publisher only makes the wake syscall while someone waits.
+//
+//     FrameShmReader reader;
+//     if (reader.open("/control_app_frames")) {
+//         uint32_t seen = 0;
+//         while ((seen = reader.waitForFrame(channel, seen, std::chrono::seconds(1)))) {
+//             FrameShmReader::Frame frame;
+//             if (reader.latest(channel, frame)) {
+//                 use(frame.meta, frame.data);
+//                 if (!reader.stillValid(frame)) { /* overwritten meanwhile; discard */ }
+//             }
+//         }
+//     }
+namespace frame_shm {
+    constexpr uint32_t kMagic = 0x53464556;  // "VEFS"
+    constexpr uint32_t kVersion = 1;
+    constexpr uint32_t kChannels = 32;
+    constexpr uint32_t kSlotsPerChannel = 4;
+    constexpr uint64_t kDefaultSlotBytes = 8u << 20;
+
+    struct FrameMeta {
+        uint64_t frameNumber;
+        uint64_t capturedNs;   // publisher's monotonic clock
+        uint64_t publishedNs;
+        uint64_t traceId;
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;
+        uint32_t format;       // OpenCV type, CV_8UC3 for BGR
+        uint64_t bytes;
+    };
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence;  // odd while the publisher writes the slot
+        FrameMeta meta;
+    };
+
+    struct alignas(64) Channel {
+        std::atomic<uint32_t> published;  // futex word, bumped once per frame
+        std::atomic<uint32_t> waiters;
+        std::atomic<uint32_t> latestSlot;
+        Slot ring[kSlotsPerChannel];
+    };
+
+    struct SegmentHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t channelCount;
+        uint32_t slotsPerChannel;
+        uint64_t slotBytes;
+        uint64_t dataOffset;
+        Channel channels[kChannels];
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory atomics must be lock-free");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared-memory atomics must be lock-free");
+}
+
+class FrameShmPublisher {
+public:
+    // Creates (or replaces) the named segment; nullptr if shared memory is unavailable.
+    static std::unique_ptr<FrameShmPublisher> create(const std::string& name,
+                                                     uint64_t slotBytes = frame_shm::kDefaultSlotBytes);
+    ~FrameShmPublisher();
+
+    // One copy into the channel's next slot. Frames larger than a slot are skipped.
+    bool publish(uint8_t channel, const frame_shm::FrameMeta& meta, const void* data);
+
+    FrameShmPublisher(const FrameShmPublisher&) = delete;
+    FrameShmPublisher& operator=(const FrameShmPublisher&) = delete;
+
+private:
+    FrameShmPublisher(std::string name, void* base, size_t size);
+
+    std::string name;
+    void* base;
+    size_t size;
+    frame_shm::SegmentHeader* header;
+    std::atomic_flag writing[frame_shm::kChannels] = {};
+};
+
+class FrameShmReader {
+public:
+    struct Frame {
+        frame_shm::FrameMeta meta;
+        const uint8_t* data = nullptr;
+        const frame_shm::Slot* slot = nullptr;
+        uint64_t sequence = 0;
+    };
+
+    FrameShmReader() = default;
+    ~FrameShmReader();
+
+    bool open(const std::string& name);
+    void close();
+
+    // Latest frame of a channel, in place. data stays readable, but the frame is
+    // only known to be intact if stillValid() holds after it was used.
+    bool latest(uint8_t channel, Frame& frame) const;
+    bool stillValid(const Frame& frame) const;
+
+    // Blocks until the channel's publish counter moves past seen; returns the new
+    // counter, or seen again on timeout.
+    uint32_t waitForFrame(uint8_t channel, uint32_t seen, std::chrono::milliseconds timeout) const;
+
+    FrameShmReader(const FrameShmReader&) = delete;
+    FrameShmReader& operator=(const FrameShmReader&) = delete;
+
+private:
+    void* base = nullptr;
+    size_t size = 0;
+    frame_shm::SegmentHeader* header = nullptr;
+};
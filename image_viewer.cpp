@@ -1,9 +1,43 @@
 #include "image_viewer.hpp"
-#include <QImage>
-#include <QPixmap>
+#include "alloc_counter.hpp"
+#include "trace.hpp"
+#include "app_style.hpp"
+#include <QGuiApplication>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScreen>
+#include <algorithm>
+#include <cmath>
+
+QImage& TileLabel::frame(const QSize& size) {
+    if (image.size() != size) {
+        // RGB32 is drawn as is; other formats are converted on every paint
+        image = QImage(size, QImage::Format_RGB32);
+    }
+    return image;
+}
+
+void TileLabel::paintEvent(QPaintEvent* event) {
+    QLabel::paintEvent(event);
+    if (image.isNull()) return;
+    QRect target(QPoint(0, 0), image.size());
+    target.moveCenter(contentsRect().center());
+    QPainter painter(this);
+    painter.drawImage(target.topLeft(), image);
+}
 
 ImageViewer::ImageViewer(QWidget* parent) : QWidget(parent) {
     setupUI();
+
+    // One tick per display refresh, however many channels feed the tiles
+    double hz = 60.0;
+    if (QScreen* screen = QGuiApplication::primaryScreen()) {
+        hz = std::max(24.0, std::min(240.0, screen->refreshRate()));
+    }
+    refreshTimer = new QTimer(this);
+    refreshTimer->setTimerType(Qt::PreciseTimer);
+    QObject::connect(refreshTimer, &QTimer::timeout, this, &ImageViewer::composite);
+    refreshTimer->start(static_cast<int>(std::lround(1000.0 / hz)));
 }
 
 ImageViewer::~ImageViewer() {
@@ -17,38 +51,218 @@ void ImageViewer::setupUI() {
     layout->setSpacing(10);
     layout->setContentsMargins(10, 10, 10, 10);
 
-    for (int i = 0; i < 4; ++i) {
-        imageLabels[i] = new QLabel(this);
+    for (int i = 0; i < kTileCount; ++i) {
+        imageLabels[i] = new TileLabel(this);
         imageLabels[i]->setMinimumSize(320, 240);
         imageLabels[i]->setAlignment(Qt::AlignCenter);
-        imageLabels[i]->setStyleSheet("QLabel { background-color: black; }");
+        tileSizes[i] = (320u << 16) | 240u;
+        tileViews[i] = QRectF(0.0, 0.0, 1.0, 1.0);
+    }
+    for (int i = 0; i < kCameraTiles; ++i) {
+        imageLabels[i]->installEventFilter(this);
+    }
+    for (int i = 0; i < kCameraTiles; ++i) {
         layout->addWidget(imageLabels[i], i / 2, i % 2);
     }
+    // Merged LiDAR bird's-eye view to the right of the cameras
+    imageLabels[kLidarTile]->setMinimumSize(480, 480);
+    layout->addWidget(imageLabels[kLidarTile], 0, 2, 2, 1);
 
     setLayout(layout);
     setWindowTitle("Image Viewer");
-    resize(800, 600);
+    resize(1280, 600);
+}
+
+QSize ImageViewer::tileSize(int index) const {
+    if (index < 0 || index >= kTileCount) return QSize();
+    uint32_t packed = tileSizes[index].load(std::memory_order_relaxed);
+    return QSize(packed >> 16, packed & 0xFFFF);
+}
+
+void ImageViewer::setStalled(int index, bool stalled) {
+    if (index < 0 || index >= kTileCount || tileStalled[index] == stalled) return;
+    tileStalled[index] = stalled;
+    app_style::setState(imageLabels[index], "stalled", stalled);
+    imageLabels[index]->setToolTip(stalled ? "Stalled: the source keeps sending the same frame" : "");
 }
 
 void ImageViewer::updateImage(int index, const cv::Mat& image) {
-    if (index >= 0 && index < 4) {
+    if (index >= 0 && index < kTileCount) {
         convertAndDisplay(index, image);
     }
 }
 
-void ImageViewer::convertAndDisplay(int index, const cv::Mat& image) {
-    if (image.empty()) return;
-
-    cv::Mat rgbImage;
-    if (image.channels() == 1) {
-        cv::cvtColor(image, rgbImage, cv::COLOR_GRAY2RGB);
-    } else if (image.channels() == 3) {
-        cv::cvtColor(image, rgbImage, cv::COLOR_BGR2RGB);
-    } else {
+void ImageViewer::post(int index, std::shared_ptr<FramePyramid> pyramid) {
+    if (index < 0 || index >= kTileCount || !pyramid) return;
+    {
+        std::lock_guard<std::mutex> lock(mailboxMutex);
+        pyramid.swap(mailboxes[index]);
+    }
+    changedTiles.fetch_or(1u << index, std::memory_order_release);
+    if (pyramid) {
+        // Never shown; the tile moves straight to the newer frame
+        replaced.fetch_add(1, std::memory_order_relaxed);
+        if (frameReleased) frameReleased(*pyramid);
+    }
+}
+
+bool ImageViewer::dropPending(int index) {
+    if (index < 0 || index >= kTileCount) return false;
+    std::shared_ptr<FramePyramid> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mailboxMutex);
+        dropped.swap(mailboxes[index]);
+    }
+    if (!dropped) return false;
+    if (frameReleased) frameReleased(*dropped);
+    return true;
+}
+
+void ImageViewer::composite() {
+    uint32_t changed = changedTiles.exchange(0, std::memory_order_acquire);
+    if (changed == 0) return;  // nothing new since the last refresh
+
+    std::array<std::shared_ptr<FramePyramid>, kTileCount> next;
+    {
+        std::lock_guard<std::mutex> lock(mailboxMutex);
+        for (int i = 0; i < kTileCount; ++i) {
+            if (changed & (1u << i)) next[i].swap(mailboxes[i]);
+        }
+    }
+    // Every changed tile is updated in this tick, so Qt repaints them in one pass
+    TraceSpan span("composite");
+    AllocCounter::FrameScope allocScope;
+    for (int i = 0; i < kTileCount; ++i) {
+        if (!next[i]) continue;
+        tileFrames[i] = next[i];
+        displayTile(i);
+        if (frameReleased) frameReleased(*next[i]);
+    }
+}
+
+void ImageViewer::resizeEvent(QResizeEvent* event) {
+    QWidget::resizeEvent(event);
+    // Re-pick levels from the cached pyramids; no frame is decoded again
+    for (int i = 0; i < kTileCount; ++i) {
+        displayTile(i);
+    }
+}
+
+bool ImageViewer::eventFilter(QObject* watched, QEvent* event) {
+    int index = -1;
+    for (int i = 0; i < kCameraTiles; ++i) {
+        if (watched == imageLabels[i]) index = i;
+    }
+    if (index < 0) return QWidget::eventFilter(watched, event);
+
+    QLabel* label = imageLabels[index];
+    const QRectF& view = tileViews[index];
+    switch (event->type()) {
+        case QEvent::Wheel: {
+            auto* wheel = static_cast<QWheelEvent*>(event);
+            double factor = std::pow(1.25, wheel->angleDelta().y() / 120.0);
+            double zoom = std::min(kMaxZoom, std::max(1.0, 1.0 / view.width() * factor));
+            // The point under the cursor stays where it is
+            double fx = wheel->position().x() / std::max(1, label->width());
+            double fy = wheel->position().y() / std::max(1, label->height());
+            double px = view.x() + fx * view.width();
+            double py = view.y() + fy * view.height();
+            setView(index, QRectF(px - fx / zoom, py - fy / zoom, 1.0 / zoom, 1.0 / zoom));
+            return true;
+        }
+        case QEvent::MouseButtonPress: {
+            auto* mouse = static_cast<QMouseEvent*>(event);
+            if (mouse->button() != Qt::LeftButton) break;
+            dragTile = index;
+            dragLast = mouse->pos();
+            return true;
+        }
+        case QEvent::MouseMove: {
+            if (dragTile != index) break;
+            auto* mouse = static_cast<QMouseEvent*>(event);
+            double dx = (mouse->pos().x() - dragLast.x()) * view.width() / std::max(1, label->width());
+            double dy = (mouse->pos().y() - dragLast.y()) * view.height() / std::max(1, label->height());
+            dragLast = mouse->pos();
+            setView(index, view.translated(-dx, -dy));
+            return true;
+        }
+        case QEvent::MouseButtonRelease:
+            dragTile = -1;
+            break;
+        case QEvent::MouseButtonDblClick:
+            setView(index, QRectF(0.0, 0.0, 1.0, 1.0));
+            return true;
+        default:
+            break;
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void ImageViewer::setView(int index, QRectF view) {
+    view.moveLeft(std::min(1.0 - view.width(), std::max(0.0, view.x())));
+    view.moveTop(std::min(1.0 - view.height(), std::max(0.0, view.y())));
+    if (view == tileViews[index]) return;
+    tileViews[index] = view;
+    displayTile(index);
+    if (viewChanged) viewChanged(index, view);
+}
+
+void ImageViewer::displayTile(int index) {
+    QSize target = imageLabels[index]->size();
+    tileSizes[index] = (static_cast<uint32_t>(target.width()) << 16) |
+                       (static_cast<uint32_t>(target.height()) & 0xFFFF);
+
+    auto& pyramid = tileFrames[index];
+    if (!pyramid) return;
+    TraceSpan span("paint", pyramid->traceId);
+
+    const QRectF& view = tileViews[index];
+    cv::Rect full(0, 0, pyramid->sensorSize.width, pyramid->sensorSize.height);
+    if (full.empty() || (view.width() >= 1.0 && pyramid->region == full)) {
+        convertAndDisplay(index, pyramid->fit(target.width(), target.height()));
         return;
     }
 
-    QImage qImage(rgbImage.data, rgbImage.cols, rgbImage.rows, rgbImage.step, QImage::Format_RGB888);
-    QPixmap pixmap = QPixmap::fromImage(qImage);
-    imageLabels[index]->setPixmap(pixmap.scaled(imageLabels[index]->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
-} 
\ No newline at end of file
+    // Zoomed, or showing an ROI frame: cut what the view covers out of the
+    // smallest level that still has the tile's resolution there
+    cv::Rect visible(static_cast<int>(view.x() * full.width), static_cast<int>(view.y() * full.height),
+        static_cast<int>(std::ceil(view.width() * full.width)), static_cast<int>(std::ceil(view.height() * full.height)));
+    cv::Rect shown = visible & pyramid->region;
+    if (shown.empty()) return;  // the region for this view has not arrived yet
+    double scale = static_cast<double>(pyramid->width()) / pyramid->region.width;
+    cv::Rect crop(static_cast<int>((shown.x - pyramid->region.x) * scale), static_cast<int>((shown.y - pyramid->region.y) * scale),
+        std::max(1, static_cast<int>(shown.width * scale)), std::max(1, static_cast<int>(shown.height * scale)));
+    crop &= cv::Rect(0, 0, pyramid->width(), pyramid->height());
+    if (crop.empty()) return;
+
+    int level = pyramid->levelFor(target.width() * pyramid->width() / crop.width,
+                                  target.height() * pyramid->height() / crop.height);
+    const cv::Mat& image = pyramid->level(level);
+    double down = static_cast<double>(image.cols) / pyramid->width();
+    cv::Rect scaled(static_cast<int>(crop.x * down), static_cast<int>(crop.y * down),
+        std::max(1, static_cast<int>(crop.width * down)), std::max(1, static_cast<int>(crop.height * down)));
+    scaled &= cv::Rect(0, 0, image.cols, image.rows);
+    if (scaled.empty()) return;
+    convertAndDisplay(index, image(scaled));
+}
+
+void ImageViewer::convertAndDisplay(int index, const cv::Mat& image) {
+    if (image.empty() || (image.channels() != 1 && image.channels() != 3)) return;
+
+    // Fit the frame to the tile, then convert straight into the tile's image
+    TileLabel* label = imageLabels[index];
+    QSize fitted = QSize(image.cols, image.rows).scaled(label->size(), Qt::KeepAspectRatio);
+    if (fitted.isEmpty()) return;
+    QImage& frame = label->frame(fitted);
+    cv::Mat target(frame.height(), frame.width(), CV_8UC4, frame.bits(), frame.bytesPerLine());
+
+    const cv::Mat* source = &image;
+    if (fitted.width() != image.cols || fitted.height() != image.rows) {
+        int interpolation = fitted.width() < image.cols ? cv::INTER_AREA : cv::INTER_LINEAR;
+        cv::resize(image, scaledImages[index], cv::Size(fitted.width(), fitted.height()), 0, 0, interpolation);
+        source = &scaledImages[index];
+    }
+    // BGRA bytes are RGB32's little-endian layout, with the alpha set opaque
+    cv::cvtColor(*source, target, source->channels() == 1 ? cv::COLOR_GRAY2BGRA : cv::COLOR_BGR2BGRA);
+    label->update();
+}
@@ -3,22 +3,100 @@
 #include <QWidget>
 #include <QLabel>
 #include <QGridLayout>
+#include <QImage>
+#include <QRectF>
+#include <QResizeEvent>
+#include <QTimer>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <opencv2/opencv.hpp>
+#include "frame_pyramid.hpp"
+#include "sensor_channels.hpp"
+
+// A tile paints its frame from a QImage the viewer converts into in place, so
+// showing a frame copies no pixmap
+class TileLabel : public QLabel {
+public:
+    using QLabel::QLabel;
+
+    // The image the next frame is written into; reallocated only when size changes
+    QImage& frame(const QSize& size);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    QImage image;
+};
 
 class ImageViewer : public QWidget {
     Q_OBJECT
 
 public:
+    static constexpr int kCameraTiles = 4;
+    static constexpr int kLidarTile = sensor_tile::kLidar;
+    static constexpr int kTileCount = sensor_tile::kCount;
+    static_assert(kLidarTile == kCameraTiles, "camera tiles fill the grid before the LiDAR view");
+
+    // Called once for every posted frame when it leaves its mailbox, shown or replaced
+    using FrameReleased = std::function<void(const FramePyramid& pyramid)>;
+    // Called as the operator zooms or pans a camera tile; view is the part of the
+    // sensor image shown, normalized to 0..1, and (0, 0, 1, 1) once zoomed out
+    using ViewChanged = std::function<void(int index, const QRectF& view)>;
+    static constexpr double kMaxZoom = 16.0;
+
     explicit ImageViewer(QWidget* parent = nullptr);
     ~ImageViewer();
 
+    void setFrameReleased(FrameReleased handler) { frameReleased = std::move(handler); }
+    void setViewChanged(ViewChanged handler) { viewChanged = std::move(handler); }
+    // Thread-safe: the tile shows the newest posted frame at the next refresh tick
+    void post(int index, std::shared_ptr<FramePyramid> pyramid);
+    // Thread-safe: discards the frame waiting in the tile's mailbox; false if there was none
+    bool dropPending(int index);
+    uint64_t replacedFrames() const { return replaced.load(std::memory_order_relaxed); }
+
+    // Thread-safe: lets the decode stage pre-build the level a tile will use.
+    QSize tileSize(int index) const;
+    // Outlines a tile whose source keeps repeating the same frame
+    void setStalled(int index, bool stalled);
+
 public slots:
     void updateImage(int index, const cv::Mat& image);
 
+protected:
+    void resizeEvent(QResizeEvent* event) override;
+    // Wheel zooms a camera tile about the cursor, dragging pans it, double-click resets it
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
+private slots:
+    void composite();
+
 private:
     void setupUI();
     void convertAndDisplay(int index, const cv::Mat& image);
+    void displayTile(int index);
+    void setView(int index, QRectF view);
 
     QGridLayout* layout;
-    std::array<QLabel*, 4> imageLabels;
-}; 
\ No newline at end of file
+    std::array<TileLabel*, kTileCount> imageLabels;
+    std::array<std::shared_ptr<FramePyramid>, kTileCount> tileFrames;
+    std::array<std::atomic<uint32_t>, kTileCount> tileSizes{};
+    std::array<bool, kTileCount> tileStalled{};
+    std::array<cv::Mat, kTileCount> scaledImages;  // reused resize targets
+    std::array<QRectF, kTileCount> tileViews;
+    int dragTile = -1;
+    QPoint dragLast;
+    ViewChanged viewChanged;
+
+    // Newest undisplayed frame per tile; older ones are released as they are replaced
+    std::mutex mailboxMutex;
+    std::array<std::shared_ptr<FramePyramid>, kTileCount> mailboxes;
+    std::atomic<uint32_t> changedTiles{0};
+    std::atomic<uint64_t> replaced{0};
+    FrameReleased frameReleased;
+    QTimer* refreshTimer;
+};
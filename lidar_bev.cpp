@@ -0,0 +1,215 @@
+#include "lidar_bev.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr float kPi = 3.14159265f;
+
+    // Nominal mounting yaw per LiDAR channel; real extrinsics come through setMount()
+    constexpr std::pair<eSensorChannel, float> kDefaultYaw[] = {
+        {eSensorChannel::LIDAR_FRONT_CENTER, 0.0f},
+        {eSensorChannel::LIDAR_FRONT_LEFT, kPi / 4},
+        {eSensorChannel::LIDAR_FRONT_RIGHT, -kPi / 4},
+        {eSensorChannel::LIDAR_REAR_CENTER, kPi},
+        {eSensorChannel::LIDAR_REAR_LEFT, 3 * kPi / 4},
+        {eSensorChannel::LIDAR_REAR_RIGHT, -3 * kPi / 4},
+        {eSensorChannel::LIDAR_SIDE_LEFT, kPi / 2},
+        {eSensorChannel::LIDAR_SIDE_RIGHT, -kPi / 2},
+        {eSensorChannel::LIDAR_ROOF_CENTER, 0.0f},
+        {eSensorChannel::LIDAR_ROOF_FRONT, 0.0f},
+        {eSensorChannel::LIDAR_ROOF_LEFT, kPi / 2},
+        {eSensorChannel::LIDAR_ROOF_RIGHT, -kPi / 2},
+        {eSensorChannel::LIDAR_ROOF_REAR, kPi},
+    };
+
+    // cv::parallel_for_ takes lambdas as a std::function, which heap-allocates
+    // captures larger than two pointers; a ParallelLoopBody holding a reference
+    // to the lambda keeps a sweep off the heap
+    template <typename Body>
+    class LoopBody : public cv::ParallelLoopBody {
+    public:
+        explicit LoopBody(const Body& body) : body(body) {}
+        void operator()(const cv::Range& range) const override { body(range); }
+
+    private:
+        const Body& body;
+    };
+
+    template <typename Body>
+    void parallelFor(const cv::Range& range, const Body& body, double nstripes = -1.0) {
+        cv::parallel_for_(range, LoopBody<Body>(body), nstripes);
+    }
+}
+
+LidarBevRasterizer::LidarBevRasterizer() {
+    for (const auto& entry : kDefaultYaw) {
+        mounts[static_cast<size_t>(entry.first)].yaw = entry.second;
+    }
+}
+
+void LidarBevRasterizer::prepare() {
+    composite.create(kGridSize, kGridSize, CV_16UC1);
+
+    // Colour from the height byte, brightness from the intensity byte
+    cv::Mat ramp(1, 256, CV_8UC1);
+    for (int i = 0; i < 256; ++i) ramp.at<uint8_t>(0, i) = static_cast<uint8_t>(i);
+    cv::Mat colors;
+    cv::applyColorMap(ramp, colors, cv::COLORMAP_JET);
+
+    palette.resize(1 << 16);
+    for (int height = 1; height < 256; ++height) {
+        cv::Vec3b color = colors.at<cv::Vec3b>(0, height);
+        for (int intensity = 0; intensity < 256; ++intensity) {
+            float scale = 0.35f + 0.65f * intensity / 255.0f;
+            palette[(height << 8) | intensity] = cv::Vec3b(
+                static_cast<uint8_t>(color[0] * scale),
+                static_cast<uint8_t>(color[1] * scale),
+                static_cast<uint8_t>(color[2] * scale));
+        }
+    }
+}
+
+void LidarBevRasterizer::setMount(uint8_t channel, const LidarMount& mount) {
+    if (channel >= kChannels) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    mounts[channel] = mount;
+}
+
+void LidarBevRasterizer::addSweep(uint8_t channel, const stLidarPoint* points, size_t count, cv::Mat& bgr) {
+    if (channel >= kChannels) return;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    cv::Mat& grid = channelGrids[channel];
+    if (grid.empty()) {
+        grid.create(kGridSize, kGridSize, CV_16UC1);
+    }
+    bin(points, count, mounts[channel], grid);
+    lastSweep[channel] = std::chrono::steady_clock::now();
+
+    // Channels that stopped sending fall out of the merged view
+    auto now = lastSweep[channel];
+    composite.setTo(0);
+    for (size_t i = 0; i < kChannels; ++i) {
+        if (!channelGrids[i].empty() && now - lastSweep[i] < kStaleAfter) {
+            cv::max(composite, channelGrids[i], composite);
+        }
+    }
+    render(bgr);
+}
+
+void LidarBevRasterizer::bin(const stLidarPoint* points, size_t count, const LidarMount& mount, cv::Mat& grid) {
+    if (cellIndex.size() < count) {
+        cellIndex.resize(count);
+        cellValue.resize(count);
+        binnedIndex.resize(count);
+        binnedValue.resize(count);
+    }
+    int32_t* indices = cellIndex.data();
+    uint16_t* values = cellValue.data();
+
+    // The grid is cut into one stripe of rows per thread; the points are
+    // handled in chunks, and each chunk counts its points per stripe
+    const int stripes = std::max(1, cv::getNumThreads());
+    const int32_t cellsPerStripe = (kGridSize * kGridSize + stripes - 1) / stripes;
+    const int chunks = static_cast<int>(std::max<size_t>(1, std::min<size_t>(stripes, count / 16384)));
+    bucketOffsets.assign(static_cast<size_t>(chunks) * stripes, 0);
+    stripeStarts.resize(stripes + 1);
+    auto chunkBegin = [count, chunks](int chunk) { return count * chunk / chunks; };
+
+    // Pass 1: transform to the vehicle frame and quantize, independent per point
+    const float c = std::cos(mount.yaw);
+    const float s = std::sin(mount.yaw);
+    const float invCell = 1.0f / kCellSize;
+    const float heightScale = 254.0f / (kMaxHeight - kMinHeight);
+    parallelFor(cv::Range(0, chunks), [&](const cv::Range& range) {
+        for (int chunk = range.start; chunk < range.end; ++chunk) {
+            uint32_t* counts = bucketOffsets.data() + static_cast<size_t>(chunk) * stripes;
+            for (size_t i = chunkBegin(chunk), end = chunkBegin(chunk + 1); i < end; ++i) {
+                const stLidarPoint& p = points[i];
+                // NaN gets through the clamps below, and casting it to int is undefined
+                if (!std::isfinite(p.mX) || !std::isfinite(p.mY) || !std::isfinite(p.mZ) ||
+                    !std::isfinite(p.mIntensity)) {
+                    indices[i] = -1;
+                    continue;
+                }
+                float vx = c * p.mX - s * p.mY + mount.x;
+                float vy = s * p.mX + c * p.mY + mount.y;
+                float vz = p.mZ + mount.z;
+
+                // Forward is up, vehicle left is image left
+                float row = (kRange - vx) * invCell;
+                float col = (kRange - vy) * invCell;
+                if (!(row >= 0.0f && row < kGridSize && col >= 0.0f && col < kGridSize)) {
+                    indices[i] = -1;
+                    continue;
+                }
+
+                float h = std::min(std::max((vz - kMinHeight) * heightScale, 0.0f), 254.0f);
+                float intensity = std::min(std::max(p.mIntensity, 0.0f), 255.0f);
+                int32_t index = static_cast<int32_t>(row) * kGridSize + static_cast<int32_t>(col);
+                indices[i] = index;
+                values[i] = static_cast<uint16_t>(((static_cast<int>(h) + 1) << 8) | static_cast<int>(intensity));
+                ++counts[index / cellsPerStripe];
+            }
+        }
+    }, std::max(1.0, count / 65536.0));
+
+    // Each chunk's share of a stripe goes after the earlier chunks', stripe by stripe
+    uint32_t total = 0;
+    for (int stripe = 0; stripe < stripes; ++stripe) {
+        stripeStarts[stripe] = total;
+        for (int chunk = 0; chunk < chunks; ++chunk) {
+            uint32_t& offset = bucketOffsets[static_cast<size_t>(chunk) * stripes + stripe];
+            uint32_t points = offset;
+            offset = total;
+            total += points;
+        }
+    }
+    stripeStarts[stripes] = total;
+
+    // Pass 2: bucket the points inside the grid by stripe
+    parallelFor(cv::Range(0, chunks), [&](const cv::Range& range) {
+        for (int chunk = range.start; chunk < range.end; ++chunk) {
+            uint32_t* offsets = bucketOffsets.data() + static_cast<size_t>(chunk) * stripes;
+            for (size_t i = chunkBegin(chunk), end = chunkBegin(chunk + 1); i < end; ++i) {
+                if (indices[i] < 0) continue;
+                uint32_t at = offsets[indices[i] / cellsPerStripe]++;
+                binnedIndex[at] = indices[i];
+                binnedValue[at] = values[i];
+            }
+        }
+    });
+
+    // Pass 3: each stripe keeps the highest return per cell from its own
+    // bucket, so no two threads ever write the same cell
+    grid.setTo(0);
+    uint16_t* cells = grid.ptr<uint16_t>();
+    parallelFor(cv::Range(0, stripes), [&](const cv::Range& range) {
+        for (int stripe = range.start; stripe < range.end; ++stripe) {
+            for (uint32_t k = stripeStarts[stripe]; k < stripeStarts[stripe + 1]; ++k) {
+                int32_t index = binnedIndex[k];
+                if (binnedValue[k] > cells[index]) {
+                    cells[index] = binnedValue[k];
+                }
+            }
+        }
+    });
+}
+
+void LidarBevRasterizer::render(cv::Mat& bgr) {
+    bgr.create(kGridSize, kGridSize, CV_8UC3);
+    parallelFor(cv::Range(0, kGridSize), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y) {
+            const uint16_t* in = composite.ptr<uint16_t>(y);
+            cv::Vec3b* out = bgr.ptr<cv::Vec3b>(y);
+            for (int x = 0; x < kGridSize; ++x) {
+                out[x] = palette[in[x]];
+            }
+        }
+    });
+
+    // Vehicle footprint at the origin
+    int center = kGridSize / 2;
+    cv::rectangle(bgr, cv::Point(center - 9, center - 24), cv::Point(center + 9, center + 24),
+        cv::Scalar(255, 255, 255), 1);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "messages.hpp"
+
+// Mounting pose of a LiDAR in the vehicle frame (x forward, y left, z up).
+struct LidarMount {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float yaw = 0.0f;  // radians
+};
+
+// Top-down height/intensity raster merging the latest sweep of every LiDAR channel.
+// Grids and scratch buffers are reused, so a sweep only refills them.
+class LidarBevRasterizer {
+public:
+    static constexpr float kRange = 51.2f;  // metres each side of the vehicle
+    static constexpr float kCellSize = 0.1f;
+    static constexpr int kGridSize = 1024;
+    static constexpr float kMinHeight = -3.0f;
+    static constexpr float kMaxHeight = 5.0f;
+    static constexpr std::chrono::milliseconds kStaleAfter{500};
+
+    LidarBevRasterizer();
+
+    // Builds the composite grid and colour palette; call once before the first sweep.
+    // Kept out of the constructor so it can run off the startup path.
+    void prepare();
+
+    void setMount(uint8_t channel, const LidarMount& mount);
+
+    // Bins one sweep, then renders every live channel into bgr (kGridSize square).
+    void addSweep(uint8_t channel, const stLidarPoint* points, size_t count, cv::Mat& bgr);
+
+private:
+    static constexpr size_t kChannels = static_cast<size_t>(eSensorChannel::CHANNEL_MAX);
+
+    void bin(const stLidarPoint* points, size_t count, const LidarMount& mount, cv::Mat& grid);
+    void render(cv::Mat& bgr);
+
+    std::mutex mutex;
+    std::array<LidarMount, kChannels> mounts;
+    // Per cell: (height byte << 8) | intensity byte of the highest return, 0 when empty
+    std::array<cv::Mat, kChannels> channelGrids;
+    std::array<std::chrono::steady_clock::time_point, kChannels> lastSweep;
+    cv::Mat composite;
+    std::vector<int32_t> cellIndex;
+    std::vector<uint16_t> cellValue;
+    // The points inside the grid, grouped by the stripe of rows their cell is in
+    std::vector<int32_t> binnedIndex;
+    std::vector<uint16_t> binnedValue;
+    std::vector<uint32_t> bucketOffsets;  // per chunk and stripe
+    std::vector<uint32_t> stripeStarts;
+    std::vector<cv::Vec3b> palette;
+};
@@ -0,0 +1,41 @@
+#include "link_health.hpp"
+#include <cmath>
+
+size_t RttHistogram::bucketFor(uint64_t rttNs) {
+    if (rttNs < 1000) return 0;
+    size_t bucket = static_cast<size_t>(4.0 * std::log2(rttNs / 1000.0)) + 1;
+    return bucket < kBuckets ? bucket : kBuckets - 1;
+}
+
+uint64_t RttHistogram::upperBoundNs(size_t bucket) {
+    return static_cast<uint64_t>(1000.0 * std::exp2(bucket / 4.0));
+}
+
+void RttHistogram::add(uint64_t rttNs) {
+    buckets[bucketFor(rttNs)].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t RttHistogram::count() const {
+    uint64_t total = 0;
+    for (const auto& bucket : buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t RttHistogram::percentileNs(double fraction) const {
+    std::array<uint64_t, kBuckets> snapshot;
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        snapshot[i] = buckets[i].load(std::memory_order_relaxed);
+        total += snapshot[i];
+    }
+    if (total == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += snapshot[i];
+        if (seen >= rank && snapshot[i] > 0) return upperBoundNs(i);
+    }
+    return upperBoundNs(kBuckets - 1);
+}
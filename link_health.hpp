@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Heartbeat cadence on the control port. Once a backend has answered a beat,
+// a link that leaves misses beats in a row unanswered is declared dead, so
+// detection takes interval * misses.
+struct HeartbeatConfig {
+    std::chrono::milliseconds interval{100};
+    uint32_t misses = 3;
+};
+
+// Round-trip times in quarter-octave buckets from 1 us; lock-free so the GUI
+// can read percentiles while the session strand records.
+class RttHistogram {
+public:
+    static constexpr size_t kBuckets = 96;  // the last bucket holds everything above ~14 s
+
+    void add(uint64_t rttNs);
+    uint64_t count() const;
+    // Upper bound of the bucket holding the given fraction of samples, in ns
+    uint64_t percentileNs(double fraction) const;
+
+private:
+    static size_t bucketFor(uint64_t rttNs);
+    static uint64_t upperBoundNs(size_t bucket);
+
+    std::array<std::atomic<uint64_t>, kBuckets> buckets{};
+};
+
+// Heartbeat view of one backend's link, written by its session strand.
+struct LinkHealth {
+    std::atomic<bool> alive{false};       // beats answered since the control port came up
+    std::atomic<uint64_t> lastRttNs{0};
+    std::atomic<uint64_t> beatsSent{0};
+    std::atomic<uint64_t> beatsAnswered{0};
+    std::atomic<uint64_t> linksLost{0};   // declared dead and re-linked
+    RttHistogram rtt;
+};
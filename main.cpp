@@ -1,11 +1,15 @@
 #include "control_app.hpp"
+#include "app_style.hpp"
 #include <QApplication>
+#include <chrono>
 
 int main(int argc, char *argv[]) {
+    auto launched = std::chrono::steady_clock::now();
     QApplication app(argc, argv);
     app.setStyle("Fusion");
+    app.setStyleSheet(app_style::sheet());
     
-    ControlApp window;
+    ControlApp window(launched);
     window.show();
     
     return app.exec();
@@ -0,0 +1,164 @@
+#include "memory_governor.hpp"
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+    // A paused reader gives up on the frame after this long, so a budget that
+    // never drains cannot hold an io thread forever
+    constexpr auto kMaxPause = std::chrono::milliseconds(500);
+}
+
+MemoryGovernor& MemoryGovernor::instance() {
+    static MemoryGovernor governor;
+    return governor;
+}
+
+MemoryGovernor::MemoryGovernor() {
+    policies.fill(BudgetPolicy::DropOldest);
+}
+
+int MemoryGovernor::registerBudget(const std::string& name, size_t limitBytes, Reclaimer reclaimer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budgets.push_back(Budget{name, limitBytes, 0, std::move(reclaimer)});
+    return static_cast<int>(budgets.size()) - 1;
+}
+
+void MemoryGovernor::setChannelPolicy(uint8_t channel, BudgetPolicy policy) {
+    if (channel >= kChannels) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    policies[channel] = policy;
+}
+
+BudgetPolicy MemoryGovernor::channelPolicy(uint8_t channel) const {
+    if (channel >= kChannels) return BudgetPolicy::DropOldest;
+    std::lock_guard<std::mutex> lock(mutex);
+    return policies[channel];
+}
+
+void MemoryGovernor::setRateLimiter(RateLimiter limiter) {
+    std::lock_guard<std::mutex> lock(mutex);
+    rateLimiter = std::move(limiter);
+}
+
+bool MemoryGovernor::acquire(int budget, uint8_t channel, size_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex);
+    BudgetPolicy policy = channel < kChannels ? policies[channel] : BudgetPolicy::DropOldest;
+    Budget& b = budgets[budget];
+
+    while (b.used + bytes > b.limit) {
+        if (bytes > b.limit) {
+            droppedFrames.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        if (policy == BudgetPolicy::PauseReads && !stopping) {
+            // The reader stops pulling from the socket, so TCP backpressure reaches the backend
+            if (released.wait_for(lock, kMaxPause, [&]() { return stopping || b.used + bytes <= b.limit; }) &&
+                !stopping) {
+                continue;
+            }
+            droppedFrames.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        if (policy == BudgetPolicy::DropOldest && b.reclaimer) {
+            // The reclaimer releases through release(), which takes the lock
+            Reclaimer reclaimer = b.reclaimer;
+            lock.unlock();
+            bool freed = reclaimer(channel);
+            lock.lock();
+            if (freed) continue;
+        }
+
+        if (policy == BudgetPolicy::LowerRate && rateLimiter && channel < kChannels &&
+            !(throttledChannels & getSensorChannelBitmask(static_cast<eSensorChannel>(channel)))) {
+            throttledChannels |= getSensorChannelBitmask(static_cast<eSensorChannel>(channel));
+            RateLimiter limiter = rateLimiter;
+            lock.unlock();
+            limiter(channel, true);
+            lock.lock();
+        }
+
+        droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    b.used += bytes;
+    return true;
+}
+
+void MemoryGovernor::release(int budget, size_t bytes) {
+    uint32_t restore = 0;
+    RateLimiter limiter;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Budget& b = budgets[budget];
+        b.used = bytes > b.used ? 0 : b.used - bytes;
+
+        // Hysteresis: throttled channels come back once every budget is below half
+        if (throttledChannels) {
+            bool relaxed = true;
+            for (const auto& each : budgets) {
+                if (each.used > each.limit / 2) {
+                    relaxed = false;
+                    break;
+                }
+            }
+            if (relaxed) {
+                restore = throttledChannels;
+                throttledChannels = 0;
+                limiter = rateLimiter;
+            }
+        }
+    }
+    released.notify_all();
+
+    if (limiter) {
+        for (uint8_t channel = 0; channel < kChannels; ++channel) {
+            if (restore & getSensorChannelBitmask(static_cast<eSensorChannel>(channel))) {
+                limiter(channel, false);
+            }
+        }
+    }
+}
+
+void MemoryGovernor::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    released.notify_all();
+}
+
+size_t MemoryGovernor::used(int budget) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return budgets[budget].used;
+}
+
+size_t MemoryGovernor::limit(int budget) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return budgets[budget].limit;
+}
+
+size_t MemoryGovernor::totalUsed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    for (const auto& b : budgets) {
+        total += b.used;
+    }
+    return total;
+}
+
+std::string MemoryGovernor::summary() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < budgets.size(); ++i) {
+        if (i) out << " | ";
+        out << budgets[i].name << " " << budgets[i].used / 1048576.0
+            << "/" << budgets[i].limit / 1048576.0 << " MB";
+    }
+    out << " | dropped " << droppedFrames.load(std::memory_order_relaxed);
+    return out.str();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include "messages.hpp"
+
+// What to do with a channel when the budget it allocates from runs out.
+enum class BudgetPolicy : uint8_t {
+    DropOldest = 0,  // reclaim the channel's oldest queued frame, else drop the new one
+    LowerRate = 1,   // drop the frame and ask the backend to stop sending the channel for a while
+    PauseReads = 2,  // block the caller (the socket reader) until memory is released, then drop
+};
+
+// Process-wide accounting of frame pools, reassembly buffers and history rings.
+// Each owner registers a budget and routes its allocations through acquire().
+class MemoryGovernor {
+public:
+    using Reclaimer = std::function<bool(uint8_t channel)>;
+    using RateLimiter = std::function<void(uint8_t channel, bool throttle)>;
+
+    static MemoryGovernor& instance();
+
+    int registerBudget(const std::string& name, size_t limitBytes, Reclaimer reclaimer = nullptr);
+    void setChannelPolicy(uint8_t channel, BudgetPolicy policy);
+    BudgetPolicy channelPolicy(uint8_t channel) const;
+    void setRateLimiter(RateLimiter limiter);
+
+    bool acquire(int budget, uint8_t channel, size_t bytes);
+    void release(int budget, size_t bytes);
+    // Wakes readers paused by PauseReads and stops pausing them; for shutdown
+    void shutdown();
+
+    size_t used(int budget) const;
+    size_t limit(int budget) const;
+    size_t totalUsed() const;
+    uint64_t dropped() const { return droppedFrames.load(std::memory_order_relaxed); }
+    std::string summary() const;
+
+private:
+    MemoryGovernor();
+
+    struct Budget {
+        std::string name;
+        size_t limit;
+        size_t used = 0;
+        Reclaimer reclaimer;
+    };
+
+    static constexpr size_t kChannels = static_cast<size_t>(eSensorChannel::CHANNEL_MAX);
+
+    mutable std::mutex mutex;
+    std::condition_variable released;
+    std::deque<Budget> budgets;
+    std::array<BudgetPolicy, kChannels> policies;
+    uint32_t throttledChannels = 0;
+    bool stopping = false;
+    RateLimiter rateLimiter;
+    std::atomic<uint64_t> droppedFrames{0};
+};
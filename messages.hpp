@@ -81,6 +81,22 @@ enum class eSensorChannel:uint8_t
     CHANNEL_MAX = 32
 };
 
+// stDataSensorReqMsg::mImgFormat; mImgDepth carries bits per sample (8, 12 or 16)
+enum class ePixelFormat : uint8_t
+{
+    UYVY = 0,
+    YUYV = 1,
+    NV12 = 2,
+    RGB888 = 3,
+    BGR888 = 4,
+    GRAY = 5,
+    BAYER_RGGB = 6,
+    BAYER_GRBG = 7,
+    BAYER_GBRG = 8,
+    BAYER_BGGR = 9,
+    PIXEL_FORMAT_MAX = 10
+};
+
 inline uint32_t getSensorChannelBitmask(eSensorChannel channel) {
     return 0x01 << static_cast<uint32_t>(channel);
 }
@@ -182,6 +198,31 @@ struct stDataRecordConfigMsg
     }
 };
 
+// Part of a camera channel to stream at full resolution instead of the whole
+// frame, in sensor pixels; origin and size are even so every pixel format cuts
+// on whole sample groups
+struct stChannelRoi
+{
+    uint8_t mChannel;
+    uint16_t mX;
+    uint16_t mY;
+    uint16_t mWidth;
+    uint16_t mHeight;
+
+    template <typename Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        ar & mChannel;
+        ar & mX;
+        ar & mY;
+        ar & mWidth;
+        ar & mHeight;
+    }
+};
+constexpr size_t kChannelRoiWireBytes = 9;  // mChannel, then mX, mY, mWidth, mHeight as uint16
+
+// On the wire the body ends after mNetworkID unless mRois is non-empty; then a
+// uint8 count and kChannelRoiWireBytes per entry follow and bodyLength covers them
 struct stDataRequestMsg
 {
     Header header;
@@ -190,6 +231,7 @@ struct stDataRequestMsg
     uint32_t mSensorChannel;
     uint8_t mServiceID;
     uint8_t mNetworkID;
+    std::vector<stChannelRoi> mRois;
     
     template <typename Archive>
     void serialize(Archive& ar, const unsigned int version)
@@ -200,8 +242,12 @@ struct stDataRequestMsg
         ar & mSensorChannel;
         ar & mServiceID;
         ar & mNetworkID;
+        ar & mRois;
     }
 };
+// DATA_SEND_REQUEST frames shorter than this are zero-padded up to it, past
+// what bodyLength covers; receivers skip the padding before the next header
+constexpr size_t kDataRequestFrameBytes = 48;
 
 struct stDataSensorReqMsg
 {
@@ -216,6 +262,49 @@ struct stDataSensorReqMsg
     uint16_t mImgHeight;
     uint8_t mImgDepth;
     uint8_t mImgFormat;
-    uint32_t mNumPoints;
+    uint32_t mNumPoints;  // camera frames: kRoiFrame | x << 16 | y when cut to a region of interest
     uint32_t mPayloadSize;
-};
\ No newline at end of file
+};
+
+// Camera frames cut to a stChannelRoi say so in mNumPoints, with the region's
+// origin; mImgWidth/mImgHeight are then the region's size, not the sensor's
+constexpr uint32_t kRoiFrame = 1u << 31;
+inline uint32_t encodeRoiOrigin(uint16_t x, uint16_t y) { return kRoiFrame | (uint32_t(x) << 16) | y; }
+inline bool isRoiFrame(const stDataSensorReqMsg& msg) { return msg.mSensorType == 1 && (msg.mNumPoints & kRoiFrame); }
+inline uint16_t roiOriginX(const stDataSensorReqMsg& msg) { return (msg.mNumPoints >> 16) & 0x7FFF; }
+inline uint16_t roiOriginY(const stDataSensorReqMsg& msg) { return msg.mNumPoints & 0xFFFF; }
+// One LiDAR return in the sensor frame (metres); a DATA_SENSOR message with
+// mSensorType 2 carries mNumPoints of these as its payload
+struct stLidarPoint
+{
+    float mX;
+    float mY;
+    float mZ;
+    float mIntensity;
+};
+
+// One detection from a RECONGITION_RESULT stream; a DATA_SENSOR message with
+// mSensorType 3 carries mNumPoints of these, in the camera's pixel coordinates,
+// stamped with the mTimestamp of the frame they were computed on
+struct [[gnu::packed]] stRecognitionObject
+{
+    float mX;
+    float mY;
+    float mWidth;
+    float mHeight;
+    float mScore;
+    uint16_t mClassId;
+    uint16_t mTrackId;
+};
+
+// Payload of a RESOURCE_INFO stream message (mSensorType 4). DEBUG_MESSAGE
+// messages (mSensorType 5) carry a severity byte (0 info, 1 warning, 2 error)
+// followed by mPayloadSize - 1 bytes of UTF-8 text.
+struct [[gnu::packed]] stResourceInfo
+{
+    float mCpuLoad;        // percent
+    float mMemoryUsedMB;
+    float mDiskFreeGB;
+    float mTemperature;    // degrees Celsius
+    uint32_t mDroppedFrames;
+};
@@ -0,0 +1,464 @@
+#include "pcap_ingest.hpp"
+#include "tcp_client.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr uint32_t kPcapMicros = 0xA1B2C3D4;
+    constexpr uint32_t kPcapNanos = 0xA1B23C4D;
+    constexpr uint32_t kPcapngSection = 0x0A0D0D0A;
+    constexpr uint32_t kPcapngByteOrder = 0x1A2B3C4D;
+    constexpr uint32_t kPcapngInterface = 1;
+    constexpr uint32_t kPcapngSimplePacket = 3;
+    constexpr uint32_t kPcapngEnhancedPacket = 6;
+
+    // Link-layer types, as numbered by tcpdump
+    constexpr uint32_t kLinkNull = 0;
+    constexpr uint32_t kLinkEthernet = 1;
+    constexpr uint32_t kLinkRaw = 101;
+    constexpr uint32_t kLinkRawBsd = 12;
+    constexpr uint32_t kLinkLinuxSll = 113;
+    constexpr uint32_t kLinkIpv4 = 228;
+    constexpr uint32_t kLinkIpv6 = 229;
+    constexpr uint32_t kLinkLinuxSll2 = 276;
+
+    constexpr uint8_t kTcpSyn = 0x02;
+    constexpr uint8_t kTcpRst = 0x04;
+    // Out-of-order data held per stream before the missing segment is given up on
+    constexpr size_t kMaxPendingBytes = 64u << 20;
+
+    uint16_t be16(const uint8_t* p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+    uint32_t be32(const uint8_t* p) { return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3]; }
+
+    // Capture files store their own fields in the writer's byte order
+    uint32_t field32(const uint8_t* p, bool swapped) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return swapped ? __builtin_bswap32(value) : value;
+    }
+
+    uint16_t field16(const uint8_t* p, bool swapped) {
+        uint16_t value;
+        memcpy(&value, p, sizeof(value));
+        return swapped ? __builtin_bswap16(value) : value;
+    }
+
+    // Sequence numbers wrap; b is after a if the signed distance is positive
+    int32_t seqDiff(uint32_t a, uint32_t b) { return static_cast<int32_t>(b - a); }
+
+    // Sensor types map back to the stream that carries them; dispatchFrame only
+    // needs the data type for relay subscriptions
+    uint8_t dataTypeFor(const stDataSensorReqMsg& sensor) {
+        switch (sensor.mSensorType) {
+            case 3: return eDataType::RECONGITION_RESULT;
+            case 4: return eDataType::RESOURCE_INFO;
+            case 5: return eDataType::DEBUG_MESSAGE;
+            default: return eDataType::SENSOR;
+        }
+    }
+
+    // A capture that starts mid-stream is picked up at the first plausible
+    // DATA_SENSOR header; the parser's own checks then confirm or reject it
+    bool plausibleHeader(const char* p) {
+        uint8_t messageType = static_cast<uint8_t>(p[offsetof(Protocol_Header, messageType)]);
+        uint32_t bodyLength;
+        memcpy(&bodyLength, p + offsetof(Protocol_Header, bodyLength), sizeof(bodyLength));
+        return messageType == MessageType::DATA_SENSOR &&
+               bodyLength >= sizeof(stDataSensorReqMsg) && bodyLength <= kMaxBodyLength;
+    }
+}
+
+struct PcapIngest::Flow {
+    Flow(FramePool& pool, ReceiveStats& stats) : parser(pool, stats) {}
+
+    ProtocolParser parser;
+    size_t backend = 0;
+    bool started = false;
+    bool synced = false;    // the parser sits on a message boundary it found itself
+    uint32_t next = 0;      // sequence number of the next byte in order
+    std::map<uint32_t, std::vector<char>> pending;  // segments after a hole, by sequence number
+    size_t pendingBytes = 0;
+    std::vector<char> carry;  // tail too short to test for a header while hunting
+};
+
+PcapIngest::PcapIngest(TcpClient& client, const std::string& path) : client(client), path(path) {
+    auto& backends = client.getBackends();
+    for (size_t i = 0; i < backends.size(); ++i) {
+        for (uint16_t port : backends[i].ports) {
+            if (std::find(ports.begin(), ports.end(), port) == ports.end()) ports.push_back(port);
+        }
+        boost::system::error_code error;
+        auto address = boost::asio::ip::make_address(backends[i].host, error);
+        if (error) continue;
+        std::string key;
+        if (address.is_v4()) {
+            auto bytes = address.to_v4().to_bytes();
+            key.assign(bytes.begin(), bytes.end());
+        } else {
+            auto bytes = address.to_v6().to_bytes();
+            key.assign(bytes.begin(), bytes.end());
+        }
+        backendIndex.emplace(key, i);
+    }
+}
+
+PcapIngest::~PcapIngest() {
+    if (data) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+}
+
+bool PcapIngest::run() {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "[PCAP] cannot open " << path << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 24) {
+        ::close(fd);
+        std::cerr << "[PCAP] " << path << " is not a capture" << std::endl;
+        return false;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "[PCAP] cannot map " << path << std::endl;
+        return false;
+    }
+    data = static_cast<const uint8_t*>(mapped);
+    size = st.st_size;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    uint64_t begin = Tracer::now();
+    uint32_t magic = field32(data, false);
+    bool ok;
+    if (magic == kPcapngSection) {
+        ok = readPcapng();
+    } else {
+        ok = readPcap();
+    }
+    if (!ok) {
+        std::cerr << "[PCAP] " << path << " is not a pcap or pcapng capture" << std::endl;
+        return false;
+    }
+
+    for (const auto& entry : flows) {
+        if (!entry.second->pending.empty()) ++stats.gaps;  // the capture ends inside a hole
+    }
+    uint64_t elapsed = Tracer::now() - begin;
+    stats.reassembleNs = elapsed - std::min(elapsed, stats.parseNs + stats.dispatchNs);
+    report(elapsed);
+    return true;
+}
+
+bool PcapIngest::readPcap() {
+    uint32_t magic = field32(data, false);
+    bool swapped;
+    if (magic == kPcapMicros || magic == kPcapNanos) {
+        swapped = false;
+    } else if (magic == __builtin_bswap32(kPcapMicros) || magic == __builtin_bswap32(kPcapNanos)) {
+        swapped = true;
+    } else {
+        return false;
+    }
+    uint32_t linkType = field32(data + 20, swapped) & 0xFFFF;
+
+    size_t offset = 24;
+    while (offset + 16 <= size && !stopping) {
+        uint32_t captured = field32(data + offset + 8, swapped);
+        offset += 16;
+        if (captured > size - offset) break;  // torn last record
+        packet(linkType, data + offset, captured);
+        offset += captured;
+    }
+    return true;
+}
+
+bool PcapIngest::readPcapng() {
+    bool swapped = false;
+    size_t offset = 0;
+    while (offset + 12 <= size && !stopping) {
+        uint32_t type = field32(data + offset, swapped);
+        if (type == kPcapngSection) {
+            // Every section states its own byte order
+            uint32_t order = field32(data + offset + 8, false);
+            if (order == kPcapngByteOrder) {
+                swapped = false;
+            } else if (order == __builtin_bswap32(kPcapngByteOrder)) {
+                swapped = true;
+            } else {
+                return false;
+            }
+            interfaceLinkTypes.clear();
+        }
+        uint32_t length = field32(data + offset + 4, swapped);
+        if (length < 12 || length > size - offset) break;
+        const uint8_t* block = data + offset;
+
+        if (type == kPcapngInterface && length >= 20) {
+            interfaceLinkTypes.push_back(field16(block + 8, swapped));
+        } else if (type == kPcapngEnhancedPacket && length >= 32) {
+            uint32_t interface = field32(block + 8, swapped);
+            uint32_t captured = field32(block + 20, swapped);
+            if (interface < interfaceLinkTypes.size() && captured <= length - 32) {
+                packet(interfaceLinkTypes[interface], block + 28, captured);
+            }
+        } else if (type == kPcapngSimplePacket && length >= 16 && !interfaceLinkTypes.empty()) {
+            uint32_t original = field32(block + 8, swapped);
+            packet(interfaceLinkTypes[0], block + 12, std::min<size_t>(original, length - 16));
+        }
+        offset += length;
+    }
+    return true;
+}
+
+void PcapIngest::packet(uint32_t linkType, const uint8_t* frame, size_t length) {
+    ++stats.packets;
+    uint16_t etherType = 0;
+    size_t header = 0;
+    switch (linkType) {
+        case kLinkEthernet:
+            if (length < 14) break;
+            etherType = be16(frame + 12);
+            header = 14;
+            // 802.1Q and 802.1ad tags, possibly stacked
+            while ((etherType == 0x8100 || etherType == 0x88A8) && length >= header + 4) {
+                etherType = be16(frame + header + 2);
+                header += 4;
+            }
+            break;
+        case kLinkLinuxSll:
+            if (length < 16) break;
+            etherType = be16(frame + 14);
+            header = 16;
+            break;
+        case kLinkLinuxSll2:
+            if (length < 20) break;
+            etherType = be16(frame);
+            header = 20;
+            break;
+        case kLinkNull: {
+            if (length < 4) break;
+            uint32_t family;
+            memcpy(&family, frame, sizeof(family));
+            etherType = family == 2 ? 0x0800 : (family == 24 || family == 28 || family == 30) ? 0x86DD : 0;
+            header = 4;
+            break;
+        }
+        case kLinkRaw:
+        case kLinkRawBsd:
+            if (length < 1) break;
+            etherType = (frame[0] >> 4) == 4 ? 0x0800 : (frame[0] >> 4) == 6 ? 0x86DD : 0;
+            break;
+        case kLinkIpv4:
+            etherType = 0x0800;
+            break;
+        case kLinkIpv6:
+            etherType = 0x86DD;
+            break;
+        default:
+            break;
+    }
+
+    const uint8_t* ip = frame + header;
+    size_t remaining = length - std::min(length, header);
+    if (etherType == 0x0800 && remaining >= 20 && (ip[0] >> 4) == 4) {
+        size_t ipHeader = (ip[0] & 0x0F) * 4u;
+        size_t total = be16(ip + 2);
+        // Reassembling IP fragments is out of scope; backends send whole segments
+        bool fragment = (be16(ip + 6) & 0x3FFF) != 0;
+        if (ip[9] == 6 && !fragment && ipHeader >= 20 && total >= ipHeader && total <= remaining) {
+            segment(ip + 12, ip + 16, 4, ip + ipHeader, total - ipHeader);  // Ethernet padding stays out
+            return;
+        }
+    } else if (etherType == 0x86DD && remaining >= 40 && (ip[0] >> 4) == 6) {
+        uint8_t nextHeader = ip[6];
+        size_t total = std::min<size_t>(remaining, 40u + be16(ip + 4));
+        size_t offset = 40;
+        // Hop-by-hop, routing and destination options come before TCP
+        while ((nextHeader == 0 || nextHeader == 43 || nextHeader == 60) && offset + 8 <= total) {
+            nextHeader = ip[offset];
+            offset += (ip[offset + 1] + 1u) * 8;
+        }
+        if (nextHeader == 6 && offset <= total) {
+            segment(ip + 8, ip + 24, 16, ip + offset, total - offset);
+            return;
+        }
+    }
+    ++stats.skipped;
+}
+
+void PcapIngest::segment(const uint8_t* source, const uint8_t* destination, size_t addressBytes,
+                         const uint8_t* tcp, size_t length) {
+    if (length < 20 || (tcp[12] >> 4) * 4u > length) {
+        ++stats.skipped;
+        return;
+    }
+    uint16_t sourcePort = be16(tcp);
+    // Only what the backends send; requests and heartbeats from the client are not parsed
+    if (std::find(ports.begin(), ports.end(), sourcePort) == ports.end()) return;
+
+    size_t tcpHeader = (tcp[12] >> 4) * 4u;
+    uint8_t flags = tcp[13];
+    uint32_t seq = be32(tcp + 4);
+    const char* payload = reinterpret_cast<const char*>(tcp + tcpHeader);
+    size_t payloadSize = length - tcpHeader;
+
+    std::string key(reinterpret_cast<const char*>(source), addressBytes);
+    key.append(reinterpret_cast<const char*>(destination), addressBytes);
+    key.append(reinterpret_cast<const char*>(tcp), 4);  // both ports
+    auto& slot = flows[key];
+    if (!slot || (flags & kTcpSyn)) {
+        // A new connection on the same ports starts over, as the client's session does
+        slot = std::make_unique<Flow>(client.getPayloadPool(false), client.getMutableReceiveStats());
+        slot->backend = backendFor(source, addressBytes);
+    }
+    Flow& flow = *slot;
+    if (flags & kTcpSyn) {
+        flow.started = true;
+        flow.synced = true;
+        flow.next = seq + 1;
+        return;
+    }
+    if (flags & kTcpRst) return;
+    if (payloadSize == 0) return;
+    ++stats.segments;
+
+    if (!flow.started) {
+        // The capture began after the handshake
+        flow.started = true;
+        flow.next = seq;
+    }
+    int32_t ahead = seqDiff(flow.next, seq);
+    if (ahead > 0) {
+        // After a hole; kept until the missing bytes arrive
+        if (flow.pending.emplace(seq, std::vector<char>(payload, payload + payloadSize)).second) {
+            flow.pendingBytes += payloadSize;
+        }
+        if (flow.pendingBytes <= kMaxPendingBytes) return;
+        // The hole is not in the capture; continue after it and find the next message
+        ++stats.gaps;
+        flow.next = flow.pending.begin()->first;
+        flow.parser.reset();
+        flow.synced = false;
+        flow.carry.clear();
+    } else if (static_cast<size_t>(-ahead) < payloadSize) {
+        // New bytes, possibly behind a retransmitted head
+        deliver(flow, payload - ahead, payloadSize + ahead);
+    }
+
+    // Segments the new data made contiguous
+    while (!flow.pending.empty()) {
+        auto first = flow.pending.begin();
+        int32_t offset = seqDiff(flow.next, first->first);
+        if (offset > 0) break;
+        const std::vector<char>& held = first->second;
+        if (static_cast<size_t>(-offset) < held.size()) {
+            deliver(flow, held.data() - offset, held.size() + offset);
+        }
+        flow.pendingBytes -= held.size();
+        flow.pending.erase(first);
+    }
+}
+
+size_t PcapIngest::backendFor(const uint8_t* address, size_t addressBytes) {
+    std::string key(reinterpret_cast<const char*>(address), addressBytes);
+    auto found = backendIndex.find(key);
+    if (found != backendIndex.end()) return found->second;
+    // Captures from another network: backends in the order their servers appear
+    size_t index = unmatched++ % std::max<size_t>(1, client.getBackends().size());
+    backendIndex.emplace(key, index);
+    return index;
+}
+
+void PcapIngest::deliver(Flow& flow, const char* bytes, size_t length) {
+    flow.next += static_cast<uint32_t>(length);
+    stats.streamBytes += length;
+    if (flow.synced) {
+        feed(flow, bytes, length);
+    } else {
+        hunt(flow, bytes, length);
+    }
+}
+
+void PcapIngest::hunt(Flow& flow, const char* bytes, size_t length) {
+    std::vector<char>& carry = flow.carry;
+    carry.insert(carry.end(), bytes, bytes + length);
+    for (size_t offset = 0; offset + sizeof(Protocol_Header) <= carry.size(); ++offset) {
+        if (!plausibleHeader(carry.data() + offset)) continue;
+        ++stats.resyncs;
+        flow.synced = true;
+        std::vector<char> rest(carry.begin() + offset, carry.end());
+        carry.clear();
+        feed(flow, rest.data(), rest.size());
+        return;
+    }
+    // Keep only what could still be the start of a header
+    if (carry.size() >= sizeof(Protocol_Header)) {
+        carry.erase(carry.begin(), carry.end() - (sizeof(Protocol_Header) - 1));
+    }
+}
+
+void PcapIngest::feed(Flow& flow, const char* bytes, size_t length) {
+    uint64_t begin = Tracer::now();
+    uint64_t dispatched = 0;
+    while (length > 0) {
+        ProtocolParser::Span span = flow.parser.prepare();
+        size_t take = std::min(span.size, length);
+        memcpy(span.data, bytes, take);
+        bytes += take;
+        length -= take;
+
+        TraceSpan parseSpan("parse");
+        ProtocolParser::Result result = flow.parser.commit(take);
+        parseSpan.end();
+        if (result == ProtocolParser::Malformed) {
+            // A live session reconnects here; a capture can only look further on
+            flow.parser.reset();
+            flow.synced = false;
+            stats.parseNs += Tracer::now() - begin - dispatched;
+            stats.dispatchNs += dispatched;
+            hunt(flow, bytes, length);
+            return;
+        }
+        if (result != ProtocolParser::Complete) continue;
+        ++stats.messages;
+        if (flow.parser.hasSensorMessage()) {
+            uint64_t dispatchBegin = Tracer::now();
+            client.dispatchFrame(flow.backend, dataTypeFor(flow.parser.sensorMessage()), flow.parser);
+            dispatched += Tracer::now() - dispatchBegin;
+            ++stats.frames;
+        }
+    }
+    stats.parseNs += Tracer::now() - begin - dispatched;
+    stats.dispatchNs += dispatched;
+}
+
+void PcapIngest::report(uint64_t elapsedNs) const {
+    auto seconds = [](uint64_t ns) { return ns / 1e9; };
+    auto rate = [](double amount, uint64_t ns) { return ns ? amount * 1e9 / ns : 0.0; };
+    double megabytes = stats.streamBytes / (1024.0 * 1024.0);
+
+    std::cout << "[PCAP] " << path << ": " << stats.packets << " packets, " << flows.size() << " streams, "
+              << megabytes << " MB of stream data in " << seconds(elapsedNs) << " s ("
+              << rate(megabytes, elapsedNs) << " MB/s)" << std::endl;
+    std::cout << "[PCAP]   read + reassemble " << seconds(stats.reassembleNs) << " s ("
+              << rate(stats.segments, stats.reassembleNs) << " segments/s)" << std::endl;
+    std::cout << "[PCAP]   parse " << seconds(stats.parseNs) << " s ("
+              << rate(megabytes, stats.parseNs) << " MB/s, "
+              << rate(stats.messages, stats.parseNs) << " messages/s)" << std::endl;
+    std::cout << "[PCAP]   dispatch + decode " << seconds(stats.dispatchNs) << " s ("
+              << rate(stats.frames, stats.dispatchNs) << " frames/s)" << std::endl;
+    if (stats.skipped || stats.resyncs || stats.gaps) {
+        std::cout << "[PCAP]   " << stats.skipped << " packets skipped, " << stats.resyncs
+                  << " resyncs, " << stats.gaps << " gaps" << std::endl;
+    }
+}
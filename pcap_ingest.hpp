@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "protocol_parser.hpp"
+
+class TcpClient;
+
+// Replays a pcap or pcapng capture of backend traffic through the receive path
+// with no sockets. Server-to-client TCP streams on the backends' ports are
+// reassembled by sequence number and written into a ProtocolParser through
+// prepare()/commit(), the same way a socket read fills it. Complete sensor
+// messages go to TcpClient::dispatchFrame, which then converts and decodes
+// them as it would live frames. The capture runs as fast as the CPU allows, on
+// the calling thread and in capture order, so repeated runs do the same work.
+// The time spent in each stage is reported at the end.
+class PcapIngest {
+public:
+    PcapIngest(TcpClient& client, const std::string& path);
+    ~PcapIngest();
+
+    // Reads the whole capture; false if it cannot be opened or is not a capture
+    bool run();
+    // Any thread; run() returns after the packet it is on
+    void stop() { stopping = true; }
+
+    PcapIngest(const PcapIngest&) = delete;
+    PcapIngest& operator=(const PcapIngest&) = delete;
+
+private:
+    struct Flow;
+
+    // Time and volume per stage, in steady_clock nanoseconds
+    struct Stats {
+        uint64_t packets = 0;
+        uint64_t segments = 0;        // TCP segments carrying data on a backend port
+        uint64_t skipped = 0;         // not IPv4/IPv6 TCP, IP fragments, or truncated
+        uint64_t streamBytes = 0;     // reassembled bytes handed to the parsers
+        uint64_t messages = 0;
+        uint64_t frames = 0;          // sensor messages dispatched
+        uint64_t resyncs = 0;         // times a parser had to hunt for the next header
+        uint64_t gaps = 0;            // data missing from the capture
+        uint64_t reassembleNs = 0;
+        uint64_t parseNs = 0;
+        uint64_t dispatchNs = 0;
+    };
+
+    bool readPcap();
+    bool readPcapng();
+    void packet(uint32_t linkType, const uint8_t* data, size_t size);
+    void segment(const uint8_t* source, const uint8_t* destination, size_t addressBytes,
+                 const uint8_t* tcp, size_t size);
+    void deliver(Flow& flow, const char* data, size_t size);
+    void hunt(Flow& flow, const char* data, size_t size);
+    void feed(Flow& flow, const char* data, size_t size);
+    size_t backendFor(const uint8_t* address, size_t addressBytes);
+    void report(uint64_t elapsedNs) const;
+
+    TcpClient& client;
+    std::string path;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    std::atomic<bool> stopping{false};
+
+    std::vector<uint16_t> ports;                 // backend data and control ports
+    std::map<std::string, size_t> backendIndex;  // server address bytes -> backend
+    size_t unmatched = 0;                        // servers not in the configuration so far
+    std::map<std::string, std::unique_ptr<Flow>> flows;
+    std::vector<uint32_t> interfaceLinkTypes;    // pcapng interfaces in order
+    Stats stats;
+};
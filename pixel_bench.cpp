@@ -0,0 +1,214 @@
+// Correctness check and throughput benchmark for every pixel kernel. For each
+// (format, depth) with a kernel of its own, a random image is written in that
+// payload layout by a plain reference encoder, decoded by the kernel and
+// compared with the BGR it must produce. The kernel then converts --frames
+// payloads of that size and the time per frame is reported.
+//
+//   pixel_bench [--width W] [--height H] [--frames N]
+//
+// Exits non-zero if any kernel's output is off by more than its tolerance.
+#include "pixel_formats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Sample {
+        std::vector<uint8_t> payload;
+        cv::Mat expected;  // CV_8UC3 in the kernel's output size
+        int tolerance;     // YUV goes through fixed-point arithmetic in OpenCV
+    };
+
+    uint8_t clamp(double value) {
+        return static_cast<uint8_t>(std::min(255.0, std::max(0.0, value + 0.5)));
+    }
+
+    // BT.601 limited range, as OpenCV's YUV2BGR conversions use
+    void yuvToBgr(int y, int u, int v, uint8_t* bgr) {
+        double luma = 1.164 * (y - 16);
+        bgr[0] = clamp(luma + 2.018 * (u - 128));
+        bgr[1] = clamp(luma - 0.813 * (v - 128) - 0.391 * (u - 128));
+        bgr[2] = clamp(luma + 1.596 * (v - 128));
+    }
+
+    // Where the red sample sits in each 2x2 quad
+    void redPosition(ePixelFormat format, int& redX, int& redY) {
+        redX = format == ePixelFormat::BAYER_GRBG || format == ePixelFormat::BAYER_BGGR;
+        redY = format == ePixelFormat::BAYER_GBRG || format == ePixelFormat::BAYER_BGGR;
+    }
+
+    // The bits below the top 8 are random; the kernels must ignore them
+    void writeRaw(std::vector<uint8_t>& payload, size_t rowBytes, int depth, int x, int y, uint8_t value,
+                  std::mt19937& random) {
+        uint8_t* row = payload.data() + rowBytes * y;
+        uint8_t low = static_cast<uint8_t>(random());
+        if (depth == 8) {
+            row[x] = value;
+        } else if (depth == 12) {
+            // MIPI RAW12: the high 8 bits of a pair, then both low nibbles
+            uint8_t* pair = row + 3 * (x / 2);
+            pair[x % 2] = value;
+            pair[2] = static_cast<uint8_t>(x % 2 ? (pair[2] & 0x0F) | (low & 0xF0) : (pair[2] & 0xF0) | (low & 0x0F));
+        } else {
+            row[2 * x] = low;
+            row[2 * x + 1] = value;
+        }
+    }
+
+    Sample encode(const PixelKernel& kernel, int width, int height, std::mt19937& random) {
+        Sample sample;
+        sample.payload.resize(kernel.payloadSize(width, height));
+        sample.expected.create(kernel.outputSize(width, height), CV_8UC3);
+        sample.tolerance = 0;
+        auto byte = [&random]() { return static_cast<uint8_t>(random()); };
+        auto in = [&random](int low, int high) { return std::uniform_int_distribution<int>(low, high)(random); };
+        uint8_t* payload = sample.payload.data();
+
+        switch (kernel.format) {
+            case ePixelFormat::BGR888:
+            case ePixelFormat::RGB888:
+            case ePixelFormat::GRAY: {
+                int channels = kernel.format == ePixelFormat::GRAY ? 1 : 3;
+                for (auto& value : sample.payload) value = byte();
+                for (int y = 0; y < height; ++y) {
+                    uint8_t* out = sample.expected.ptr<uint8_t>(y);
+                    const uint8_t* src = payload + static_cast<size_t>(y) * width * channels;
+                    for (int x = 0; x < width; ++x) {
+                        for (int c = 0; c < 3; ++c) {
+                            int from = channels == 1 ? 0 : kernel.format == ePixelFormat::RGB888 ? 2 - c : c;
+                            out[3 * x + c] = src[channels * x + from];
+                        }
+                    }
+                }
+                break;
+            }
+            case ePixelFormat::UYVY:
+            case ePixelFormat::YUYV: {
+                sample.tolerance = 2;
+                bool uyvy = kernel.format == ePixelFormat::UYVY;
+                for (int y = 0; y < height; ++y) {
+                    uint8_t* out = sample.expected.ptr<uint8_t>(y);
+                    uint8_t* src = payload + static_cast<size_t>(y) * width * 2;
+                    for (int x = 0; x < width; x += 2) {
+                        int u = in(16, 240), v = in(16, 240), y0 = in(16, 235), y1 = in(16, 235);
+                        uint8_t* quad = src + 2 * x;
+                        quad[uyvy ? 0 : 1] = static_cast<uint8_t>(u);
+                        quad[uyvy ? 1 : 0] = static_cast<uint8_t>(y0);
+                        quad[uyvy ? 2 : 3] = static_cast<uint8_t>(v);
+                        quad[uyvy ? 3 : 2] = static_cast<uint8_t>(y1);
+                        yuvToBgr(y0, u, v, out + 3 * x);
+                        yuvToBgr(y1, u, v, out + 3 * x + 3);
+                    }
+                }
+                break;
+            }
+            case ePixelFormat::NV12: {
+                sample.tolerance = 2;
+                uint8_t* chroma = payload + static_cast<size_t>(width) * height;
+                for (int y = 0; y < height; ++y) {
+                    for (int x = 0; x < width; ++x) payload[static_cast<size_t>(y) * width + x] = static_cast<uint8_t>(in(16, 235));
+                }
+                for (int y = 0; y < height / 2; ++y) {
+                    for (int x = 0; x < width; ++x) chroma[static_cast<size_t>(y) * width + x] = static_cast<uint8_t>(in(16, 240));
+                }
+                for (int y = 0; y < height; ++y) {
+                    uint8_t* out = sample.expected.ptr<uint8_t>(y);
+                    const uint8_t* uv = chroma + static_cast<size_t>(y / 2) * width;
+                    for (int x = 0; x < width; ++x) {
+                        yuvToBgr(payload[static_cast<size_t>(y) * width + x], uv[x & ~1], uv[x | 1], out + 3 * x);
+                    }
+                }
+                break;
+            }
+            default: {
+                // Bayer: both greens of a quad equal, so the half-resolution output is exact
+                int redX, redY;
+                redPosition(kernel.format, redX, redY);
+                size_t rowBytes = kernel.payloadSize(width, 1);
+                for (int y = 0; y < height / 2; ++y) {
+                    uint8_t* out = sample.expected.ptr<uint8_t>(y);
+                    for (int x = 0; x < width / 2; ++x) {
+                        uint8_t b = byte(), g = byte(), r = byte();
+                        out[3 * x] = b;
+                        out[3 * x + 1] = g;
+                        out[3 * x + 2] = r;
+                        for (int dy = 0; dy < 2; ++dy) {
+                            for (int dx = 0; dx < 2; ++dx) {
+                                uint8_t value = dx == redX && dy == redY ? r : dx != redX && dy != redY ? b : g;
+                                writeRaw(sample.payload, rowBytes, kernel.depth, 2 * x + dx, 2 * y + dy, value, random);
+                            }
+                        }
+                    }
+                }
+                break;
+            }
+        }
+        return sample;
+    }
+
+    int maxError(const cv::Mat& decoded, const cv::Mat& expected) {
+        if (decoded.rows != expected.rows || decoded.cols != expected.cols) return 255;
+        int worst = 0;
+        for (int y = 0; y < expected.rows; ++y) {
+            const uint8_t* got = decoded.ptr<uint8_t>(y);
+            const uint8_t* want = expected.ptr<uint8_t>(y);
+            for (int x = 0; x < expected.cols * 3; ++x) worst = std::max(worst, std::abs(got[x] - want[x]));
+        }
+        return worst;
+    }
+}
+
+int main(int argc, char** argv) {
+    int width = 1920;
+    int height = 1080;
+    int frames = 200;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--width") width = std::atoi(argv[i + 1]);
+        else if (flag == "--height") height = std::atoi(argv[i + 1]);
+        else if (flag == "--frames") frames = std::atoi(argv[i + 1]);
+        else {
+            std::cerr << "usage: " << argv[0] << " [--width W] [--height H] [--frames N]" << std::endl;
+            return 2;
+        }
+    }
+    // Every layout needs whole 2x2 sample groups
+    width = std::max(2, width & ~1);
+    height = std::max(2, height & ~1);
+    frames = std::max(1, frames);
+
+    std::mt19937 random(12345);
+    int failures = 0;
+    for (uint8_t format = 0; format < static_cast<uint8_t>(ePixelFormat::PIXEL_FORMAT_MAX); ++format) {
+        for (uint8_t depth : {8, 12, 16}) {
+            const PixelKernel* kernel = findPixelKernel(format, depth);
+            if (!kernel || kernel->depth != depth) continue;
+
+            // The check runs on a small image so a failure is cheap to debug
+            Sample sample = encode(*kernel, 64, 48, random);
+            cv::Mat decoded;
+            kernel->convert(sample.payload.data(), 64, 48, decoded);
+            int error = maxError(decoded, sample.expected);
+            bool ok = error <= sample.tolerance;
+            if (!ok) ++failures;
+
+            Sample bench = encode(*kernel, width, height, random);
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < frames; ++i) {
+                kernel->convert(bench.payload.data(), width, height, decoded);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::printf("[PIXEL] %-12s %-6s max error %3d (<= %d) | %dx%d: %7.3f ms/frame, %7.0f MPix/s, %6.0f MB/s in\n",
+                kernel->name, ok ? "ok" : "FAILED", error, sample.tolerance, width, height,
+                seconds * 1e3 / frames, static_cast<double>(width) * height * frames / seconds / 1e6,
+                static_cast<double>(bench.payload.size()) * frames / seconds / (1024.0 * 1024.0));
+        }
+    }
+    std::printf("[PIXEL] %s\n", failures == 0 ? "all kernels ok" : "some kernels FAILED");
+    return failures == 0 ? 0 : 1;
+}
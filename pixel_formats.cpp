@@ -0,0 +1,195 @@
+#include "pixel_formats.hpp"
+#include <array>
+#include <cstring>
+#include <vector>
+
+namespace {
+    // Layouts OpenCV already converts with vectorized code; the conversion code,
+    // source type, plane geometry and chroma subsampling are fixed at compile
+    // time. cvtColor throws on sizes the subsampling does not divide.
+    template <int Code, int SrcType, int BytesNum, int BytesDen, int RowsNum = 1, int RowsDen = 1,
+              int WidthStep = 1, int HeightStep = 1>
+    struct OpenCvKernel {
+        static size_t payloadSize(int width, int height) {
+            return static_cast<size_t>(width) * height * BytesNum / BytesDen;
+        }
+        static bool fitsGeometry(int width, int height) {
+            return width % WidthStep == 0 && height % HeightStep == 0;
+        }
+        static cv::Size outputSize(int width, int height) {
+            return cv::Size(width, height);
+        }
+        static void convert(const uint8_t* src, int width, int height, cv::Mat& bgr) {
+            cv::Mat input(height * RowsNum / RowsDen, width, SrcType, const_cast<uint8_t*>(src));
+            cv::cvtColor(input, bgr, Code);
+        }
+    };
+
+    struct CopyBgrKernel {
+        static size_t payloadSize(int width, int height) {
+            return static_cast<size_t>(width) * height * 3;
+        }
+        static bool fitsGeometry(int, int) {
+            return true;
+        }
+        static cv::Size outputSize(int width, int height) {
+            return cv::Size(width, height);
+        }
+        static void convert(const uint8_t* src, int width, int height, cv::Mat& bgr) {
+            cv::Mat(height, width, CV_8UC3, const_cast<uint8_t*>(src)).copyTo(bgr);
+        }
+    };
+
+    // Raw sample unpacking to the top 8 bits.
+    template <int Bits> struct RawUnpack;
+
+    template <> struct RawUnpack<8> {
+        static size_t rowBytes(int width) { return width; }
+        static void row(const uint8_t* src, uint8_t* dst, int width) {
+            for (int x = 0; x < width; ++x) dst[x] = src[x];
+        }
+    };
+
+    // MIPI CSI-2 RAW12: two samples in three bytes, high nibbles first
+    template <> struct RawUnpack<12> {
+        static size_t rowBytes(int width) { return static_cast<size_t>(width) * 3 / 2; }
+        static void row(const uint8_t* src, uint8_t* dst, int width) {
+            for (int x = 0; x < width / 2; ++x) {
+                dst[2 * x] = src[3 * x];
+                dst[2 * x + 1] = src[3 * x + 1];
+            }
+        }
+    };
+
+    // RAW16: full 16-bit samples, little-endian, so the top 8 bits are the high byte
+    template <> struct RawUnpack<16> {
+        static size_t rowBytes(int width) { return static_cast<size_t>(width) * 2; }
+        static void row(const uint8_t* src, uint8_t* dst, int width) {
+            for (int x = 0; x < width; ++x) dst[x] = src[2 * x + 1];
+        }
+    };
+
+    // Bayer fast path: every 2x2 CFA quad becomes one BGR pixel (half resolution).
+    // RedX/RedY locate the red sample inside the quad.
+    template <int Bits, int RedX, int RedY>
+    struct BayerKernel {
+        static size_t payloadSize(int width, int height) {
+            return RawUnpack<Bits>::rowBytes(width) * height;
+        }
+        // Whole CFA quads only; RAW12 also packs samples in pairs
+        static bool fitsGeometry(int width, int height) {
+            return width % 2 == 0 && height % 2 == 0;
+        }
+        static cv::Size outputSize(int width, int height) {
+            return cv::Size(width / 2, height / 2);
+        }
+        static void convert(const uint8_t* src, int width, int height, cv::Mat& bgr) {
+            bgr.create(height / 2, width / 2, CV_8UC3);
+            thread_local std::vector<uint8_t> scratch;
+            scratch.resize(static_cast<size_t>(width) * 2);
+            uint8_t* rows[2] = {scratch.data(), scratch.data() + width};
+            size_t stride = RawUnpack<Bits>::rowBytes(width);
+
+            for (int y = 0; y < height / 2; ++y) {
+                RawUnpack<Bits>::row(src + stride * (2 * y), rows[0], width);
+                RawUnpack<Bits>::row(src + stride * (2 * y + 1), rows[1], width);
+                const uint8_t* redRow = rows[RedY];
+                const uint8_t* blueRow = rows[1 - RedY];
+                uint8_t* out = bgr.ptr<uint8_t>(y);
+                for (int x = 0; x < width / 2; ++x) {
+                    out[3 * x] = blueRow[2 * x + 1 - RedX];
+                    out[3 * x + 1] = static_cast<uint8_t>((redRow[2 * x + 1 - RedX] + blueRow[2 * x + RedX] + 1) >> 1);
+                    out[3 * x + 2] = redRow[2 * x + RedX];
+                }
+            }
+        }
+    };
+
+    template <typename Kernel>
+    constexpr PixelKernel makeKernel(ePixelFormat format, uint8_t depth, const char* name) {
+        return PixelKernel{format, depth, name, &Kernel::payloadSize, &Kernel::fitsGeometry, &Kernel::outputSize,
+                           &Kernel::convert};
+    }
+
+    const PixelKernel kKernels[] = {
+        makeKernel<OpenCvKernel<cv::COLOR_YUV2BGR_UYVY, CV_8UC2, 2, 1, 1, 1, 2, 1>>(ePixelFormat::UYVY, 8, "UYVY"),
+        makeKernel<OpenCvKernel<cv::COLOR_YUV2BGR_YUYV, CV_8UC2, 2, 1, 1, 1, 2, 1>>(ePixelFormat::YUYV, 8, "YUYV"),
+        makeKernel<OpenCvKernel<cv::COLOR_YUV2BGR_NV12, CV_8UC1, 3, 2, 3, 2, 2, 2>>(ePixelFormat::NV12, 8, "NV12"),
+        makeKernel<OpenCvKernel<cv::COLOR_RGB2BGR, CV_8UC3, 3, 1>>(ePixelFormat::RGB888, 8, "RGB888"),
+        makeKernel<CopyBgrKernel>(ePixelFormat::BGR888, 8, "BGR888"),
+        makeKernel<OpenCvKernel<cv::COLOR_GRAY2BGR, CV_8UC1, 1, 1>>(ePixelFormat::GRAY, 8, "GRAY8"),
+        makeKernel<BayerKernel<8, 0, 0>>(ePixelFormat::BAYER_RGGB, 8, "RAW8 RGGB"),
+        makeKernel<BayerKernel<8, 1, 0>>(ePixelFormat::BAYER_GRBG, 8, "RAW8 GRBG"),
+        makeKernel<BayerKernel<8, 0, 1>>(ePixelFormat::BAYER_GBRG, 8, "RAW8 GBRG"),
+        makeKernel<BayerKernel<8, 1, 1>>(ePixelFormat::BAYER_BGGR, 8, "RAW8 BGGR"),
+        makeKernel<BayerKernel<12, 0, 0>>(ePixelFormat::BAYER_RGGB, 12, "RAW12 RGGB"),
+        makeKernel<BayerKernel<12, 1, 0>>(ePixelFormat::BAYER_GRBG, 12, "RAW12 GRBG"),
+        makeKernel<BayerKernel<12, 0, 1>>(ePixelFormat::BAYER_GBRG, 12, "RAW12 GBRG"),
+        makeKernel<BayerKernel<12, 1, 1>>(ePixelFormat::BAYER_BGGR, 12, "RAW12 BGGR"),
+        makeKernel<BayerKernel<16, 0, 0>>(ePixelFormat::BAYER_RGGB, 16, "RAW16 RGGB"),
+        makeKernel<BayerKernel<16, 1, 0>>(ePixelFormat::BAYER_GRBG, 16, "RAW16 GRBG"),
+        makeKernel<BayerKernel<16, 0, 1>>(ePixelFormat::BAYER_GBRG, 16, "RAW16 GBRG"),
+        makeKernel<BayerKernel<16, 1, 1>>(ePixelFormat::BAYER_BGGR, 16, "RAW16 BGGR"),
+    };
+}
+
+namespace {
+    const PixelKernel* searchPixelKernel(uint8_t format, uint8_t depth) {
+        const PixelKernel* fallback = nullptr;
+        for (const auto& kernel : kKernels) {
+            if (static_cast<uint8_t>(kernel.format) != format) continue;
+            if (kernel.depth == depth) return &kernel;
+            if (!fallback) fallback = &kernel;
+        }
+        return fallback;
+    }
+
+    constexpr size_t kFormatCount = static_cast<size_t>(ePixelFormat::PIXEL_FORMAT_MAX);
+    constexpr size_t kDepthCount = 17;  // 0..16 bits
+}
+
+const PixelKernel* findPixelKernel(uint8_t format, uint8_t depth) {
+    // Every frame asks, so each (format, depth) is resolved once, fallbacks included
+    static const auto resolved = [] {
+        std::array<std::array<const PixelKernel*, kDepthCount>, kFormatCount> table{};
+        for (size_t f = 0; f < kFormatCount; ++f) {
+            for (size_t d = 0; d < kDepthCount; ++d) {
+                table[f][d] = searchPixelKernel(static_cast<uint8_t>(f), static_cast<uint8_t>(d));
+            }
+        }
+        return table;
+    }();
+    if (format < kFormatCount && depth < kDepthCount) return resolved[format][depth];
+    return searchPixelKernel(format, depth);
+}
+
+size_t expectedPayloadSize(uint8_t format, uint8_t depth, int width, int height) {
+    const PixelKernel* kernel = findPixelKernel(format, depth);
+    return kernel ? kernel->payloadSize(width, height) : 0;
+}
+
+size_t cropPayload(uint8_t format, uint8_t depth, const uint8_t* src, int width, int height,
+    const cv::Rect& roi, uint8_t* dst) {
+    const PixelKernel* kernel = findPixelKernel(format, depth);
+    if (!kernel) return 0;
+
+    // Every layout stores whole rows; NV12 follows its luma rows with a
+    // half-height plane of interleaved UV pairs, as many bytes per row as luma
+    bool nv12 = kernel->format == ePixelFormat::NV12;
+    size_t stride = nv12 ? width : kernel->payloadSize(width, 1);
+    size_t skip = nv12 ? roi.x : kernel->payloadSize(roi.x, 1);
+    size_t rowBytes = nv12 ? roi.width : kernel->payloadSize(roi.width, 1);
+    uint8_t* out = dst;
+    for (int y = roi.y; y < roi.y + roi.height; ++y) {
+        std::memcpy(out, src + y * stride + skip, rowBytes);
+        out += rowBytes;
+    }
+    if (nv12) {
+        const uint8_t* chroma = src + stride * height;
+        for (int y = roi.y / 2; y < (roi.y + roi.height) / 2; ++y) {
+            std::memcpy(out, chroma + y * stride + skip, rowBytes);
+            out += rowBytes;
+        }
+    }
+    return static_cast<size_t>(out - dst);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include "messages.hpp"
+
+// Conversion of one camera payload layout to BGR. Each entry is a template
+// specialization picked once per stream, so the per-pixel loops stay free of
+// format checks.
+struct PixelKernel {
+    ePixelFormat format;
+    uint8_t depth;
+    const char* name;
+    size_t (*payloadSize)(int width, int height);
+    // False when the layout cannot hold an image of this size, e.g. odd widths in 4:2:2
+    bool (*fitsGeometry)(int width, int height);
+    cv::Size (*outputSize)(int width, int height);
+    void (*convert)(const uint8_t* src, int width, int height, cv::Mat& bgr);
+};
+
+// Exact (format, depth) match first, then any kernel for the format; nullptr if unknown.
+const PixelKernel* findPixelKernel(uint8_t format, uint8_t depth);
+
+// 0 when the format is unknown.
+size_t expectedPayloadSize(uint8_t format, uint8_t depth, int width, int height);
+
+// Copies roi (even origin and size, inside width x height) of a payload into dst
+// as a payload of its own geometry. Returns the bytes written, 0 if the format is unknown.
+size_t cropPayload(uint8_t format, uint8_t depth, const uint8_t* src, int width, int height,
+    const cv::Rect& roi, uint8_t* dst);
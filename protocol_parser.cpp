@@ -0,0 +1,180 @@
+#include "protocol_parser.hpp"
+#include <cstring>
+#include "pixel_formats.hpp"
+
+namespace {
+    bool knownMessageType(uint8_t type) {
+        switch (type) {
+            case LINK: case LINK_ACK: case REC_INFO: case REC_INFO_ACK:
+            case DATA_SENSOR: case DATA_SENSOR_ACK: case DATA_SEND_REQUEST:
+            case START: case EVENT: case STOP: case CONFIG_INFO:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+ProtocolParser::ProtocolParser(FramePool& pool, ReceiveStats& stats) :
+    pool(pool), stats(stats),
+    currentHeader(*reinterpret_cast<Protocol_Header*>(headerBuffer)) {
+    bodyBuffer.reserve(kMaxBodyLength);
+}
+
+void ProtocolParser::reset() {
+    state = ReadHeader;
+    filled = 0;
+    expected = sizeof(Protocol_Header);
+    sensorValid = false;
+    payload.reset();
+}
+
+ProtocolParser::Span ProtocolParser::prepare() {
+    switch (state) {
+        case ReadHeader:
+            return Span{headerBuffer + filled, expected - filled};
+        case ReadBody:
+            return Span{bodyBuffer.data() + filled, expected - filled};
+        case ReadPayload:
+            return Span{payload.get() + filled, expected - filled};
+        case DiscardPayload:
+        default:
+            return Span{discard, std::min(expected - filled, sizeof(discard))};
+    }
+}
+
+ProtocolParser::Result ProtocolParser::commit(size_t bytes) {
+    stats.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    filled += bytes;
+    if (filled < expected) {
+        return NeedMore;
+    }
+
+    switch (state) {
+        case ReadHeader:
+            memcpy(&currentHeader, headerBuffer, sizeof(Protocol_Header));
+            return startMessage();
+
+        case ReadBody:
+            if (currentHeader.messageType == MessageType::DATA_SENSOR) {
+                // mResult travels in the header and is the first byte of the sensor message
+                memcpy(&sensorMsg, &currentHeader.mResult, 1);
+                memcpy(reinterpret_cast<char*>(&sensorMsg) + 1, bodyBuffer.data(), sizeof(stDataSensorReqMsg) - 1);
+                sensorValid = true;
+                return startPayload();
+            }
+            stats.messages.fetch_add(1, std::memory_order_relaxed);
+            state = ReadHeader;
+            filled = 0;
+            expected = sizeof(Protocol_Header);
+            return Complete;
+
+        case ReadPayload:
+        case DiscardPayload:
+        default:
+            if (state == DiscardPayload) {
+                stats.dropped.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                stats.frames.fetch_add(1, std::memory_order_relaxed);
+            }
+            stats.messages.fetch_add(1, std::memory_order_relaxed);
+            state = ReadHeader;
+            filled = 0;
+            expected = sizeof(Protocol_Header);
+            return Complete;
+    }
+}
+
+ProtocolParser::Result ProtocolParser::startMessage() {
+    sensorValid = false;
+    payload.reset();
+
+    if (!knownMessageType(currentHeader.messageType)) {
+        return fail("unknown message type");
+    }
+    // bodyLength counts mResult, which is already part of the header
+    if (currentHeader.bodyLength < 1 || currentHeader.bodyLength > kMaxBodyLength) {
+        return fail("body length out of range");
+    }
+    if (currentHeader.messageType == MessageType::DATA_SENSOR &&
+        currentHeader.bodyLength < sizeof(stDataSensorReqMsg)) {
+        return fail("sensor message truncated");
+    }
+
+    bodyBuffer.resize(currentHeader.bodyLength - 1);
+    filled = 0;
+    expected = bodyBuffer.size();
+    state = ReadBody;
+    if (expected == 0) {
+        return commit(0);
+    }
+    return NeedMore;
+}
+
+ProtocolParser::Result ProtocolParser::startPayload() {
+    if (sensorMsg.mPayloadSize > kMaxPayloadSize) {
+        return fail("payload size out of range");
+    }
+    if (sensorMsg.mChannel >= static_cast<uint8_t>(eSensorChannel::CHANNEL_MAX)) {
+        return fail("sensor channel out of range");
+    }
+    // Nothing reassembles multi-part frames, and a part cannot be checked against
+    // the image or sweep it belongs to; consume it unread so the stream stays framed
+    if ((sensorMsg.mSensorType == 1 || sensorMsg.mSensorType == 2) && sensorMsg.mTotalNumber > 1) {
+        stats.fragments.fetch_add(1, std::memory_order_relaxed);
+        sensorValid = false;
+        filled = 0;
+        expected = sensorMsg.mPayloadSize;
+        state = DiscardPayload;
+        if (expected == 0) {
+            return commit(0);
+        }
+        return NeedMore;
+    }
+    if (sensorMsg.mSensorType == 1) {
+        // A frame must cover the image it describes in its pixel format
+        if (sensorMsg.mImgWidth == 0 || sensorMsg.mImgHeight == 0 ||
+            sensorMsg.mImgWidth > kMaxImageDimension || sensorMsg.mImgHeight > kMaxImageDimension) {
+            return fail("image dimensions out of range");
+        }
+        const PixelKernel* kernel = findPixelKernel(sensorMsg.mImgFormat, sensorMsg.mImgDepth);
+        if (!kernel) {
+            return fail("unknown pixel format");
+        }
+        if (!kernel->fitsGeometry(sensorMsg.mImgWidth, sensorMsg.mImgHeight)) {
+            return fail("image dimensions do not fit pixel format");
+        }
+        if (sensorMsg.mPayloadSize < kernel->payloadSize(sensorMsg.mImgWidth, sensorMsg.mImgHeight)) {
+            return fail("image geometry does not match payload");
+        }
+    }
+    if (sensorMsg.mSensorType == 2 &&
+        sensorMsg.mPayloadSize < static_cast<uint64_t>(sensorMsg.mNumPoints) * sizeof(stLidarPoint)) {
+        return fail("point count does not match payload");
+    }
+    if (sensorMsg.mSensorType == 3 &&
+        sensorMsg.mPayloadSize < static_cast<uint64_t>(sensorMsg.mNumPoints) * sizeof(stRecognitionObject)) {
+        return fail("object count does not match payload");
+    }
+    if ((sensorMsg.mSensorType == 4 && sensorMsg.mPayloadSize < sizeof(stResourceInfo)) ||
+        (sensorMsg.mSensorType == 5 && sensorMsg.mPayloadSize < 1)) {
+        return fail("telemetry payload too short");
+    }
+
+    filled = 0;
+    expected = sensorMsg.mPayloadSize;
+    payload = pool.acquire(sensorMsg.mChannel, expected);
+    // Over budget: still consume the payload so the stream stays framed
+    state = payload ? ReadPayload : DiscardPayload;
+    if (expected == 0) {
+        return commit(0);
+    }
+    return NeedMore;
+}
+
+ProtocolParser::Result ProtocolParser::fail(const char* reason) {
+    stats.malformed.fetch_add(1, std::memory_order_relaxed);
+    lastError = reason;
+    payload.reset();
+    return Malformed;
+}
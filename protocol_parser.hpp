@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "messages.hpp"
+#include "frame_pool.hpp"
+
+// Upper bounds for fields the backend controls.
+constexpr uint32_t kMaxBodyLength = 64 * 1024;
+constexpr uint32_t kMaxPayloadSize = 64 * 1024 * 1024;
+constexpr uint16_t kMaxImageDimension = 8192;
+
+struct ReceiveStats {
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> malformed{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> duplicates{0};  // camera frames identical to the previous one
+    std::atomic<uint64_t> fragments{0};   // parts of multi-part frames, consumed unread; also in dropped
+};
+
+// Incremental, bounds-checked reader for the Protocol_Header framed stream.
+// The caller asks prepare() where the next bytes belong, fills exactly that many
+// (from a socket read or a captured stream) and hands them back with commit().
+class ProtocolParser {
+public:
+    enum Result {
+        NeedMore,
+        Complete,   // header()/body() describe a full message; sensor frames also carry a payload
+        Malformed,  // the stream cannot be trusted any more; reset() after reconnecting
+    };
+
+    struct Span {
+        char* data;
+        size_t size;
+    };
+
+    ProtocolParser(FramePool& pool, ReceiveStats& stats);
+
+    Span prepare();
+    Result commit(size_t bytes);
+    void reset();
+
+    const Protocol_Header& header() const { return currentHeader; }
+    const char* body() const { return bodyBuffer.data(); }
+    size_t bodySize() const { return bodyBuffer.size(); }
+    bool hasSensorMessage() const { return sensorValid; }
+    const stDataSensorReqMsg& sensorMessage() const { return sensorMsg; }
+    // Empty when the memory governor dropped the payload.
+    FramePool::Buffer takePayload() { return std::move(payload); }
+    const char* error() const { return lastError; }
+
+private:
+    enum State { ReadHeader, ReadBody, ReadPayload, DiscardPayload };
+
+    Result startMessage();
+    Result startPayload();
+    Result fail(const char* reason);
+
+    FramePool& pool;
+    ReceiveStats& stats;
+    State state = ReadHeader;
+    size_t filled = 0;
+    size_t expected = sizeof(Protocol_Header);
+
+    alignas(Protocol_Header) char headerBuffer[sizeof(Protocol_Header)];
+    Protocol_Header currentHeader;
+    std::vector<char> bodyBuffer;
+    stDataSensorReqMsg sensorMsg{};
+    bool sensorValid = false;
+    FramePool::Buffer payload;
+    char discard[16384];
+    const char* lastError = "";
+};
@@ -0,0 +1,580 @@
+// Soak and fuzz harness for the receive path. A synthetic backend on loopback
+// streams randomized DATA_SENSOR traffic as fast as the socket takes it, with
+// malformed Protocol_Header/stDataSensorReqMsg messages and parts of multi-part
+// frames mixed in. A client in the same process runs the LINK -> REC_INFO ->
+// DATA_SEND_REQUEST handshake and reads through ProtocolParser and FramePool as
+// DataStream does. After a parse
+// failure it reconnects, as a live session would. Throughput, RSS and parse
+// failures are reported every few seconds.
+//
+//   protocol_soak [--seconds N] [--malformed PERCENT] [--port P] [--max-rss-growth MB]
+//
+// With --seconds it exits non-zero if RSS grew by more than the limit after
+// warm-up, if a parse failure went missing or one was not injected, or if a
+// frame part reached the client.
+//
+//   protocol_soak --relay HOST:PORT [--channel N]
+//
+// Instead checks a running control_app's relay (CONTROL_APP_RELAY_PORT) as a
+// downstream viewer would use it. The relay must keep the stream framed across
+// repeated DATA_SEND_REQUESTs and, for a camera, cut frames to each region of
+// interest as the viewer zooms, pans and unzooms. The channel must be one the
+// app requests.
+#include "protocol_parser.hpp"
+#include "frame_pool.hpp"
+#include "pixel_formats.hpp"
+#include "synthetic_stream.hpp"
+#include <boost/asio.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <unistd.h>
+
+using boost::asio::ip::tcp;
+using namespace synthetic_stream;
+
+namespace {
+    constexpr size_t kNoiseBytes = 8u << 20;    // random bytes payloads are cut from
+    constexpr uint16_t kMaxSoakDimension = 1024;  // keeps valid frames at a few MB
+    constexpr auto kReportInterval = std::chrono::seconds(5);
+    constexpr auto kWarmUp = std::chrono::seconds(10);
+
+    struct Options {
+        uint16_t port = 19090;
+        double seconds = 0.0;  // 0 runs until killed
+        double malformedPercent = 0.1;
+        double maxRssGrowthMb = 32.0;
+        std::string relay;  // host:port of a running relay to check instead
+        uint8_t channel = 0;
+    };
+
+    double rssMb() {
+        long pages = 0;
+        if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+            long size;
+            if (std::fscanf(statm, "%ld %ld", &size, &pages) != 2) pages = 0;
+            std::fclose(statm);
+        }
+        return pages * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+    }
+
+    struct Counters {
+        std::atomic<uint64_t> injected{0};    // malformed messages the backend sent
+        std::atomic<uint64_t> connections{0};
+        std::atomic<uint64_t> fragmentsDelivered{0};  // must stay 0 until something reassembles them
+        std::mutex mutex;
+        std::map<std::string, uint64_t> failures;  // parser error -> count
+    };
+
+    // One backend connection: answers the handshake, then streams until the client hangs up
+    class SyntheticBackend {
+    public:
+        SyntheticBackend(tcp::socket socket, const Options& options, const std::vector<char>& noise,
+                         Counters& counters, uint64_t seed) :
+            socket(std::move(socket)), options(options), noise(noise), counters(counters), random(seed),
+            parser(pool, stats) {}
+
+        void run() {
+            boost::system::error_code error;
+            if (!handshake(error)) return;
+            uint64_t sequence = 0;
+            while (!error) {
+                if (std::uniform_real_distribution<double>(0.0, 100.0)(random) < options.malformedPercent) {
+                    sendMalformed(sequence++, error);
+                    counters.injected.fetch_add(1, std::memory_order_relaxed);
+                    return;  // the client drops the connection; so would a real backend
+                }
+                sendValid(sequence++, error);
+            }
+        }
+
+    private:
+        // Reads requests with the receive parser; the zeros after a short
+        // DATA_SEND_REQUEST are skipped as the relay does
+        bool handshake(boost::system::error_code& error) {
+            int requests = 0;
+            while (requests < 2) {
+                auto span = parser.prepare();
+                size_t bytes = socket.read_some(boost::asio::buffer(span.data, span.size), error);
+                if (error) return false;
+                auto result = parser.commit(bytes);
+                if (result == ProtocolParser::Malformed) {
+                    std::cerr << "[SOAK] backend: malformed request: " << parser.error() << std::endl;
+                    return false;
+                }
+                if (result != ProtocolParser::Complete) continue;
+                const Protocol_Header& header = parser.header();
+                if (header.messageType == MessageType::LINK) {
+                    boost::asio::write(socket, boost::asio::buffer(encodeHeader(MessageType::LINK_ACK, 0, 1)), error);
+                } else if (header.messageType == MessageType::REC_INFO) {
+                    boost::asio::write(socket, boost::asio::buffer(encodeHeader(MessageType::REC_INFO_ACK, 0, 1)), error);
+                } else if (header.messageType == MessageType::DATA_SEND_REQUEST) {
+                    size_t framed = sizeof(Protocol_Header) + header.bodyLength - 1;
+                    if (framed < kDataRequestFrameBytes) {
+                        char padding[kDataRequestFrameBytes];
+                        boost::asio::read(socket, boost::asio::buffer(padding, kDataRequestFrameBytes - framed), error);
+                    }
+                    ++requests;
+                }
+                if (error) return false;
+            }
+            return true;
+        }
+
+        // uniform_int_distribution has no 8-bit form; those go through int
+        template <typename T>
+        T pick(T low, T high) {
+            using Wide = typename std::conditional<sizeof(T) == 1, int, T>::type;
+            return static_cast<T>(std::uniform_int_distribution<Wide>(low, high)(random));
+        }
+
+        void send(uint64_t sequence, stDataSensorReqMsg sensor, size_t payloadBytes, boost::system::error_code& error,
+                  uint8_t type = MessageType::DATA_SENSOR, uint32_t bodyLength = sizeof(stDataSensorReqMsg)) {
+            std::string head = encodeSensorHead(sequence, sensor, type, bodyLength);
+            size_t offset = pick<size_t>(0, noise.size() - std::min(noise.size(), payloadBytes));
+            std::array<boost::asio::const_buffer, 2> buffers{
+                boost::asio::buffer(head), boost::asio::buffer(noise.data() + offset, payloadBytes)};
+            boost::asio::write(socket, buffers, error);
+        }
+
+        stDataSensorReqMsg cameraFrame(uint64_t sequence) {
+            const Format& format = kFormats[pick<size_t>(0, kFormats.size() - 1)];
+            stDataSensorReqMsg sensor{};
+            sensor.mSequenceNumber = static_cast<uint32_t>(sequence);
+            sensor.mTotalNumber = 1;
+            sensor.mFrameNumber = static_cast<uint32_t>(sequence);
+            sensor.mTimestamp = sequence;
+            sensor.mSensorType = 1;
+            sensor.mChannel = pick<uint8_t>(0, static_cast<uint8_t>(eSensorChannel::CAMERA_SR_REAR));
+            sensor.mImgWidth = static_cast<uint16_t>(pick<uint16_t>(1, kMaxSoakDimension / 2) * 2);
+            sensor.mImgHeight = static_cast<uint16_t>(pick<uint16_t>(1, kMaxSoakDimension / 2) * 2);
+            sensor.mImgFormat = static_cast<uint8_t>(format.format);
+            sensor.mImgDepth = format.depth;
+            sensor.mPayloadSize = static_cast<uint32_t>(expectedPayloadSize(sensor.mImgFormat, sensor.mImgDepth,
+                sensor.mImgWidth, sensor.mImgHeight));
+            return sensor;
+        }
+
+        void sendValid(uint64_t sequence, boost::system::error_code& error) {
+            stDataSensorReqMsg sensor = cameraFrame(sequence);
+            switch (pick(0, 9)) {
+                case 0:  // LiDAR sweep
+                    sensor.mSensorType = 2;
+                    sensor.mChannel = static_cast<uint8_t>(eSensorChannel::LIDAR_ROOF_CENTER);
+                    sensor.mNumPoints = pick<uint32_t>(0, 128 * 2048);
+                    sensor.mPayloadSize = sensor.mNumPoints * sizeof(stLidarPoint);
+                    break;
+                case 1:  // recognition results
+                    sensor.mSensorType = 3;
+                    sensor.mNumPoints = pick<uint32_t>(0, 256);
+                    sensor.mPayloadSize = sensor.mNumPoints * sizeof(stRecognitionObject);
+                    break;
+                case 2:  // resource info or a debug line
+                    sensor.mSensorType = pick<uint8_t>(4, 5);
+                    sensor.mPayloadSize = sensor.mSensorType == 4 ? sizeof(stResourceInfo) : pick<uint32_t>(1, 512);
+                    break;
+                case 3:  // one part of a camera frame or sweep, far shorter than the whole
+                    if (pick(0, 1)) {
+                        sensor.mSensorType = 2;
+                        sensor.mChannel = static_cast<uint8_t>(eSensorChannel::LIDAR_ROOF_CENTER);
+                        sensor.mNumPoints = pick<uint32_t>(1, 128 * 2048);
+                    }
+                    sensor.mTotalNumber = pick<uint32_t>(2, 16);
+                    sensor.mCurrentNumber = pick<uint32_t>(0, sensor.mTotalNumber - 1);
+                    sensor.mPayloadSize = pick<uint32_t>(0, 4096);
+                    break;
+                default:
+                    // Trailing bytes past the image are allowed
+                    if (pick(0, 7) == 0) sensor.mPayloadSize += pick<uint32_t>(1, 4096);
+                    break;
+            }
+            send(sequence, sensor, sensor.mPayloadSize, error);
+        }
+
+        // One field the parser must refuse; the stream is useless after it
+        void sendMalformed(uint64_t sequence, boost::system::error_code& error) {
+            stDataSensorReqMsg sensor = cameraFrame(sequence);
+            switch (pick(0, 11)) {
+                case 0:
+                    send(sequence, sensor, 0, error, pick<uint8_t>(100, 255));  // unknown message type
+                    return;
+                case 1:
+                case 2: {
+                    // Zero would underflow bodyLength - 1; anything past the bound is just too big
+                    uint32_t bodyLength = pick(0, 1) ? 0 : pick<uint32_t>(kMaxBodyLength + 1, UINT32_MAX);
+                    std::string head = encodeHeader(MessageType::DATA_SENSOR, sequence, bodyLength);
+                    boost::asio::write(socket, boost::asio::buffer(head), error);
+                    return;
+                }
+                case 3:
+                    send(sequence, sensor, 0, error, MessageType::DATA_SENSOR, pick<uint32_t>(1, sizeof(stDataSensorReqMsg) - 1));
+                    return;
+                case 4:
+                    sensor.mPayloadSize = pick<uint32_t>(kMaxPayloadSize + 1, UINT32_MAX);
+                    break;
+                case 5:
+                    sensor.mChannel = pick<uint8_t>(static_cast<uint8_t>(eSensorChannel::CHANNEL_MAX), 255);
+                    break;
+                case 6:
+                    sensor.mImgWidth = pick(0, 1) ? 0 : pick<uint16_t>(kMaxImageDimension + 1, UINT16_MAX);
+                    break;
+                case 7:
+                    sensor.mPayloadSize -= pick<uint32_t>(1, sensor.mPayloadSize);  // shorter than the image
+                    break;
+                case 8:
+                    sensor.mImgFormat = pick<uint8_t>(static_cast<uint8_t>(ePixelFormat::PIXEL_FORMAT_MAX), 255);
+                    break;
+                case 9:
+                    sensor.mSensorType = 2;
+                    sensor.mNumPoints = pick<uint32_t>(1, 1u << 20);
+                    sensor.mPayloadSize = sensor.mNumPoints * sizeof(stLidarPoint) - 1;
+                    break;
+                case 10: {
+                    // An odd size the subsampled layouts cannot hold, with a payload that covers it
+                    static constexpr std::array<ePixelFormat, 4> kSubsampled{
+                        ePixelFormat::UYVY, ePixelFormat::YUYV, ePixelFormat::NV12, ePixelFormat::BAYER_RGGB};
+                    sensor.mImgFormat = static_cast<uint8_t>(kSubsampled[pick<size_t>(0, kSubsampled.size() - 1)]);
+                    sensor.mImgDepth = 8;
+                    if (pick(0, 1) || sensor.mImgFormat == static_cast<uint8_t>(ePixelFormat::UYVY) ||
+                        sensor.mImgFormat == static_cast<uint8_t>(ePixelFormat::YUYV)) {
+                        sensor.mImgWidth -= 1;
+                    } else {
+                        sensor.mImgHeight -= 1;
+                    }
+                    sensor.mPayloadSize = static_cast<uint32_t>(3 * sensor.mImgWidth * sensor.mImgHeight);
+                    break;
+                }
+                default:
+                    sensor.mSensorType = 4;
+                    sensor.mPayloadSize = pick<uint32_t>(0, sizeof(stResourceInfo) - 1);
+                    break;
+            }
+            send(sequence, sensor, std::min<size_t>(sensor.mPayloadSize, 4096), error);
+        }
+
+        tcp::socket socket;
+        const Options& options;
+        const std::vector<char>& noise;
+        Counters& counters;
+        std::mt19937_64 random;
+        FramePool pool{"soak-requests", 1u << 20};
+        ReceiveStats stats;
+        ProtocolParser parser;
+    };
+}
+
+namespace {
+    // A downstream viewer on a relay, reading with a deadline per wait
+    class RelayViewer {
+    public:
+        bool connect(const std::string& host, const std::string& port) {
+            boost::system::error_code error;
+            tcp::resolver resolver(io);
+            boost::asio::connect(socket, resolver.resolve(host, port, error), error);
+            if (error) problem = "connect: " + error.message();
+            return !error;
+        }
+
+        bool send(const std::string& message) {
+            boost::system::error_code error;
+            boost::asio::write(socket, boost::asio::buffer(message), error);
+            if (error) problem = "send: " + error.message();
+            return !error;
+        }
+
+        // Reads until a sensor frame satisfies match; false on timeout, a
+        // closed connection or a parse failure, with the reason in problem
+        template <typename Match>
+        bool waitFor(Match match, std::chrono::milliseconds timeout) {
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (true) {
+                auto span = parser.prepare();
+                boost::system::error_code error;
+                size_t bytes = 0;
+                bool done = false;
+                socket.async_read_some(boost::asio::buffer(span.data, span.size),
+                    [&](const boost::system::error_code& readError, size_t readBytes) {
+                        error = readError;
+                        bytes = readBytes;
+                        done = true;
+                    });
+                io.restart();
+                io.run_until(deadline);
+                if (!done) {
+                    socket.cancel();
+                    io.restart();
+                    io.run();
+                    problem = "timed out";
+                    return false;
+                }
+                if (error) {
+                    problem = error == boost::asio::error::eof ? "relay closed the connection" : error.message();
+                    return false;
+                }
+                auto result = parser.commit(bytes);
+                if (result == ProtocolParser::Malformed) {
+                    problem = std::string("malformed stream: ") + parser.error();
+                    return false;
+                }
+                if (result == ProtocolParser::Complete && parser.hasSensorMessage()) {
+                    parser.takePayload();
+                    if (match(parser.sensorMessage())) return true;
+                }
+            }
+        }
+
+        std::string problem;
+
+    private:
+        boost::asio::io_context io;
+        tcp::socket socket{io};
+        FramePool pool{"relay-viewer", 256u << 20};
+        ReceiveStats stats;
+        ProtocolParser parser{pool, stats};
+    };
+
+    int runRelayCheck(const Options& options) {
+        size_t colon = options.relay.rfind(':');
+        if (colon == std::string::npos) {
+            std::cerr << "[SOAK] --relay takes host:port" << std::endl;
+            return 2;
+        }
+        if (options.channel >= static_cast<uint8_t>(eSensorChannel::CHANNEL_MAX)) {
+            std::cerr << "[SOAK] --channel out of range" << std::endl;
+            return 2;
+        }
+        uint32_t mask = 1u << options.channel;
+        auto sameChannel = [&](const stDataSensorReqMsg& sensor) { return sensor.mChannel == options.channel; };
+        const auto timeout = std::chrono::milliseconds(3000);
+        uint64_t sequence = 0;
+        int failures = 0;
+        auto check = [&](const char* step, bool ok, const std::string& detail) {
+            std::printf("[SOAK] relay %-34s %s%s\n", step, ok ? "ok" : "FAILED: ", ok ? "" : detail.c_str());
+            std::fflush(stdout);
+            if (!ok) ++failures;
+            return ok;
+        };
+
+        RelayViewer viewer;
+        if (!check("connect", viewer.connect(options.relay.substr(0, colon), options.relay.substr(colon + 1)),
+                   viewer.problem)) {
+            return 1;
+        }
+        viewer.send(encodeHeader(MessageType::LINK, sequence++, 1));
+        viewer.send(encodeHeader(MessageType::REC_INFO, sequence++, 1));
+        // Back to back, as a throttle change or a viewer re-subscribing sends them;
+        // the relay must skip the first one's padding to read the second
+        viewer.send(encodeDataRequest(sequence++, mask));
+        viewer.send(encodeDataRequest(sequence++, mask));
+        if (!check("two requests in a row",
+                   viewer.waitFor(sameChannel, timeout) && viewer.waitFor(sameChannel, timeout), viewer.problem)) {
+            return 1;
+        }
+        viewer.send(encodeDataRequest(sequence++, mask));
+        stDataSensorReqMsg full{};
+        auto fullFrame = [&](const stDataSensorReqMsg& sensor) {
+            if (!sameChannel(sensor) || isRoiFrame(sensor)) return false;
+            full = sensor;
+            return true;
+        };
+        if (!check("third request on a live stream", viewer.waitFor(fullFrame, timeout), viewer.problem)) {
+            return 1;
+        }
+        if (full.mSensorType != 1) {
+            std::printf("[SOAK] relay channel %d is not a camera; skipping the region of interest steps\n",
+                        options.channel);
+            return failures == 0 ? 0 : 1;
+        }
+
+        // Zoom to the middle quarter, pan right and down by an eighth, then
+        // back to the whole frame, as the viewer does. Frames already in
+        // flight keep the old geometry, so each step waits for the new one.
+        auto even = [](int value) { return static_cast<uint16_t>(value & ~1); };
+        stChannelRoi zoom{options.channel, even(full.mImgWidth / 4), even(full.mImgHeight / 4),
+                          even(full.mImgWidth / 2), even(full.mImgHeight / 2)};
+        stChannelRoi pan = zoom;
+        pan.mX = even(zoom.mX + full.mImgWidth / 8);
+        pan.mY = even(zoom.mY + full.mImgHeight / 8);
+        auto cutTo = [&](const stChannelRoi& roi) {
+            return [&, roi](const stDataSensorReqMsg& sensor) {
+                return sameChannel(sensor) && isRoiFrame(sensor) && roiOriginX(sensor) == roi.mX &&
+                       roiOriginY(sensor) == roi.mY && sensor.mImgWidth == roi.mWidth &&
+                       sensor.mImgHeight == roi.mHeight;
+            };
+        };
+        if (zoom.mWidth == 0 || zoom.mHeight == 0) {
+            check("zoom", false, "frame too small to cut");
+            return 1;
+        }
+        viewer.send(encodeDataRequest(sequence++, mask, {zoom}));
+        if (!check("zoom", viewer.waitFor(cutTo(zoom), timeout), viewer.problem)) return 1;
+        viewer.send(encodeDataRequest(sequence++, mask, {pan}));
+        if (!check("pan", viewer.waitFor(cutTo(pan), timeout), viewer.problem)) return 1;
+        viewer.send(encodeDataRequest(sequence++, mask));
+        check("unzoom", viewer.waitFor([&](const stDataSensorReqMsg& sensor) {
+                  return sameChannel(sensor) && !isRoiFrame(sensor) && sensor.mImgWidth == full.mImgWidth &&
+                         sensor.mImgHeight == full.mImgHeight;
+              }, timeout), viewer.problem);
+        return failures == 0 ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--seconds") options.seconds = std::atof(argv[i + 1]);
+        else if (flag == "--malformed") options.malformedPercent = std::atof(argv[i + 1]);
+        else if (flag == "--port") options.port = static_cast<uint16_t>(std::atoi(argv[i + 1]));
+        else if (flag == "--max-rss-growth") options.maxRssGrowthMb = std::atof(argv[i + 1]);
+        else if (flag == "--relay") options.relay = argv[i + 1];
+        else if (flag == "--channel") options.channel = static_cast<uint8_t>(std::atoi(argv[i + 1]));
+        else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--seconds N] [--malformed PERCENT] [--port P] [--max-rss-growth MB]\n"
+                      << "       " << argv[0] << " --relay HOST:PORT [--channel N]" << std::endl;
+            return 2;
+        }
+    }
+    if (!options.relay.empty()) {
+        return runRelayCheck(options);
+    }
+
+    std::vector<char> noise(kNoiseBytes);
+    std::mt19937_64 seeder(std::random_device{}());
+    for (auto& byte : noise) byte = static_cast<char>(seeder());
+
+    Counters counters;
+    std::atomic<bool> stopping{false};
+    boost::asio::io_context io;
+    tcp::acceptor acceptor(io, tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), options.port));
+    std::thread backend([&]() {
+        while (!stopping) {
+            boost::system::error_code error;
+            tcp::socket socket(io);
+            acceptor.accept(socket, error);
+            if (error) break;
+            SyntheticBackend(std::move(socket), options, noise, counters, seeder()).run();
+        }
+    });
+
+    // The receive side: what DataStream does per connection, minus the io_context
+    FramePool payloadPool{"reassembly", 128u << 20};
+    ReceiveStats stats;
+    std::atomic<uint64_t> checksum{0};
+    std::thread client([&]() {
+        uint64_t sequence = 0;
+        while (!stopping) {
+            boost::system::error_code error;
+            tcp::socket socket(io);
+            socket.connect(tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), options.port), error);
+            if (error) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            counters.connections.fetch_add(1, std::memory_order_relaxed);
+            ProtocolParser parser(payloadPool, stats);
+            boost::asio::write(socket, boost::asio::buffer(encodeHeader(MessageType::LINK, sequence++, 1)), error);
+            boost::asio::write(socket, boost::asio::buffer(encodeHeader(MessageType::REC_INFO, sequence++, 1)), error);
+            // Sent twice, as a throttle or ROI change re-sends it on a live session
+            boost::asio::write(socket, boost::asio::buffer(encodeDataRequest(sequence++, ~0u)), error);
+            boost::asio::write(socket, boost::asio::buffer(encodeDataRequest(sequence++, ~0u)), error);
+            while (!error && !stopping) {
+                auto span = parser.prepare();
+                size_t bytes = socket.read_some(boost::asio::buffer(span.data, span.size), error);
+                if (error) break;
+                auto result = parser.commit(bytes);
+                if (result == ProtocolParser::Malformed) {
+                    std::lock_guard<std::mutex> lock(counters.mutex);
+                    ++counters.failures[parser.error()];
+                    break;
+                }
+                if (result == ProtocolParser::Complete && parser.hasSensorMessage()) {
+                    if (parser.sensorMessage().mTotalNumber > 1) {
+                        counters.fragmentsDelivered.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    auto payload = parser.takePayload();
+                    if (payload && parser.sensorMessage().mPayloadSize > 0) {
+                        checksum.fetch_add(static_cast<uint8_t>(payload[0]), std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+    });
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point lastReport = start;
+    uint64_t lastFrames = 0;
+    uint64_t lastBytes = 0;
+    double baselineRss = 0.0;
+    double peakGrowth = 0.0;
+    while (options.seconds <= 0.0 ||
+           std::chrono::duration<double>(Clock::now() - start).count() < options.seconds) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        Clock::time_point now = Clock::now();
+        if (now - lastReport < kReportInterval) continue;
+
+        double interval = std::chrono::duration<double>(now - lastReport).count();
+        uint64_t frames = stats.frames.load(std::memory_order_relaxed);
+        uint64_t bytes = stats.bytes.load(std::memory_order_relaxed);
+        double rss = rssMb();
+        if (baselineRss == 0.0 && now - start >= kWarmUp) baselineRss = rss;
+        double growth = baselineRss > 0.0 ? rss - baselineRss : 0.0;
+        peakGrowth = std::max(peakGrowth, growth);
+        uint64_t failures = 0;
+        {
+            std::lock_guard<std::mutex> lock(counters.mutex);
+            for (const auto& entry : counters.failures) failures += entry.second;
+        }
+        std::printf("[SOAK] %6.0f s: %8.0f frames/s | %7.1f MB/s | %llu parse failures (%llu injected) | "
+                    "%llu connections | RSS %.1f MB (%+.1f since warm-up)\n",
+            std::chrono::duration<double>(now - start).count(), (frames - lastFrames) / interval,
+            (bytes - lastBytes) / interval / (1024.0 * 1024.0), static_cast<unsigned long long>(failures),
+            static_cast<unsigned long long>(counters.injected.load()),
+            static_cast<unsigned long long>(counters.connections.load()), rss, growth);
+        std::fflush(stdout);
+        lastReport = now;
+        lastFrames = frames;
+        lastBytes = bytes;
+    }
+
+    stopping = true;
+    boost::system::error_code ignored;
+    acceptor.close(ignored);
+    // Both threads block in socket calls; the process ends with them
+    std::printf("[SOAK] parse failures by reason:\n");
+    uint64_t failures = 0;
+    {
+        std::lock_guard<std::mutex> lock(counters.mutex);
+        for (const auto& entry : counters.failures) {
+            std::printf("[SOAK]   %-40s %llu\n", entry.first.c_str(), static_cast<unsigned long long>(entry.second));
+            failures += entry.second;
+        }
+    }
+    // The last injected message may still be in flight when the run ends
+    uint64_t injected = counters.injected.load();
+    bool failuresMatch = failures <= injected && failures + 1 >= injected;
+    bool flatMemory = peakGrowth <= options.maxRssGrowthMb;
+    bool noFragments = counters.fragmentsDelivered.load() == 0;
+    bool ok = failuresMatch && flatMemory && noFragments;
+    std::printf("[SOAK] %llu frames, %llu/%llu injected failures caught, %llu frame parts skipped (%llu delivered), "
+                "peak RSS growth %.1f MB: %s\n",
+        static_cast<unsigned long long>(stats.frames.load()), static_cast<unsigned long long>(failures),
+        static_cast<unsigned long long>(injected), static_cast<unsigned long long>(stats.fragments.load()),
+        static_cast<unsigned long long>(counters.fragmentsDelivered.load()), peakGrowth, ok ? "ok" : "FAILED");
+    std::fflush(stdout);
+    _exit(ok ? 0 : 1);
+}
@@ -0,0 +1,55 @@
+#include "recognition_overlay.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace {
+    const cv::Scalar kClassColors[] = {
+        cv::Scalar(0, 255, 0), cv::Scalar(0, 165, 255), cv::Scalar(255, 0, 0),
+        cv::Scalar(0, 255, 255), cv::Scalar(255, 0, 255), cv::Scalar(255, 255, 0),
+    };
+}
+
+void RecognitionOverlay::addResults(uint8_t channel, uint64_t timestamp, const stRecognitionObject* objects, size_t count) {
+    if (channel >= kChannels) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    ChannelHistory& channelHistory = history[channel];
+    ResultSet& set = channelHistory.sets[channelHistory.next];
+    channelHistory.next = (channelHistory.next + 1) % kHistory;
+
+    set.timestamp = timestamp;
+    set.count = static_cast<uint32_t>(std::min(count, kMaxObjects));
+    std::memcpy(set.objects.data(), objects, set.count * sizeof(stRecognitionObject));
+}
+
+bool RecognitionOverlay::draw(uint8_t channel, uint64_t timestamp, cv::Mat& bgr, float scaleX, float scaleY,
+                              cv::Point origin) {
+    if (channel >= kChannels) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const ResultSet* best = nullptr;
+    uint64_t bestSkew = kMaxSkew + 1;
+    for (const auto& set : history[channel].sets) {
+        if (set.timestamp == 0) continue;
+        uint64_t skew = set.timestamp > timestamp ? set.timestamp - timestamp : timestamp - set.timestamp;
+        if (skew < bestSkew) {
+            bestSkew = skew;
+            best = &set;
+        }
+    }
+    if (!best) return false;
+
+    for (uint32_t i = 0; i < best->count; ++i) {
+        const stRecognitionObject& object = best->objects[i];
+        cv::Rect box(static_cast<int>((object.mX - origin.x) * scaleX), static_cast<int>((object.mY - origin.y) * scaleY),
+            static_cast<int>(object.mWidth * scaleX), static_cast<int>(object.mHeight * scaleY));
+        const cv::Scalar& color = kClassColors[object.mClassId % (sizeof(kClassColors) / sizeof(kClassColors[0]))];
+        cv::rectangle(bgr, box, color, 2);
+
+        std::string label = std::to_string(object.mClassId) + " " +
+            std::to_string(static_cast<int>(object.mScore * 100)) + "%";
+        cv::putText(bgr, label, cv::Point(box.x, std::max(box.y - 4, 12)),
+            cv::FONT_HERSHEY_SIMPLEX, 0.5, color, 1);
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include "messages.hpp"
+
+// Recent recognition results per camera channel, kept as fixed-size POD sets
+// so ingesting a result never allocates. The decode stage pulls the set
+// closest in time to the frame it is about to publish and draws it in place.
+class RecognitionOverlay {
+public:
+    static constexpr size_t kMaxObjects = 256;
+    static constexpr size_t kHistory = 8;
+    static constexpr uint64_t kMaxSkew = 100;  // mTimestamp units (ms)
+
+    void addResults(uint8_t channel, uint64_t timestamp, const stRecognitionObject* objects, size_t count);
+
+    // Draws the result set nearest to timestamp onto bgr; boxes are scaled from
+    // source pixels by the given factors, after moving them by -origin when bgr
+    // shows only a region of the sensor. Returns false if nothing matched.
+    bool draw(uint8_t channel, uint64_t timestamp, cv::Mat& bgr, float scaleX, float scaleY,
+              cv::Point origin = {});
+
+private:
+    struct ResultSet {
+        uint64_t timestamp = 0;
+        uint32_t count = 0;
+        std::array<stRecognitionObject, kMaxObjects> objects;
+    };
+
+    struct ChannelHistory {
+        std::array<ResultSet, kHistory> sets;
+        size_t next = 0;
+    };
+
+    static constexpr size_t kChannels = static_cast<size_t>(eSensorChannel::CHANNEL_MAX);
+
+    std::mutex mutex;
+    std::array<ChannelHistory, kChannels> history;
+};
@@ -0,0 +1,461 @@
+#include "relay_server.hpp"
+#include "tcp_client.hpp"
+#include "pixel_formats.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using boost::asio::ip::tcp;
+using boost::system::error_code;
+
+namespace {
+    constexpr size_t kMaxGather = 16;                 // frames per gathered write
+    constexpr size_t kBulkQueueBytes = 16u << 20;     // about half a second of one camera
+    constexpr size_t kMessageQueueBytes = 1u << 20;
+    constexpr int kBulkSendBuffer = 4 << 20;
+    constexpr size_t kChannels = static_cast<size_t>(eSensorChannel::CHANNEL_MAX);
+
+    // A region as one atomic word: x, y, width, height in 16 bits each
+    uint64_t packRoi(const cv::Rect& roi) {
+        return static_cast<uint64_t>(roi.x) | static_cast<uint64_t>(roi.y) << 16 |
+               static_cast<uint64_t>(roi.width) << 32 | static_cast<uint64_t>(roi.height) << 48;
+    }
+
+    cv::Rect unpackRoi(uint64_t roi) {
+        return cv::Rect(roi & 0xFFFF, roi >> 16 & 0xFFFF, roi >> 32 & 0xFFFF, roi >> 48 & 0xFFFF);
+    }
+}
+
+class RelayServer::Client : public std::enable_shared_from_this<Client> {
+public:
+    Client(RelayServer& server, tcp::socket socket) :
+        server(server), socket(std::move(socket)), parser(server.requestPool, server.requestStats) {
+        error_code ignored;
+        auto endpoint = this->socket.remote_endpoint(ignored);
+        peer = endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
+    }
+
+    void start() {
+        boost::asio::post(socket.get_executor(), [self = shared_from_this()]() {
+            std::cout << "[RELAY] " << self->peer << " connected" << std::endl;
+            self->read();
+        });
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            pending.clear();
+            pendingBytes = 0;
+        }
+        boost::asio::post(socket.get_executor(), [self = shared_from_this()]() {
+            error_code ignored;
+            self->socket.close(ignored);
+        });
+    }
+
+    bool subscribedTo(uint8_t type, uint8_t channel) const {
+        return dataType.load(std::memory_order_relaxed) == type &&
+               (channelMask.load(std::memory_order_relaxed) >> channel & 1u);
+    }
+
+    uint8_t subscribedType() const { return dataType.load(std::memory_order_relaxed); }
+    uint32_t subscribedMask() const { return channelMask.load(std::memory_order_relaxed); }
+    // Packed region the client wants of a camera channel; 0 for whole frames
+    uint64_t roi(uint8_t channel) const { return rois[channel].load(std::memory_order_relaxed); }
+
+    // Any thread. Applies the drop policy against frames not yet handed to the
+    // socket; handshake replies are never dropped.
+    void enqueue(std::shared_ptr<const RelayFrame> frame, bool reply = false) {
+        size_t bytes = frame->head.size() + frame->payloadSize;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed) return;
+
+        if (!reply && !pending.empty() && pendingBytes + bytes > maxQueuedBytes) {
+            switch (policy) {
+                case RelayDropPolicy::DropOldest:
+                    while (!pending.empty() && pendingBytes + bytes > maxQueuedBytes) {
+                        pendingBytes -= pending.front()->head.size() + pending.front()->payloadSize;
+                        pending.pop_front();
+                        ++dropped;
+                    }
+                    break;
+                case RelayDropPolicy::Disconnect:
+                    closed = true;
+                    pending.clear();
+                    pendingBytes = 0;
+                    boost::asio::post(socket.get_executor(), [self = shared_from_this()]() {
+                        self->fail("fell behind");
+                    });
+                    return;
+            }
+        }
+
+        pendingBytes += bytes;
+        pending.push_back(std::move(frame));
+        if (!writing) {
+            writing = true;
+            boost::asio::post(socket.get_executor(), [self = shared_from_this()]() { self->writeNext(); });
+        }
+    }
+
+private:
+    void read() {
+        if (padding > 0) {
+            skipPadding();
+            return;
+        }
+        auto span = parser.prepare();
+        boost::asio::async_read(socket, boost::asio::buffer(span.data, span.size),
+            [self = shared_from_this()](const error_code& error, std::size_t bytes) {
+                if (error) {
+                    self->fail(error == boost::asio::error::eof ? "closed" : error.message());
+                    return;
+                }
+                auto result = self->parser.commit(bytes);
+                if (result == ProtocolParser::Malformed) {
+                    self->fail(std::string("malformed request: ") + self->parser.error());
+                    return;
+                }
+                if (result == ProtocolParser::Complete) {
+                    self->onMessage();
+                }
+                self->read();
+            });
+    }
+
+    // The zeros after a short DATA_SEND_REQUEST are not part of any message
+    void skipPadding() {
+        boost::asio::async_read(socket, boost::asio::buffer(paddingBuffer, padding),
+            [self = shared_from_this()](const error_code& error, std::size_t) {
+                if (error) {
+                    self->fail(error == boost::asio::error::eof ? "closed" : error.message());
+                    return;
+                }
+                self->padding = 0;
+                self->read();
+            });
+    }
+
+    void onMessage() {
+        const auto& header = parser.header();
+        switch (header.messageType) {
+            case MessageType::LINK:
+                reply(MessageType::LINK_ACK);
+                break;
+            case MessageType::REC_INFO:
+                reply(MessageType::REC_INFO_ACK);
+                break;
+            case MessageType::DATA_SEND_REQUEST: {
+                size_t framed = sizeof(Protocol_Header) + header.bodyLength - 1;  // mResult is in the header
+                padding = framed < kDataRequestFrameBytes ? kDataRequestFrameBytes - framed : 0;
+                subscribe();
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // Acks carry the backend's clock as estimated here, so downstream clock sync
+    // maps relayed timestamps as if it talked to the backend directly
+    void reply(MessageType type) {
+        auto frame = std::make_shared<RelayFrame>();
+        frame->head = server.client.encodeHeader(type);
+        ClockMapping mapping = server.client.getClockSync(server.backendIndex).mapping();
+        if (mapping.valid) {
+            uint64_t backendMs = mapping.toBackendMs(Tracer::now());
+            memcpy(&frame->head[0], &backendMs, sizeof(backendMs));
+        }
+        frame->payloadSize = 0;
+        frame->dataType = 0;
+        frame->channel = 0;
+        enqueue(std::move(frame), true);
+    }
+
+    // Body of a DATA_SEND_REQUEST after mRequestStatus: mDataType, mSensorChannel, mServiceID,
+    // mNetworkID, then optionally a region count and the regions
+    void subscribe() {
+        if (parser.bodySize() < 1 + sizeof(uint32_t)) return;
+        uint8_t type = static_cast<uint8_t>(parser.body()[0]);
+        uint32_t mask;
+        memcpy(&mask, parser.body() + 1, sizeof(mask));
+
+        std::array<uint64_t, kChannels> requested{};
+        constexpr size_t kRoiOffset = 1 + sizeof(uint32_t) + 2;
+        size_t count = parser.bodySize() > kRoiOffset ? static_cast<uint8_t>(parser.body()[kRoiOffset]) : 0;
+        count = std::min(count, (parser.bodySize() - kRoiOffset - 1) / kChannelRoiWireBytes);
+        for (size_t i = 0; i < count; ++i) {
+            const char* entry = parser.body() + kRoiOffset + 1 + i * kChannelRoiWireBytes;
+            uint8_t channel = static_cast<uint8_t>(entry[0]);
+            uint16_t values[4];
+            memcpy(values, entry + 1, sizeof(values));
+            if (channel >= kChannels) continue;
+            // Cut on whole sample groups whatever the client sent
+            cv::Rect roi(values[0] & ~1, values[1] & ~1, values[2] & ~1, values[3] & ~1);
+            if (!roi.empty()) requested[channel] = packRoi(roi);
+        }
+        for (size_t channel = 0; channel < kChannels; ++channel) {
+            rois[channel].store(requested[channel], std::memory_order_relaxed);
+        }
+
+        bool bulk = type == eDataType::SENSOR;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            policy = bulk ? RelayDropPolicy::DropOldest : RelayDropPolicy::Disconnect;
+            maxQueuedBytes = bulk ? kBulkQueueBytes : kMessageQueueBytes;
+        }
+        bool first = dataType.load(std::memory_order_relaxed) == 0;
+        if (first) {
+            error_code ignored;
+            if (bulk) {
+                socket.set_option(boost::asio::socket_base::send_buffer_size(kBulkSendBuffer), ignored);
+            } else {
+                socket.set_option(tcp::no_delay(true), ignored);
+            }
+        }
+        dataType.store(type, std::memory_order_relaxed);
+        channelMask.store(mask, std::memory_order_relaxed);
+        server.updateSubscriptions();
+
+        std::cout << "[RELAY] " << peer << " requests type " << static_cast<int>(type)
+                  << " channels 0x" << std::hex << mask << std::dec;
+        if (count > 0) {
+            std::cout << ", " << count << " regions";
+        }
+        std::cout << std::endl;
+    }
+
+    void writeNext() {
+        inFlight.clear();
+        buffers.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!pending.empty() && inFlight.size() < kMaxGather) {
+                pendingBytes -= pending.front()->head.size() + pending.front()->payloadSize;
+                inFlight.push_back(std::move(pending.front()));
+                pending.pop_front();
+            }
+            if (inFlight.empty()) {
+                writing = false;
+                return;
+            }
+        }
+
+        // Header and payload of every frame go out in one gathered write, straight
+        // from the buffers the receive path filled
+        for (const auto& frame : inFlight) {
+            buffers.push_back(boost::asio::buffer(frame->head));
+            if (frame->payloadSize > 0) {
+                buffers.push_back(boost::asio::buffer(frame->payload.get(), frame->payloadSize));
+            }
+        }
+        boost::asio::async_write(socket, buffers,
+            [self = shared_from_this()](const error_code& error, std::size_t) {
+                if (error) {
+                    self->fail(error.message());
+                    return;
+                }
+                self->writeNext();
+            });
+    }
+
+    void fail(const std::string& reason) {
+        if (failed) return;
+        failed = true;
+        uint64_t droppedFrames;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            pending.clear();
+            pendingBytes = 0;
+            droppedFrames = dropped;
+        }
+        inFlight.clear();
+        buffers.clear();
+        error_code ignored;
+        socket.close(ignored);
+        std::cout << "[RELAY] " << peer << " disconnected (" << reason << "), "
+                  << droppedFrames << " frames dropped" << std::endl;
+        server.remove(this);
+    }
+
+    RelayServer& server;
+    tcp::socket socket;  // its executor is the client's strand
+    ProtocolParser parser;
+    size_t padding = 0;  // bytes to drop before the next header
+    char paddingBuffer[kDataRequestFrameBytes];
+    std::string peer;
+
+    std::atomic<uint8_t> dataType{0};
+    std::atomic<uint32_t> channelMask{0};
+    std::array<std::atomic<uint64_t>, kChannels> rois{};
+
+    // Shared with publishing threads
+    std::mutex mutex;
+    std::deque<std::shared_ptr<const RelayFrame>> pending;
+    size_t pendingBytes = 0;
+    size_t maxQueuedBytes = kMessageQueueBytes;
+    RelayDropPolicy policy = RelayDropPolicy::Disconnect;
+    uint64_t dropped = 0;
+    bool writing = false;
+    bool closed = false;
+
+    // Strand only
+    std::vector<std::shared_ptr<const RelayFrame>> inFlight;
+    std::vector<boost::asio::const_buffer> buffers;
+    bool failed = false;
+};
+
+RelayServer::RelayServer(TcpClient& client, size_t backendIndex, uint16_t port, boost::asio::io_context& io) :
+    client(client), backendIndex(backendIndex), port(port), io(io), acceptor(boost::asio::make_strand(io)) {
+}
+
+RelayServer::~RelayServer() = default;
+
+void RelayServer::start() {
+    error_code error;
+    tcp::endpoint endpoint(tcp::v4(), port);
+    acceptor.open(endpoint.protocol(), error);
+    if (!error) acceptor.set_option(tcp::acceptor::reuse_address(true), error);
+    if (!error) acceptor.bind(endpoint, error);
+    if (!error) acceptor.listen(boost::asio::socket_base::max_listen_connections, error);
+    if (error) {
+        std::cerr << "[RELAY] cannot listen on port " << port << ": " << error.message() << std::endl;
+        return;
+    }
+    std::cout << "[RELAY] relaying backend " << backendIndex + 1 << " on port " << port << std::endl;
+    boost::asio::post(acceptor.get_executor(), [this]() { accept(); });
+}
+
+void RelayServer::stop() {
+    boost::asio::post(acceptor.get_executor(), [this]() {
+        error_code ignored;
+        acceptor.close(ignored);
+    });
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& relayClient : clients) {
+        relayClient->close();
+    }
+    clients.clear();
+    for (auto& mask : subscribed) {
+        mask.store(0, std::memory_order_relaxed);
+    }
+}
+
+void RelayServer::accept() {
+    // Each client gets its own strand, so a slow socket never holds up another
+    acceptor.async_accept(boost::asio::make_strand(io), [this](const error_code& error, tcp::socket socket) {
+        if (error == boost::asio::error::operation_aborted || !acceptor.is_open()) return;
+        if (!error) {
+            auto relayClient = std::make_shared<Client>(*this, std::move(socket));
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                clients.push_back(relayClient);
+            }
+            relayClient->start();
+        }
+        accept();
+    });
+}
+
+void RelayServer::publish(const ProtocolParser& parser, uint8_t dataType, std::shared_ptr<const char[]> payload) {
+    auto frame = std::make_shared<RelayFrame>();
+    frame->head.reserve(sizeof(Protocol_Header) + parser.bodySize());
+    frame->head.append(reinterpret_cast<const char*>(&parser.header()), sizeof(Protocol_Header));
+    frame->head.append(parser.body(), parser.bodySize());
+    frame->payload = std::move(payload);
+    frame->payloadSize = parser.sensorMessage().mPayloadSize;
+    frame->dataType = dataType;
+    frame->channel = parser.sensorMessage().mChannel;
+
+    const stDataSensorReqMsg& sensor = parser.sensorMessage();
+    bool camera = dataType == eDataType::SENSOR && sensor.mSensorType == 1;
+    // Clients watching the same region share one cut of the frame
+    std::array<std::pair<uint64_t, std::shared_ptr<const RelayFrame>>, 4> crops;
+    size_t cropCount = 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& relayClient : clients) {
+        if (!relayClient->subscribedTo(dataType, frame->channel)) continue;
+        uint64_t roi = camera ? relayClient->roi(frame->channel) : 0;
+        if (roi == 0) {
+            relayClient->enqueue(frame);
+            continue;
+        }
+        std::shared_ptr<const RelayFrame> cut;
+        bool found = false;
+        for (size_t i = 0; i < cropCount && !found; ++i) {
+            if (crops[i].first == roi) {
+                cut = crops[i].second;
+                found = true;
+            }
+        }
+        if (!found) {
+            cut = crop(*frame, sensor, roi);
+            if (cropCount < crops.size()) crops[cropCount++] = {roi, cut};
+        }
+        relayClient->enqueue(cut ? cut : frame);
+    }
+}
+
+std::shared_ptr<const RelayFrame> RelayServer::crop(const RelayFrame& frame, const stDataSensorReqMsg& sensor, uint64_t roi) {
+    if (sensor.mTotalNumber > 1 || !frame.payload) return nullptr;
+    // The frame may already be a region, when this instance streams one itself
+    cv::Rect covered(isRoiFrame(sensor) ? roiOriginX(sensor) : 0, isRoiFrame(sensor) ? roiOriginY(sensor) : 0,
+        sensor.mImgWidth, sensor.mImgHeight);
+    cv::Rect region = unpackRoi(roi) & covered;
+    region.width &= ~1;
+    region.height &= ~1;
+    if (region.empty() || region == covered) return nullptr;
+
+    size_t bytes = expectedPayloadSize(sensor.mImgFormat, sensor.mImgDepth, region.width, region.height);
+    if (bytes == 0) return nullptr;
+    FramePool::Buffer buffer = cropPool.acquire(sensor.mChannel, bytes);
+    if (!buffer) return nullptr;  // over budget: the client gets the whole frame
+    TraceSpan span("roi_crop");
+    cropPayload(sensor.mImgFormat, sensor.mImgDepth, reinterpret_cast<const uint8_t*>(frame.payload.get()),
+        sensor.mImgWidth, sensor.mImgHeight, region - covered.tl(), reinterpret_cast<uint8_t*>(buffer.get()));
+
+    auto cut = std::make_shared<RelayFrame>(frame);
+    stDataSensorReqMsg cutSensor = sensor;
+    cutSensor.mImgWidth = static_cast<uint16_t>(region.width);
+    cutSensor.mImgHeight = static_cast<uint16_t>(region.height);
+    cutSensor.mNumPoints = encodeRoiOrigin(static_cast<uint16_t>(region.x), static_cast<uint16_t>(region.y));
+    cutSensor.mPayloadSize = static_cast<uint32_t>(bytes);
+    // The sensor message starts at mResult, the header's last byte
+    memcpy(&cut->head[sizeof(Protocol_Header) - 1], &cutSensor, sizeof(cutSensor));
+    cut->payload = std::shared_ptr<const char[]>(std::move(buffer));
+    cut->payloadSize = bytes;
+    return cut;
+}
+
+size_t RelayServer::clientCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return clients.size();
+}
+
+void RelayServer::remove(const Client* relayClient) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.erase(std::remove_if(clients.begin(), clients.end(),
+            [relayClient](const auto& c) { return c.get() == relayClient; }), clients.end());
+    }
+    updateSubscriptions();
+}
+
+void RelayServer::updateSubscriptions() {
+    std::array<uint32_t, eDataType::MAX_DATA_TYPE> masks{};
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& relayClient : clients) {
+        uint8_t type = relayClient->subscribedType();
+        if (type < masks.size()) {
+            masks[type] |= relayClient->subscribedMask();
+        }
+    }
+    for (size_t i = 0; i < masks.size(); ++i) {
+        subscribed[i].store(masks[i], std::memory_order_relaxed);
+    }
+}
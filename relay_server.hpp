@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include "messages.hpp"
+#include "frame_pool.hpp"
+#include "protocol_parser.hpp"
+
+class TcpClient;
+
+// One received DATA_SENSOR message, shared by every relay client it goes to.
+// The payload is the reassembly buffer itself; it returns to its pool once the
+// last client has written it.
+struct RelayFrame {
+    std::string head;  // Protocol_Header and sensor message, as received
+    std::shared_ptr<const char[]> payload;
+    size_t payloadSize;
+    uint8_t dataType;
+    uint8_t channel;
+};
+
+// What a client does when it falls behind. Camera streams drop their oldest
+// queued frames so a slow viewer stays live; small streams cannot lose
+// messages silently, so the client is disconnected and resyncs on reconnect.
+enum class RelayDropPolicy : uint8_t {
+    DropOldest,
+    Disconnect,
+};
+
+// Re-serves one backend's data streams to downstream control_app instances.
+// Clients connect to the relay's data port as if it were the backend, run the
+// usual LINK -> REC_INFO -> DATA_SEND_REQUEST handshake, and receive the
+// DATA_SENSOR messages of the requested data type and channel mask. Camera
+// channels a client asks for with a stChannelRoi are cut to that region here,
+// once per distinct region, so the relay doubles as a stand-in for ROI-capable
+// backends. Commands are not relayed; downstream viewers run without a control port.
+class RelayServer {
+public:
+    RelayServer(TcpClient& client, size_t backendIndex, uint16_t port, boost::asio::io_context& io);
+    ~RelayServer();
+
+    void start();
+    void stop();
+
+    // One atomic load; lets the receive path skip sharing the payload when nobody listens
+    bool wants(uint8_t dataType, uint8_t channel) const {
+        return dataType < eDataType::MAX_DATA_TYPE &&
+               (subscribed[dataType].load(std::memory_order_relaxed) >> channel & 1u);
+    }
+    void publish(const ProtocolParser& parser, uint8_t dataType, std::shared_ptr<const char[]> payload);
+
+    size_t clientCount() const;
+
+private:
+    class Client;
+    friend class Client;
+
+    void accept();
+    void remove(const Client* client);
+    void updateSubscriptions();
+    // Region roi of a camera frame as a message of its own; nullptr to send the frame whole
+    std::shared_ptr<const RelayFrame> crop(const RelayFrame& frame, const stDataSensorReqMsg& sensor, uint64_t roi);
+
+    TcpClient& client;
+    size_t backendIndex;
+    uint16_t port;
+    boost::asio::io_context& io;
+    boost::asio::ip::tcp::acceptor acceptor;
+
+    FramePool requestPool{"relay", 1u << 20};
+    FramePool cropPool{"relay-roi", 32u << 20};
+    ReceiveStats requestStats;
+
+    mutable std::mutex mutex;
+    std::vector<std::shared_ptr<Client>> clients;
+    std::array<std::atomic<uint32_t>, eDataType::MAX_DATA_TYPE> subscribed{};
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "messages.hpp"
+
+enum class SensorKind : uint8_t {
+    Camera,
+    Lidar,
+    Webcam,
+};
+
+// Viewer tiles; each camera prefers the tile for the side of the vehicle it
+// looks at, and ControlApp moves it to a free one when another camera has that
+namespace sensor_tile {
+    constexpr uint8_t kFront = 0;
+    constexpr uint8_t kLeft = 1;
+    constexpr uint8_t kRight = 2;
+    constexpr uint8_t kRear = 3;
+    constexpr uint8_t kLidar = 4;  // merged bird's-eye view
+    constexpr uint8_t kCount = 5;
+}
+
+// What a channel carries when the backend runs its default configuration.
+// Image channels give their frame size and pixel format; LiDAR channels give
+// beams x points per beam for one sweep.
+struct SensorChannelInfo {
+    eSensorChannel channel;
+    SensorKind kind;
+    const char* name;
+    uint16_t width;
+    uint16_t height;
+    ePixelFormat format;
+    uint8_t depth;       // bits per sample
+    uint8_t tile;
+    uint8_t poolFrames;  // decode buffers set aside at startup when subscribed
+
+    constexpr bool isImage() const { return kind != SensorKind::Lidar; }
+    constexpr uint32_t mask() const { return 1u << static_cast<uint32_t>(channel); }
+    constexpr size_t lidarPayloadBytes() const { return size_t{width} * height * sizeof(stLidarPoint); }
+};
+
+namespace sensor_channels {
+    using C = eSensorChannel;
+    using K = SensorKind;
+    using F = ePixelFormat;
+    namespace t = sensor_tile;
+
+    constexpr size_t kCount = static_cast<size_t>(eSensorChannel::CHANNEL_MAX);
+    static_assert(kCount <= 32, "channel masks are 32 bits wide");
+
+    constexpr std::array<SensorChannelInfo, kCount> kTable{{
+        {C::CAMERA_FRONT,            K::Camera, "camera front",            1920, 1080, F::UYVY, 8,  t::kFront, 4},
+        {C::CAMERA_FRONT_SIDE_LEFT,  K::Camera, "camera front side left",  1920, 1080, F::UYVY, 8,  t::kLeft,  4},
+        {C::CAMERA_FRONT_SIDE_RIGHT, K::Camera, "camera front side right", 1920, 1080, F::UYVY, 8,  t::kRight, 4},
+        {C::CAMERA_FRONT_TELE,       K::Camera, "camera front tele",       1920, 1080, F::UYVY, 8,  t::kFront, 4},
+        {C::CAMERA_REAR,             K::Camera, "camera rear",             1920, 1080, F::UYVY, 8,  t::kRear,  4},
+        {C::CAMERA_REAR_SIDE_LEFT,   K::Camera, "camera rear side left",   1920, 1080, F::UYVY, 8,  t::kLeft,  4},
+        {C::CAMERA_REAR_SIDE_RIGHT,  K::Camera, "camera rear side right",  1920, 1080, F::UYVY, 8,  t::kRight, 4},
+        {C::CAMERA_SR_FRONT,         K::Camera, "surround front",          1280, 960,  F::BAYER_RGGB, 12, t::kFront, 2},
+        {C::CAMERA_SR_LEFT,          K::Camera, "surround left",           1280, 960,  F::BAYER_RGGB, 12, t::kLeft,  2},
+        {C::CAMERA_SR_RIGHT,         K::Camera, "surround right",          1280, 960,  F::BAYER_RGGB, 12, t::kRight, 2},
+        {C::CAMERA_SR_REAR,          K::Camera, "surround rear",           1280, 960,  F::BAYER_RGGB, 12, t::kRear,  2},
+        {C::LIDAR_FRONT_CENTER,      K::Lidar,  "lidar front center",      128, 1024, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_FRONT_LEFT,        K::Lidar,  "lidar front left",        32,  1024, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_FRONT_RIGHT,       K::Lidar,  "lidar front right",       32,  1024, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_REAR_CENTER,       K::Lidar,  "lidar rear center",       64,  1024, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_REAR_LEFT,         K::Lidar,  "lidar rear left",         32,  1024, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_REAR_RIGHT,        K::Lidar,  "lidar rear right",        32,  1024, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_SIDE_LEFT,         K::Lidar,  "lidar side left",         32,  1024, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_SIDE_RIGHT,        K::Lidar,  "lidar side right",        32,  1024, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_ROOF_CENTER,       K::Lidar,  "lidar roof center",       128, 2048, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_ROOF_FRONT,        K::Lidar,  "lidar roof front",        64,  1024, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_ROOF_LEFT,         K::Lidar,  "lidar roof left",         64,  1024, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_ROOF_RIGHT,        K::Lidar,  "lidar roof right",        64,  1024, F::GRAY, 8, t::kLidar, 2},
+        {C::LIDAR_ROOF_REAR,         K::Lidar,  "lidar roof rear",         64,  1024, F::GRAY, 8, t::kLidar, 2},
+        {C::WEBCAM_FRONT,            K::Webcam, "webcam front",            1280, 720,  F::YUYV, 8,  t::kFront, 2},
+        {C::WEBCAM_FRONT_SIDE_LEFT,  K::Webcam, "webcam front side left",  1280, 720,  F::YUYV, 8,  t::kLeft,  2},
+        {C::WEBCAM_FRONT_SIDE_RIGHT, K::Webcam, "webcam front side right", 1280, 720,  F::YUYV, 8,  t::kRight, 2},
+        {C::WEBCAM_REAR,             K::Webcam, "webcam rear",             1280, 720,  F::YUYV, 8,  t::kRear,  2},
+        {C::WEBCAM_REAR_SIDE_LEFT,   K::Webcam, "webcam rear side left",   1280, 720,  F::YUYV, 8,  t::kLeft,  2},
+        {C::WEBCAM_REAR_SIDE_RIGHT,  K::Webcam, "webcam rear side right",  1280, 720,  F::YUYV, 8,  t::kRight, 2},
+        {C::WEBCAM_SIDE_LEFT,        K::Webcam, "webcam side left",        1280, 720,  F::YUYV, 8,  t::kLeft,  2},
+        {C::WEBCAM_SIDE_RIGHT,       K::Webcam, "webcam side right",       1280, 720,  F::YUYV, 8,  t::kRight, 2},
+    }};
+
+    constexpr bool indexedByChannel() {
+        for (size_t i = 0; i < kCount; ++i) {
+            if (static_cast<size_t>(kTable[i].channel) != i || kTable[i].tile >= sensor_tile::kCount) return false;
+            if ((kTable[i].kind == SensorKind::Lidar) != (kTable[i].tile == sensor_tile::kLidar)) return false;
+        }
+        return true;
+    }
+    static_assert(indexedByChannel(), "kTable must list every eSensorChannel in order, LiDARs on the LiDAR tile");
+
+    constexpr uint32_t kAllMask = kCount == 32 ? ~0u : (1u << kCount) - 1;
+
+    // Out-of-range channels fall back to the first entry; callers validate first
+    constexpr const SensorChannelInfo& info(uint8_t channel) {
+        return kTable[channel < kCount ? channel : 0];
+    }
+
+    // Subscription mask checked when it is built
+    template <eSensorChannel... Channels>
+    constexpr uint32_t mask() {
+        static_assert(((static_cast<size_t>(Channels) < kCount) && ...), "channel out of range");
+        return (0u | ... | kTable[static_cast<size_t>(Channels)].mask());
+    }
+}
@@ -0,0 +1,362 @@
+#include "session_file.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#ifdef CONTROL_APP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+    constexpr size_t kMaxQueuedBytes = 64u << 20;  // held out of the reassembly pool's budget
+#ifdef CONTROL_APP_HAVE_ZSTD
+    constexpr int kCompressionLevel = 1;  // raw video needs speed far more than ratio
+#endif
+
+    std::string channelName(uint8_t channel) {
+        char name[16];
+        std::snprintf(name, sizeof(name), "channel_%02u", static_cast<unsigned>(channel));
+        return name;
+    }
+}
+
+std::string session::dataPath(const std::string& directory, uint8_t channel) {
+    return (fs::path(directory) / (channelName(channel) + ".vrec")).string();
+}
+
+std::string session::indexPath(const std::string& directory, uint8_t channel) {
+    return (fs::path(directory) / (channelName(channel) + ".vidx")).string();
+}
+
+std::vector<uint8_t> session::recordedChannels(const std::string& directory) {
+    std::vector<uint8_t> channels;
+    std::error_code error;
+    for (uint8_t channel = 0; channel < static_cast<uint8_t>(eSensorChannel::CHANNEL_MAX); ++channel) {
+        if (fs::file_size(dataPath(directory, channel), error) > 0 && !error) {
+            channels.push_back(channel);
+        }
+        error.clear();
+    }
+    return channels;
+}
+
+bool session::validRecord(const SessionRecordHeader& header) {
+    return header.magic == kRecordMagic || header.magic == kCompressedMagic;
+}
+
+size_t session::storedBytes(const SessionRecordHeader& header) {
+    return header.magic == kCompressedMagic ? header.storedSize : header.sensor.mPayloadSize;
+}
+
+bool session::parseBlocks(const char* body, size_t size, uint32_t payloadSize, std::vector<Block>& blocks) {
+    blocks.clear();
+    uint32_t count;
+    if (size < sizeof(count)) return false;
+    std::memcpy(&count, body, sizeof(count));
+    size_t tableBytes = sizeof(count) + static_cast<size_t>(count) * sizeof(SessionBlockEntry);
+    if (tableBytes > size) return false;
+
+    size_t stored = tableBytes;
+    size_t raw = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        SessionBlockEntry entry;
+        std::memcpy(&entry, body + sizeof(count) + i * sizeof(entry), sizeof(entry));
+        if (entry.storedSize > size - stored || entry.rawSize > payloadSize - raw) return false;
+        blocks.push_back(Block{body + stored, entry.storedSize, entry.rawSize, raw});
+        stored += entry.storedSize;
+        raw += entry.rawSize;
+    }
+    return raw == payloadSize;
+}
+
+bool session::decodeBlock(const Block& block, uint8_t* payload) {
+    if (block.storedSize == block.rawSize) {
+        std::memcpy(payload + block.rawOffset, block.data, block.rawSize);
+        return true;
+    }
+#ifdef CONTROL_APP_HAVE_ZSTD
+    struct Context {
+        ZSTD_DCtx* dctx = ZSTD_createDCtx();
+        ~Context() { ZSTD_freeDCtx(dctx); }
+    };
+    thread_local Context context;
+    size_t decoded = ZSTD_decompressDCtx(context.dctx, payload + block.rawOffset, block.rawSize,
+        block.data, block.storedSize);
+    return !ZSTD_isError(decoded) && decoded == block.rawSize;
+#else
+    return false;  // recorded by a build with zstd
+#endif
+}
+
+bool session::decodePayload(const SessionRecordHeader& header, const char* body, uint8_t* payload) {
+    if (header.magic == kRecordMagic) {
+        std::memcpy(payload, body, header.sensor.mPayloadSize);
+        return true;
+    }
+    thread_local std::vector<Block> blocks;
+    if (!parseBlocks(body, header.storedSize, header.sensor.mPayloadSize, blocks)) return false;
+    for (const Block& block : blocks) {
+        if (!decodeBlock(block, payload)) return false;
+    }
+    return true;
+}
+
+// Workers take blocks of the current batch until none are left; the writer
+// waits for the whole batch, so records still go out in arrival order.
+class SessionRecorder::Compressor {
+public:
+    explicit Compressor(size_t threadCount) {
+        for (size_t i = 0; i < threadCount; ++i) {
+            threads.emplace_back([this]() { work(); });
+        }
+    }
+
+    ~Compressor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    size_t size() const { return threads.size(); }
+
+    void run(std::vector<BlockJob>& batch) {
+        if (batch.empty()) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        jobs = &batch;
+        next = 0;
+        remaining = batch.size();
+        wake.notify_all();
+        finished.wait(lock, [this]() { return remaining == 0; });
+        jobs = nullptr;
+    }
+
+private:
+    void work() {
+#ifdef CONTROL_APP_HAVE_ZSTD
+        ZSTD_CCtx* cctx = ZSTD_createCCtx();
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, kCompressionLevel);
+#endif
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this]() { return stopping || (jobs && next < jobs->size()); });
+            if (stopping) break;
+            BlockJob& job = (*jobs)[next++];
+            lock.unlock();
+
+            bool packed = false;
+#ifdef CONTROL_APP_HAVE_ZSTD
+            job.out->resize(ZSTD_compressBound(job.size));
+            size_t size = ZSTD_compress2(cctx, job.out->data(), job.out->size(), job.src, job.size);
+            if (!ZSTD_isError(size) && size < job.size) {
+                job.out->resize(size);
+                packed = true;
+            }
+#endif
+            if (!packed) {
+                job.out->assign(job.src, job.src + job.size);  // incompressible: stored raw
+            }
+
+            lock.lock();
+            if (--remaining == 0) {
+                finished.notify_one();
+            }
+        }
+#ifdef CONTROL_APP_HAVE_ZSTD
+        ZSTD_freeCCtx(cctx);
+#endif
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::vector<BlockJob>* jobs = nullptr;
+    size_t next = 0;
+    size_t remaining = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+};
+
+SessionRecorder::SessionRecorder(const std::string& directory) :
+    dir(directory), files(static_cast<size_t>(eSensorChannel::CHANNEL_MAX)) {
+    std::error_code error;
+    fs::create_directories(dir, error);
+    if (error) {
+        std::cerr << "[RECORD] cannot create " << dir << ": " << error.message() << std::endl;
+        return;
+    }
+    opened = true;
+#ifdef CONTROL_APP_HAVE_ZSTD
+    // Leave cores for receive and decode; compression keeps up long before that
+    compressor = std::make_unique<Compressor>(std::max(1u, std::thread::hardware_concurrency() / 2));
+#endif
+    writer = std::thread([this]() { run(); });
+    std::cout << "[RECORD] recording to " << dir;
+    if (compressor) {
+        std::cout << " (zstd, " << compressor->size() << " threads)";
+    }
+    std::cout << std::endl;
+}
+
+SessionRecorder::~SessionRecorder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    compressor.reset();
+    for (auto& channel : files) {
+        if (channel.data) std::fclose(channel.data);
+        if (channel.index) std::fclose(channel.index);
+    }
+    if (opened) {
+        std::cout << "[RECORD] " << recorded.load() << " frames, " << (bytes.load() >> 20) << " MiB ("
+                  << (rawBytes.load() >> 20) << " MiB received), " << dropped.load() << " dropped" << std::endl;
+    }
+}
+
+void SessionRecorder::record(const stDataSensorReqMsg& sensor, std::shared_ptr<const char[]> payload) {
+    if (!opened || sensor.mChannel >= files.size()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) return;
+        if (queuedBytes + sensor.mPayloadSize > kMaxQueuedBytes) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        queuedBytes += sensor.mPayloadSize;
+        queue.push_back(Pending{sensor, std::move(payload)});
+    }
+    wake.notify_one();
+}
+
+void SessionRecorder::run() {
+    std::deque<Pending> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;  // stopping, and everything queued has been written
+            }
+            batch.swap(queue);
+        }
+
+        if (compressor) {
+            size_t blocks = 0;
+            for (const auto& frame : batch) {
+                blocks += (frame.sensor.mPayloadSize + session::kBlockBytes - 1) / session::kBlockBytes;
+            }
+            // Grown before any job points into it
+            if (blockBuffers.size() < blocks) blockBuffers.resize(blocks);
+            jobs.clear();
+            for (const auto& frame : batch) {
+                for (size_t offset = 0; offset < frame.sensor.mPayloadSize; offset += session::kBlockBytes) {
+                    jobs.push_back(BlockJob{frame.payload.get() + offset,
+                        std::min<size_t>(session::kBlockBytes, frame.sensor.mPayloadSize - offset),
+                        &blockBuffers[jobs.size()]});
+                }
+            }
+            compressor->run(jobs);
+        }
+
+        size_t written = 0;
+        size_t block = 0;
+        for (const auto& frame : batch) {
+            size_t count = (frame.sensor.mPayloadSize + session::kBlockBytes - 1) / session::kBlockBytes;
+            bool ok = compressor ? writeCompressed(frame, jobs.data() + block, count) : write(frame);
+            block += count;
+            if (ok) {
+                recorded.fetch_add(1, std::memory_order_relaxed);
+                rawBytes.fetch_add(frame.sensor.mPayloadSize, std::memory_order_relaxed);
+            } else {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            written += frame.sensor.mPayloadSize;
+        }
+        // Payloads go back to their pool before the next batch
+        batch.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        queuedBytes -= written;
+    }
+}
+
+bool SessionRecorder::openFiles(uint8_t channel) {
+    ChannelFiles& out = files[channel];
+    if (!out.data) {
+        out.data = std::fopen(session::dataPath(dir, channel).c_str(), "wb");
+        out.index = std::fopen(session::indexPath(dir, channel).c_str(), "wb");
+        if (!out.data || !out.index) {
+            std::cerr << "[RECORD] cannot open files for channel " << static_cast<int>(channel) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SessionRecorder::write(const Pending& frame) {
+    uint8_t channel = frame.sensor.mChannel;
+    if (!openFiles(channel)) return false;
+    ChannelFiles& out = files[channel];
+
+    SessionRecordHeader header{};
+    header.magic = session::kRecordMagic;
+    header.sensor = frame.sensor;
+    SessionIndexEntry entry{frame.sensor.mTimestamp, out.offset, frame.sensor.mFrameNumber, frame.sensor.mPayloadSize};
+    if (std::fwrite(&header, sizeof(header), 1, out.data) != 1 ||
+        std::fwrite(frame.payload.get(), 1, frame.sensor.mPayloadSize, out.data) != frame.sensor.mPayloadSize) {
+        return false;
+    }
+    // The index only lists records that are completely in the data file
+    std::fwrite(&entry, sizeof(entry), 1, out.index);
+    out.offset += sizeof(header) + frame.sensor.mPayloadSize;
+    bytes.fetch_add(sizeof(header) + frame.sensor.mPayloadSize, std::memory_order_relaxed);
+    return true;
+}
+
+bool SessionRecorder::writeCompressed(const Pending& frame, const BlockJob* blocks, size_t count) {
+    uint8_t channel = frame.sensor.mChannel;
+    if (!openFiles(channel)) return false;
+    ChannelFiles& out = files[channel];
+
+    // Block table straight after the header, so a reader can hand blocks to
+    // decoders as soon as the body is mapped
+    uint32_t blockCount = static_cast<uint32_t>(count);
+    size_t stored = sizeof(blockCount) + count * sizeof(SessionBlockEntry);
+    for (size_t i = 0; i < count; ++i) {
+        stored += blocks[i].out->size();
+    }
+
+    SessionRecordHeader header{};
+    header.magic = session::kCompressedMagic;
+    header.storedSize = static_cast<uint32_t>(stored);
+    header.sensor = frame.sensor;
+    if (std::fwrite(&header, sizeof(header), 1, out.data) != 1 ||
+        std::fwrite(&blockCount, sizeof(blockCount), 1, out.data) != 1) {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        SessionBlockEntry entry{static_cast<uint32_t>(blocks[i].size), static_cast<uint32_t>(blocks[i].out->size())};
+        if (std::fwrite(&entry, sizeof(entry), 1, out.data) != 1) return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (std::fwrite(blocks[i].out->data(), 1, blocks[i].out->size(), out.data) != blocks[i].out->size()) {
+            return false;
+        }
+    }
+
+    SessionIndexEntry entry{frame.sensor.mTimestamp, out.offset, frame.sensor.mFrameNumber, frame.sensor.mPayloadSize};
+    std::fwrite(&entry, sizeof(entry), 1, out.index);
+    out.offset += sizeof(header) + stored;
+    bytes.fetch_add(sizeof(header) + stored, std::memory_order_relaxed);
+    return true;
+}
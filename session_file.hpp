@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "messages.hpp"
+
+// A recorded session is a directory with two files per sensor channel:
+//   channel_NN.vrec  records: SessionRecordHeader, then the stored payload
+//   channel_NN.vidx  one SessionIndexEntry per record, in arrival order
+// A kRecordMagic record stores mPayloadSize bytes as received. A
+// kCompressedMagic record stores storedSize bytes: a uint32 block count, one
+// SessionBlockEntry per block, then the blocks, each zstd-compressed on its own
+// (or kept raw when that is not smaller). Decoded payloads are exactly what was
+// received, so playback and export run them through the live pixel kernels.
+struct SessionRecordHeader {
+    uint32_t magic;
+    uint32_t storedSize;  // compressed records only; 0 in raw ones
+    stDataSensorReqMsg sensor;
+};
+
+struct SessionBlockEntry {
+    uint32_t rawSize;
+    uint32_t storedSize;  // equal to rawSize for a block stored raw
+};
+
+struct SessionIndexEntry {
+    uint64_t timestamp;  // sensor.mTimestamp, backend ms
+    uint64_t offset;     // of the SessionRecordHeader in the .vrec file
+    uint32_t frameNumber;
+    uint32_t payloadSize;
+};
+
+namespace session {
+    constexpr uint32_t kRecordMagic = 0x43455256;      // "VREC"
+    constexpr uint32_t kCompressedMagic = 0x5A434556;  // "VECZ"
+    constexpr size_t kBlockBytes = 1u << 20;  // payload bytes per compressed block
+
+    std::string dataPath(const std::string& directory, uint8_t channel);
+    std::string indexPath(const std::string& directory, uint8_t channel);
+    // Channels that have a data file, in ascending order
+    std::vector<uint8_t> recordedChannels(const std::string& directory);
+
+    bool validRecord(const SessionRecordHeader& header);
+    // Bytes after the header; what a reader skips to reach the next record
+    size_t storedBytes(const SessionRecordHeader& header);
+
+    // One block of a compressed record body, located in the mapped or read body
+    struct Block {
+        const char* data;
+        uint32_t storedSize;
+        uint32_t rawSize;
+        size_t rawOffset;  // where it decodes to within the payload
+    };
+    // Splits a compressed body into its blocks; false if the table is inconsistent
+    bool parseBlocks(const char* body, size_t size, uint32_t payloadSize, std::vector<Block>& blocks);
+    // Any thread; each thread keeps its own decompression context
+    bool decodeBlock(const Block& block, uint8_t* payload);
+    // Whole payload of a record body, raw or compressed, blocks in order
+    bool decodePayload(const SessionRecordHeader& header, const char* body, uint8_t* payload);
+}
+
+// Appends camera frames to a session directory on a writer thread. The
+// receive path only queues a reference to the reassembly buffer; when the
+// disk falls behind, frames are dropped rather than holding more memory.
+// With zstd available, each queued batch is cut into kBlockBytes blocks that
+// a pool of workers compresses in parallel, each with its own reused context;
+// the writer then appends the records in arrival order.
+class SessionRecorder {
+public:
+    explicit SessionRecorder(const std::string& directory);
+    ~SessionRecorder();
+
+    bool ok() const { return opened; }
+    const std::string& directory() const { return dir; }
+
+    // Any thread; never blocks on the disk
+    void record(const stDataSensorReqMsg& sensor, std::shared_ptr<const char[]> payload);
+
+    uint64_t recordedFrames() const { return recorded.load(std::memory_order_relaxed); }
+    uint64_t droppedFrames() const { return dropped.load(std::memory_order_relaxed); }
+    uint64_t recordedBytes() const { return bytes.load(std::memory_order_relaxed); }  // on disk
+    uint64_t payloadBytes() const { return rawBytes.load(std::memory_order_relaxed); }  // as received
+    bool compressing() const { return compressor != nullptr; }
+
+private:
+    struct Pending {
+        stDataSensorReqMsg sensor;
+        std::shared_ptr<const char[]> payload;
+    };
+
+    struct ChannelFiles {
+        FILE* data = nullptr;
+        FILE* index = nullptr;
+        uint64_t offset = 0;
+    };
+
+    class Compressor;
+    struct BlockJob {
+        const char* src;
+        size_t size;
+        std::vector<char>* out;
+    };
+
+    void run();
+    bool openFiles(uint8_t channel);
+    bool write(const Pending& frame);
+    bool writeCompressed(const Pending& frame, const BlockJob* blocks, size_t count);
+
+    std::string dir;
+    bool opened = false;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Pending> queue;
+    size_t queuedBytes = 0;
+    bool stopping = false;
+
+    std::vector<ChannelFiles> files;  // writer thread only
+    std::unique_ptr<Compressor> compressor;
+    std::vector<BlockJob> jobs;                     // writer thread only
+    std::vector<std::vector<char>> blockBuffers;    // reused across batches
+    std::atomic<uint64_t> recorded{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> rawBytes{0};
+    std::thread writer;
+};
@@ -0,0 +1,287 @@
+#include "session_playback.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <opencv2/opencv.hpp>
+
+namespace {
+    constexpr auto kTick = std::chrono::milliseconds(16);
+    constexpr size_t kLookahead = 8;  // frames per channel requested ahead of the playhead
+    constexpr double kMinSpeed = 1.0 / 16;
+    constexpr double kMaxSpeed = 16.0;
+    const size_t kPageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+bool SessionPlayback::MappedFile::map(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+    data = static_cast<const char*>(mapped);
+    size = st.st_size;
+    return true;
+}
+
+SessionPlayback::MappedFile::~MappedFile() {
+    if (data) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+SessionPlayback::SessionPlayback(const std::string& directory) {
+    for (uint8_t id : session::recordedChannels(directory)) {
+        auto channel = std::make_unique<Channel>();
+        channel->id = id;
+        if (!channel->data.map(session::dataPath(directory, id)) ||
+            !channel->index.map(session::indexPath(directory, id))) {
+            std::cerr << "[PLAYBACK] skipping channel " << static_cast<int>(id) << ": cannot map files" << std::endl;
+            continue;
+        }
+        channel->entries = reinterpret_cast<const SessionIndexEntry*>(channel->index.data);
+        channel->count = channel->index.size / sizeof(SessionIndexEntry);
+        if (channel->count == 0) continue;
+
+        // Frames are read where the playhead is, not in file order; only the
+        // lookahead below should pull pages in
+        madvise(const_cast<char*>(channel->data.data), channel->data.size, MADV_RANDOM);
+
+        uint64_t first = channel->entries[0].timestamp;
+        uint64_t last = channel->entries[channel->count - 1].timestamp;
+        firstMs = channels.empty() ? first : std::min(firstMs, first);
+        lastMs = channels.empty() ? last : std::max(lastMs, last);
+        channels.push_back(std::move(channel));
+    }
+    positionMs = firstMs;
+    if (!channels.empty()) {
+        std::cout << "[PLAYBACK] " << channels.size() << " channels, "
+                  << (lastMs - firstMs) / 1000.0 << " s from " << directory << std::endl;
+    }
+}
+
+SessionPlayback::~SessionPlayback() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+uint32_t SessionPlayback::channelMask() const {
+    uint32_t mask = 0;
+    for (const auto& channel : channels) {
+        if (channel->id < static_cast<uint8_t>(eSensorChannel::CHANNEL_MAX)) {
+            mask |= getSensorChannelBitmask(static_cast<eSensorChannel>(channel->id));
+        }
+    }
+    return mask;
+}
+
+void SessionPlayback::start(FrameSink frameSink) {
+    if (channels.empty() || worker.joinable()) return;
+    sink = std::move(frameSink);
+    dirty = true;  // first frame of every channel, paused
+    worker = std::thread([this]() { run(); });
+}
+
+void SessionPlayback::play() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (positionMs >= lastMs) {
+            positionMs = firstMs;
+            dirty = true;
+        }
+        running = true;
+    }
+    wake.notify_all();
+}
+
+void SessionPlayback::pause() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    wake.notify_all();
+}
+
+void SessionPlayback::setSpeed(double speed) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rate = std::min(kMaxSpeed, std::max(kMinSpeed, speed));
+        dirty = true;  // restart the clock from the current position at the new rate
+    }
+    wake.notify_all();
+}
+
+void SessionPlayback::seek(uint64_t timestampMs) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        positionMs = std::min(lastMs, std::max(firstMs, timestampMs));
+        dirty = true;
+    }
+    wake.notify_all();
+}
+
+void SessionPlayback::step(int direction) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        uint64_t current = positionMs;
+        bool found = false;
+        uint64_t target = current;
+        auto byTime = [](const SessionIndexEntry& entry, uint64_t t) { return entry.timestamp < t; };
+        for (const auto& channel : channels) {
+            const SessionIndexEntry* begin = channel->entries;
+            const SessionIndexEntry* end = begin + channel->count;
+            if (direction > 0) {
+                // First frame strictly after the playhead
+                const SessionIndexEntry* next = std::lower_bound(begin, end, current + 1, byTime);
+                if (next != end && (!found || next->timestamp < target)) {
+                    target = next->timestamp;
+                    found = true;
+                }
+            } else {
+                // Last frame strictly before it
+                const SessionIndexEntry* next = std::lower_bound(begin, end, current, byTime);
+                if (next != begin && (!found || (next - 1)->timestamp > target)) {
+                    target = (next - 1)->timestamp;
+                    found = true;
+                }
+            }
+        }
+        positionMs = target;
+        dirty = true;
+    }
+    wake.notify_all();
+}
+
+void SessionPlayback::run() {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point anchorWall = Clock::now();
+    uint64_t anchorMs = positionMs;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        if (dirty) {
+            dirty = false;
+            anchorWall = Clock::now();
+            anchorMs = positionMs;
+            lock.unlock();
+            show(anchorMs);
+            lock.lock();
+            continue;
+        }
+        if (!running) {
+            wake.wait(lock, [this]() { return stopping || dirty || running; });
+            anchorWall = Clock::now();
+            anchorMs = positionMs;
+            continue;
+        }
+
+        double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - anchorWall).count();
+        uint64_t playhead = anchorMs + static_cast<uint64_t>(elapsedMs * rate);
+        if (playhead >= lastMs) {
+            playhead = lastMs;
+            running = false;
+        }
+        positionMs = playhead;
+        lock.unlock();
+        show(playhead);
+        lock.lock();
+        wake.wait_for(lock, kTick, [this]() { return stopping || dirty || !running; });
+    }
+}
+
+size_t SessionPlayback::latestAt(const Channel& channel, uint64_t timestampMs) const {
+    const SessionIndexEntry* begin = channel.entries;
+    const SessionIndexEntry* end = begin + channel.count;
+    const SessionIndexEntry* after = std::upper_bound(begin, end, timestampMs,
+        [](uint64_t t, const SessionIndexEntry& entry) { return t < entry.timestamp; });
+    return after == begin ? SIZE_MAX : static_cast<size_t>(after - begin - 1);
+}
+
+void SessionPlayback::prefetch(const Channel& channel, size_t entry) const {
+    if (entry >= channel.count) return;
+    size_t end = std::min(channel.count, entry + kLookahead);
+    uint64_t from = channel.entries[entry].offset;
+    // Records are contiguous; a compressed one ends where the next begins
+    uint64_t to = end < channel.count ? channel.entries[end].offset : channel.data.size;
+    to = std::min<uint64_t>(to, channel.data.size);
+    if (from >= to) return;
+    uint64_t aligned = from / kPageSize * kPageSize;
+    madvise(const_cast<char*>(channel.data.data + aligned), to - aligned, MADV_WILLNEED);
+}
+
+void SessionPlayback::show(uint64_t playheadMs) {
+    struct Due {
+        Channel* channel;
+        SessionRecordHeader header;
+        const char* payload;  // mapped body, or the channel's decoded buffer
+    };
+    std::vector<Due> due;
+    std::vector<std::pair<size_t, const session::Block*>> blocks;  // due index, block
+    due.reserve(channels.size());
+    for (auto& channel : channels) {
+        size_t entry = latestAt(*channel, playheadMs);
+        if (entry == SIZE_MAX || entry == channel->shown) continue;
+        channel->shown = entry;
+        prefetch(*channel, entry + 1);
+
+        const SessionIndexEntry& index = channel->entries[entry];
+        if (index.offset + sizeof(SessionRecordHeader) > channel->data.size) continue;
+        SessionRecordHeader header;
+        memcpy(&header, channel->data.data + index.offset, sizeof(header));
+        const char* body = channel->data.data + index.offset + sizeof(header);
+        if (!session::validRecord(header) || header.sensor.mPayloadSize != index.payloadSize ||
+            session::storedBytes(header) > channel->data.size - index.offset - sizeof(header)) {
+            continue;
+        }
+        if (header.magic == session::kRecordMagic) {
+            due.push_back(Due{channel.get(), header, body});
+            continue;
+        }
+        if (!session::parseBlocks(body, header.storedSize, header.sensor.mPayloadSize, channel->blocks)) continue;
+        channel->decoded.resize(header.sensor.mPayloadSize);
+        for (const auto& block : channel->blocks) {
+            blocks.emplace_back(due.size(), &block);
+        }
+        due.push_back(Due{channel.get(), header, reinterpret_cast<const char*>(channel->decoded.data())});
+    }
+
+    // Blocks of all channels decompress together, so one large frame does not
+    // leave the other cores idle
+    std::vector<std::atomic<bool>> failed(due.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(blocks.size())), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            size_t owner = blocks[i].first;
+            if (!session::decodeBlock(*blocks[i].second, due[owner].channel->decoded.data())) {
+                failed[owner] = true;
+            }
+        }
+    });
+
+    // Channels convert independently, as they do when several streams arrive at once
+    cv::parallel_for_(cv::Range(0, static_cast<int>(due.size())), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            if (failed[i]) {
+                std::cerr << "[PLAYBACK] channel " << static_cast<int>(due[i].channel->id)
+                          << ": cannot decode record" << std::endl;
+                continue;
+            }
+            sink(due[i].payload, due[i].header.sensor);
+        }
+    });
+}
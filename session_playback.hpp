@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "messages.hpp"
+#include "session_file.hpp"
+
+// Replays a recorded session into the live tile pipeline. Data and index files
+// are memory-mapped; seeking is a binary search over each channel's index and
+// the pages of the next few frames are requested ahead with madvise. Every
+// tick shows only the newest due frame of each channel, so 16x playback skips
+// frames instead of queueing them. Compressed records are cut into their
+// blocks and every block of every due channel decodes in one parallel pass.
+class SessionPlayback {
+public:
+    using FrameSink = std::function<void(const char* payload, const stDataSensorReqMsg& sensor)>;
+
+    explicit SessionPlayback(const std::string& directory);
+    ~SessionPlayback();
+
+    bool ok() const { return !channels.empty(); }
+    uint32_t channelMask() const;  // the recorded channels
+    uint64_t startTime() const { return firstMs; }  // backend ms
+    uint64_t endTime() const { return lastMs; }
+    uint64_t position() const { return positionMs.load(std::memory_order_relaxed); }
+    bool playing() const { return running.load(std::memory_order_relaxed); }
+    double speed() const { return rate.load(std::memory_order_relaxed); }
+
+    void start(FrameSink sink);
+    void play();
+    void pause();
+    void setSpeed(double speed);
+    void seek(uint64_t timestampMs);
+    // Pauses and moves to the next (or previous) frame of any channel
+    void step(int direction);
+
+    SessionPlayback(const SessionPlayback&) = delete;
+    SessionPlayback& operator=(const SessionPlayback&) = delete;
+
+private:
+    struct MappedFile {
+        const char* data = nullptr;
+        size_t size = 0;
+
+        bool map(const std::string& path);
+        ~MappedFile();
+    };
+
+    struct Channel {
+        uint8_t id = 0;
+        MappedFile data;
+        MappedFile index;
+        const SessionIndexEntry* entries = nullptr;
+        size_t count = 0;
+        size_t shown = SIZE_MAX;  // entry currently on screen
+        std::vector<session::Block> blocks;  // of the record being shown, if compressed
+        std::vector<uint8_t> decoded;        // reused payload for compressed records
+    };
+
+    void run();
+    void show(uint64_t playheadMs);
+    size_t latestAt(const Channel& channel, uint64_t timestampMs) const;
+    void prefetch(const Channel& channel, size_t entry) const;
+
+    std::vector<std::unique_ptr<Channel>> channels;
+    uint64_t firstMs = 0;
+    uint64_t lastMs = 0;
+    FrameSink sink;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    bool dirty = false;  // position changed outside the clock; show it even while paused
+    std::atomic<uint64_t> positionMs{0};
+    std::atomic<bool> running{false};
+    std::atomic<double> rate{1.0};
+    std::thread worker;
+};
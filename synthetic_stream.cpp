@@ -0,0 +1,47 @@
+#include "synthetic_stream.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+std::string synthetic_stream::encodeHeader(uint8_t type, uint64_t sequence, uint32_t bodyLength, uint8_t result) {
+    std::string frame(sizeof(Protocol_Header), '\0');
+    uint64_t timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    memcpy(&frame[offsetof(Protocol_Header, timestamp)], &timestamp, sizeof(timestamp));
+    frame[offsetof(Protocol_Header, messageType)] = static_cast<char>(type);
+    memcpy(&frame[offsetof(Protocol_Header, sequenceNumber)], &sequence, sizeof(sequence));
+    memcpy(&frame[offsetof(Protocol_Header, bodyLength)], &bodyLength, sizeof(bodyLength));
+    frame[offsetof(Protocol_Header, mResult)] = static_cast<char>(result);
+    return frame;
+}
+
+std::string synthetic_stream::encodeDataRequest(uint64_t sequence, uint32_t channelMask,
+                                                const std::vector<stChannelRoi>& rois) {
+    uint32_t bodyLength = 8 + (rois.empty() ? 0 : 1 + rois.size() * kChannelRoiWireBytes);
+    std::string frame = encodeHeader(MessageType::DATA_SEND_REQUEST, sequence, bodyLength);
+    frame.push_back(static_cast<char>(eDataType::SENSOR));
+    frame.append(reinterpret_cast<const char*>(&channelMask), sizeof(channelMask));
+    frame.append(2, '\0');  // mServiceID, mNetworkID
+    if (!rois.empty()) {
+        frame.push_back(static_cast<char>(rois.size()));
+        for (const auto& roi : rois) {
+            frame.push_back(static_cast<char>(roi.mChannel));
+            for (uint16_t value : {roi.mX, roi.mY, roi.mWidth, roi.mHeight}) {
+                frame.append(reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+        }
+    }
+    if (frame.size() < kDataRequestFrameBytes) frame.resize(kDataRequestFrameBytes, '\0');
+    return frame;
+}
+
+std::string synthetic_stream::encodeSensorHead(uint64_t sequence, const stDataSensorReqMsg& sensor, uint8_t type,
+                                               uint32_t bodyLength) {
+    // mResult travels in the header and is the sensor message's first byte
+    const char* raw = reinterpret_cast<const char*>(&sensor);
+    std::string head = encodeHeader(type, sequence, bodyLength, static_cast<uint8_t>(raw[0]));
+    head.append(raw + 1, std::min<size_t>(sizeof(sensor), bodyLength) - 1);
+    head.resize(sizeof(Protocol_Header) + bodyLength - 1, '\0');
+    return head;
+}
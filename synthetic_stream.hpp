@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "messages.hpp"
+
+// Backend side of the wire format, for the harnesses that stand in for a
+// backend (protocol_soak, alloc_check).
+namespace synthetic_stream {
+    // Pixel formats the decoder accepts, with the depths it has kernels for
+    struct Format {
+        ePixelFormat format;
+        uint8_t depth;
+    };
+    constexpr std::array<Format, 9> kFormats{{
+        {ePixelFormat::UYVY, 8}, {ePixelFormat::YUYV, 8}, {ePixelFormat::NV12, 8},
+        {ePixelFormat::RGB888, 8}, {ePixelFormat::BGR888, 8}, {ePixelFormat::GRAY, 8},
+        {ePixelFormat::BAYER_RGGB, 8}, {ePixelFormat::BAYER_GRBG, 12}, {ePixelFormat::BAYER_BGGR, 16},
+    }};
+
+    // Written field by field; Protocol_Header has no usable constructor
+    std::string encodeHeader(uint8_t type, uint64_t sequence, uint32_t bodyLength, uint8_t result = 0);
+
+    // DATA_SEND_REQUEST as TcpClient sends it: 29 bytes of message plus any
+    // regions of interest, zero-padded
+    std::string encodeDataRequest(uint64_t sequence, uint32_t channelMask,
+                                  const std::vector<stChannelRoi>& rois = {});
+
+    // Header and body of a DATA_SENSOR message, up to where its payload starts.
+    // A bodyLength other than the sensor message's size truncates or zero-pads it.
+    std::string encodeSensorHead(uint64_t sequence, const stDataSensorReqMsg& sensor,
+                                 uint8_t type = MessageType::DATA_SENSOR,
+                                 uint32_t bodyLength = sizeof(stDataSensorReqMsg));
+}
@@ -1,10 +1,18 @@
 #include "tcp_client.hpp"
+#include "memory_governor.hpp"
+#include "trace.hpp"
+#include "frame_hash.hpp"
+#include "alloc_counter.hpp"
+#include "pixel_formats.hpp"
 #include <boost/asio.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <iomanip>
 #include <chrono>
 #include <ctime>
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
 
 using boost::asio::ip::tcp;
 using boost::system::error_code;
@@ -13,19 +21,125 @@ namespace {
     boost::asio::ip::address to_address(const std::string& host) {
         return boost::asio::ip::make_address(host);
     }
+
+    // CONTROL_APP_CHANNEL_POLICY: comma-separated target=policy entries, where a
+    // target is a channel number, camera, lidar, webcam or all, and a policy is
+    // drop, lower or pause. Later entries override earlier ones.
+    void applyChannelPolicies(const std::string& spec) {
+        std::istringstream entries(spec);
+        std::string entry;
+        while (std::getline(entries, entry, ',')) {
+            size_t equals = entry.find('=');
+            std::string target = entry.substr(0, equals);
+            std::string name = equals == std::string::npos ? "" : entry.substr(equals + 1);
+            BudgetPolicy policy;
+            if (name == "drop") policy = BudgetPolicy::DropOldest;
+            else if (name == "lower") policy = BudgetPolicy::LowerRate;
+            else if (name == "pause") policy = BudgetPolicy::PauseReads;
+            else {
+                std::cerr << "[GOVERNOR] ignoring channel policy '" << entry << "'" << std::endl;
+                continue;
+            }
+
+            uint32_t mask = 0;
+            for (const auto& sensor : sensor_channels::kTable) {
+                bool match = target == "all" ||
+                    (target == "camera" && sensor.kind == SensorKind::Camera) ||
+                    (target == "lidar" && sensor.kind == SensorKind::Lidar) ||
+                    (target == "webcam" && sensor.kind == SensorKind::Webcam) ||
+                    (!target.empty() && target.find_first_not_of("0123456789") == std::string::npos &&
+                     std::atoi(target.c_str()) == static_cast<int>(sensor.channel));
+                if (match) mask |= sensor.mask();
+            }
+            if (!mask) {
+                std::cerr << "[GOVERNOR] ignoring channel policy '" << entry << "'" << std::endl;
+                continue;
+            }
+            for (const auto& sensor : sensor_channels::kTable) {
+                if (mask & sensor.mask()) {
+                    MemoryGovernor::instance().setChannelPolicy(static_cast<uint8_t>(sensor.channel), policy);
+                }
+            }
+            std::cout << "[GOVERNOR] channel policy " << entry << std::endl;
+        }
+    }
 }
 
 TcpClient::TcpClient(ControlApp* app) : messageCounter(0),
     io_context(std::make_shared<boost::asio::io_context>()),
     controlApp(app) {
+    if (const char* interval = std::getenv("CONTROL_APP_HEARTBEAT_MS")) {
+        heartbeat.interval = std::chrono::milliseconds(std::max(10, std::atoi(interval)));
+    }
+    if (const char* misses = std::getenv("CONTROL_APP_HEARTBEAT_MISSES")) {
+        heartbeat.misses = static_cast<uint32_t>(std::max(1, std::atoi(misses)));
+    }
     initializeBackends();
+
+    // Reassembly buffers for the subscribed sensors exist before their first frame
+    for (const auto& sensor : sensor_channels::kTable) {
+        if (!(requestedChannels & sensor.mask())) continue;
+        size_t bytes = sensor.isImage()
+            ? expectedPayloadSize(static_cast<uint8_t>(sensor.format), sensor.depth, sensor.width, sensor.height)
+            : sensor.lidarPayloadBytes();
+        if (bytes > 0) payloadPool.reserve(bytes, sensor.poolFrames);
+    }
+    MemoryGovernor::instance().setRateLimiter([this](uint8_t channel, bool throttle) {
+        throttleChannel(channel, throttle);
+    });
+    if (const char* policies = std::getenv("CONTROL_APP_CHANNEL_POLICY")) {
+        applyChannelPolicies(policies);
+    }
+
+    if (const char* relayPort = std::getenv("CONTROL_APP_RELAY_PORT")) {
+        int basePort = std::atoi(relayPort);
+        for (size_t i = 0; i < backends.size() && basePort > 0; ++i) {
+            relays.push_back(std::make_unique<RelayServer>(*this, i, static_cast<uint16_t>(basePort + i), *io_context));
+            relays.back()->start();
+        }
+    }
+
+    // Frames are decoded inline on the io threads, so every connection gets a
+    // thread of its own: a paused stream or a long camera decode then occupies
+    // only its own, and no other stream's reads queue up behind it. Not capped
+    // at the core count; the OS shares the cores, the pool must not serialize.
+    workGuard = std::make_unique<WorkGuard>(io_context->get_executor());
+    size_t connections = backends.size() * (streamSpecs.size() + 1) + relays.size();  // data streams + control
+    size_t threadCount = std::max<size_t>(2, connections);
+    for (size_t i = 0; i < threadCount; ++i) {
+        ioThreads.emplace_back([this]() { io_context->run(); });
+    }
 }
 
 TcpClient::~TcpClient() {
+    MemoryGovernor::instance().setRateLimiter(nullptr);
+    abandonFanOuts();
+    // Readers paused for memory would otherwise hold up the joins below
+    MemoryGovernor::instance().shutdown();
+    // Stopped sessions close their sockets and timers, which lets run() return
     cleanupSockets();
+    for (auto& relay : relays) {
+        relay->stop();
+    }
+    workGuard.reset();
+    for (auto& thread : ioThreads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    // Sockets and strands must go before the io_context they belong to
+    relays.clear();
+    sessions.clear();
+    for (auto& backend : backends) {
+        backend.sockets = {};
+    }
 }
 
 void TcpClient::initializeBackends() {
+    for (auto& session : sessions) {
+        session->stop();
+    }
+    sessions.clear();
     backends.clear();
     backends.push_back(Backend{
         .host = "127.0.0.1",
@@ -41,59 +155,51 @@ void TcpClient::initializeBackends() {
         .ready = false,
         .sockets = {}
     });
+
+    telemetryRings.clear();
+    clockSyncs.clear();
+    linkHealth.clear();
+    for (size_t i = 0; i < backends.size(); ++i) {
+        telemetryRings.push_back(std::make_unique<TelemetryRing>());
+        clockSyncs.push_back(std::make_unique<ClockSync>());
+        linkHealth.push_back(std::make_unique<LinkHealth>());
+        sessions.push_back(std::make_shared<BackendSession>(*this, backends[i], i, *io_context));
+    }
 }
 
 void TcpClient::cleanupSockets() {
-    for (auto& backend : backends) {
-        for (auto& socket : backend.sockets) {
-            if (socket && socket->is_open()) {
-                try {
-                    socket->close();
-                } catch (const std::exception& e) {
-                    std::cerr << "Error closing socket: " << e.what() << std::endl;
-                }
-                socket = nullptr;
-            }
-        }
-        backend.ready = false;
+    for (auto& session : sessions) {
+        session->stop();
     }
+    sessionsStarted = false;
 }
 
 bool TcpClient::connectToServer() {
-    bool allConnected = true;
-
-    for (size_t i = 0; i < backends.size(); ++i) {
-        uint32_t prevCounter = messageCounter;
-        try {
-            backends[i].sockets[0] = std::make_shared<tcp::socket>(*io_context);
-            tcp::endpoint endpoint(to_address(backends[i].host), backends[i].ports[0]);
-            backends[i].sockets[0]->connect(endpoint);
-            backends[i].ready = true;
-        } catch (const std::exception& e) {
-            std::cerr << "Error with " << backends[i].name << ":" 
-                      << backends[i].ports[0] << ": " << e.what() << std::endl;
-            allConnected = false;
-            messageCounter = prevCounter;
-            continue;
+    if (!sessionsStarted) {
+        for (auto& session : sessions) {
+            session->start();
         }
+        sessionsStarted = true;
     }
 
-    if (allConnected) {
-        int idx = 0;
-        for (auto& backend : backends) {
-            try {
-                backend.sockets[1] = std::make_shared<tcp::socket>(*io_context);
-                tcp::endpoint endpoint(to_address(backend.host), backend.ports[1]);
-                backend.sockets[1]->connect(endpoint);
-                sendLoggingMessage(MessageType::CONFIG_INFO, backend, idx++);
-            } catch (const std::exception& e) {
-                std::cerr << "Error connecting to second port: " << e.what() << std::endl;
-            }
-        }
-        std::cout << "All backends connected successfully" << std::endl;
-    }
+    return std::all_of(sessions.begin(), sessions.end(), [](const auto& session) {
+        return session->state() == SessionState::Streaming;
+    });
+}
 
-    return allConnected;
+void TcpClient::reconfigureBackend(size_t idx, const std::string& host, uint16_t dataPort, uint16_t controlPort) {
+    backends[idx].host = host;
+    backends[idx].ports = {dataPort, controlPort};
+    sessions[idx]->reconfigure(host, dataPort, controlPort);
+}
+
+SessionState TcpClient::sessionState(size_t idx) const {
+    return sessions[idx]->state();
+}
+
+bool TcpClient::isStalled(uint8_t channel) const {
+    return channel < channelRepeats.size() &&
+           channelRepeats[channel].repeats.load(std::memory_order_relaxed) >= kStallRepeats;
 }
 
 Header TcpClient::setHeader(uint8_t messageType) {
@@ -102,7 +208,7 @@ Header TcpClient::setHeader(uint8_t messageType) {
         std::chrono::system_clock::now().time_since_epoch()
     ).count();
     header.messageType = messageType;
-    header.sequenceNumber = messageCounter++;
+    header.sequenceNumber = messageCounter.fetch_add(1);
     header.bodyLength = 1;
 
     if (messageType == MessageType::DATA_SEND_REQUEST) {
@@ -113,21 +219,21 @@ Header TcpClient::setHeader(uint8_t messageType) {
     return header;
 }
 
-void TcpClient::writeHeader(Backend& backend, MessageType msgType) {
-    char* headerBuffer = new char[22];
+std::string TcpClient::encodeHeader(MessageType msgType) {
+    std::string headerBuffer(sizeof(Protocol_Header), '\0');
     Header sendHeader = setHeader(msgType);
     int offset = 0;
 
-    memcpy(headerBuffer + offset, &sendHeader.timestamp, sizeof(sendHeader.timestamp));
+    memcpy(&headerBuffer[offset], &sendHeader.timestamp, sizeof(sendHeader.timestamp));
     offset += sizeof(sendHeader.timestamp);
-    memcpy(headerBuffer + offset, &sendHeader.messageType, sizeof(sendHeader.messageType));
+    memcpy(&headerBuffer[offset], &sendHeader.messageType, sizeof(sendHeader.messageType));
     offset += sizeof(sendHeader.messageType);
-    memcpy(headerBuffer + offset, &sendHeader.sequenceNumber, sizeof(sendHeader.sequenceNumber));
+    memcpy(&headerBuffer[offset], &sendHeader.sequenceNumber, sizeof(sendHeader.sequenceNumber));
     offset += sizeof(sendHeader.sequenceNumber);
-    memcpy(headerBuffer + offset, &sendHeader.bodyLength, sizeof(sendHeader.bodyLength));
+    memcpy(&headerBuffer[offset], &sendHeader.bodyLength, sizeof(sendHeader.bodyLength));
     offset += sizeof(sendHeader.bodyLength);
 
-    boost::asio::write(*backend.sockets[0], boost::asio::buffer(headerBuffer, 22));
+    return headerBuffer;
 }
 
 void TcpClient::parseHeader(char* headerBuffer, Header& header) {
@@ -142,109 +248,104 @@ void TcpClient::parseHeader(char* headerBuffer, Header& header) {
     offset += sizeof(header.bodyLength);
 }
 
-Protocol_Header TcpClient::getReceivedHeader(Backend& backend, int idx) {
-    // usleep(10000);
-    char* headerBuffer = new char[sizeof(Protocol_Header)];
-    int offset = 0;
-    auto executor = backend.sockets[0]->get_executor();
-    auto handler = [this, idx](const boost::system::error_code& error, std::size_t bytes_transferred) {
-        if (error) {
-            std::cerr << "Async read error: " << error.message() << std::endl;
-        }
-    };
+void TcpClient::throttleChannel(uint8_t channel, bool throttle) {
+    uint32_t mask = getSensorChannelBitmask(static_cast<eSensorChannel>(channel));
+    uint32_t previous = throttle ? throttledChannels.fetch_or(mask) : throttledChannels.fetch_and(~mask);
+    if (((previous & mask) != 0) == throttle) {
+        return;
+    }
 
-    boost::asio::async_read(*backend.sockets[0], boost::asio::buffer(headerBuffer, sizeof(Protocol_Header)),
-        boost::asio::bind_executor(executor, handler));
-    
-    Protocol_Header receivedHeader = *reinterpret_cast<Protocol_Header*>(headerBuffer);
-    std::cout << "============ Header Info =============" << std::endl;
-    std::cout << "Timestamp: " << receivedHeader.timestamp << std::endl;
-    std::cout << "Message Type: " << static_cast<int>(receivedHeader.messageType) << std::endl;
-    std::cout << "Sequence Number: " << receivedHeader.sequenceNumber << std::endl;
-    std::cout << "Body Length: " << receivedHeader.bodyLength << std::endl;
-    std::cout << "=======================================" << std::endl;
-    
-    return receivedHeader;
+    std::cout << (throttle ? "[GOVERNOR] throttling channel " : "[GOVERNOR] restoring channel ")
+              << static_cast<int>(channel) << std::endl;
+    for (auto& session : sessions) {
+        session->sendDataRequest();
+    }
 }
 
-char* TcpClient::receiveBody(Backend& backend, int idx, int bodyLength) {
-    auto executor = backend.sockets[0]->get_executor();
-    auto handler = [this](const boost::system::error_code& error, std::size_t bytes_transferred) {
-        if (error) {
-            std::cerr << "Async read error: " << error.message() << std::endl;
+void TcpClient::setChannelRois(std::vector<stChannelRoi> rois) {
+    {
+        std::lock_guard<std::mutex> lock(roiMutex);
+        auto same = [](const stChannelRoi& a, const stChannelRoi& b) {
+            return a.mChannel == b.mChannel && a.mX == b.mX && a.mY == b.mY &&
+                   a.mWidth == b.mWidth && a.mHeight == b.mHeight;
+        };
+        if (std::equal(rois.begin(), rois.end(), channelRois.begin(), channelRois.end(), same)) {
+            return;
         }
-    };
-    if (bodyLength - 1 > 0) {
-        char* bodyBuffer = new char[bodyLength - 1];
-        boost::asio::async_read(*backend.sockets[0], boost::asio::buffer(bodyBuffer, bodyLength - 1),
-            boost::asio::bind_executor(executor, handler));
-
-        std::cout << "============ Body Info =============" << std::endl;
-        std::cout << "Body: " << strlen(bodyBuffer) << std::endl;
-        std::cout << "====================================" << std::endl;
-
-        return bodyBuffer;
+        channelRois = std::move(rois);
     }
-    else {
-        char* bodyBuffer = new char[1];
-        bodyBuffer[0] = 0;
-        return bodyBuffer;
+    for (auto& session : sessions) {
+        session->sendDataRequest();
     }
 }
 
-bool TcpClient::setDataRequestMessage(stDataRequestMsg& msg, uint8_t messageType) {
+bool TcpClient::setDataRequestMessage(stDataRequestMsg& msg, uint8_t messageType, uint8_t dataType, uint32_t channelMask) {
     msg.header = setHeader(messageType);
     msg.mRequestStatus = 0;
-    msg.mDataType = 1;
-    msg.mSensorChannel = 524288;
+    msg.mDataType = dataType;
+    msg.mSensorChannel = requestedChannels & (channelMask ? channelMask : ~0u) & ~throttledChannels.load();
     msg.mServiceID = 0;
     msg.mNetworkID = 0;
 
+    msg.mRois.clear();
+    if (dataType == eDataType::SENSOR) {
+        std::lock_guard<std::mutex> lock(roiMutex);
+        for (const auto& roi : channelRois) {
+            if (msg.mSensorChannel >> roi.mChannel & 1u) {
+                msg.mRois.push_back(roi);
+            }
+        }
+    }
+    if (!msg.mRois.empty()) {
+        msg.header.bodyLength += 1 + msg.mRois.size() * kChannelRoiWireBytes;
+    }
+
     return true;
 }
 
-bool TcpClient::sendDataRequestMessage(Backend& backend, int idx) {
+std::string TcpClient::encodeDataRequest(uint8_t dataType, uint32_t channelMask) {
     stDataRequestMsg msg;
-    setDataRequestMessage(msg, MessageType::DATA_SEND_REQUEST);
-    char* headerBuffer = new char[sizeof(stDataRequestMsg)];
+    setDataRequestMessage(msg, MessageType::DATA_SEND_REQUEST, dataType, channelMask);
+    size_t requestBytes = sizeof(Protocol_Header) + msg.header.bodyLength - 1;  // mRequestStatus is in the header
+    // Requests have always gone out zero-padded; ROI entries extend them past the padding
+    std::string headerBuffer(std::max(kDataRequestFrameBytes, requestBytes), '\0');
     int offset = 0;
-    auto executor = backend.sockets[0]->get_executor();
-    auto handler = [this, idx](const boost::system::error_code& error, std::size_t bytes_transferred) {
-        if (error) {
-            std::cerr << "Async write error: " << error.message() << std::endl;
-        }
-    };
 
     auto header = msg.header;
 
-    memcpy(headerBuffer + offset, &header.timestamp, sizeof(header.timestamp));
+    memcpy(&headerBuffer[offset], &header.timestamp, sizeof(header.timestamp));
     offset += sizeof(header.timestamp);
-    memcpy(headerBuffer + offset, &header.messageType, sizeof(header.messageType));
+    memcpy(&headerBuffer[offset], &header.messageType, sizeof(header.messageType));
     offset += sizeof(header.messageType);
-    memcpy(headerBuffer + offset, &header.sequenceNumber, sizeof(header.sequenceNumber));
+    memcpy(&headerBuffer[offset], &header.sequenceNumber, sizeof(header.sequenceNumber));
     offset += sizeof(header.sequenceNumber);
-    memcpy(headerBuffer + offset, &header.bodyLength, sizeof(header.bodyLength));
+    memcpy(&headerBuffer[offset], &header.bodyLength, sizeof(header.bodyLength));
     offset += sizeof(header.bodyLength);
 
-    memcpy(headerBuffer + offset, &msg.mRequestStatus, sizeof(msg.mRequestStatus));
+    memcpy(&headerBuffer[offset], &msg.mRequestStatus, sizeof(msg.mRequestStatus));
     offset += sizeof(msg.mRequestStatus);
-    memcpy(headerBuffer + offset, &msg.mDataType, sizeof(msg.mDataType));
+    memcpy(&headerBuffer[offset], &msg.mDataType, sizeof(msg.mDataType));
     offset += sizeof(msg.mDataType);
-    memcpy(headerBuffer + offset, &msg.mSensorChannel, sizeof(msg.mSensorChannel));
+    memcpy(&headerBuffer[offset], &msg.mSensorChannel, sizeof(msg.mSensorChannel));
     offset += sizeof(msg.mSensorChannel);
-    memcpy(headerBuffer + offset, &msg.mServiceID, sizeof(msg.mServiceID));
+    memcpy(&headerBuffer[offset], &msg.mServiceID, sizeof(msg.mServiceID));
     offset += sizeof(msg.mServiceID);
-    memcpy(headerBuffer + offset, &msg.mNetworkID, sizeof(msg.mNetworkID));
+    memcpy(&headerBuffer[offset], &msg.mNetworkID, sizeof(msg.mNetworkID));
     offset += sizeof(msg.mNetworkID);
 
-    if (backend.ready && backend.sockets[0]->is_open()) {
-        auto& socket = backend.sockets[0];
-        boost::asio::async_write(*socket, boost::asio::buffer(headerBuffer, sizeof(stDataRequestMsg)),
-            boost::asio::bind_executor(executor, handler));
+    if (!msg.mRois.empty()) {
+        headerBuffer[offset++] = static_cast<char>(msg.mRois.size());
+        for (const auto& roi : msg.mRois) {
+            memcpy(&headerBuffer[offset], &roi.mChannel, sizeof(roi.mChannel));
+            offset += sizeof(roi.mChannel);
+            for (uint16_t value : {roi.mX, roi.mY, roi.mWidth, roi.mHeight}) {
+                memcpy(&headerBuffer[offset], &value, sizeof(value));
+                offset += sizeof(value);
+            }
+        }
     }
 
-    delete[] headerBuffer;
-    return true;
+    return headerBuffer;
 }
 
 bool TcpClient::setRecordConfigMessage(stDataRecordConfigMsg& msg, uint8_t messageType) {
@@ -275,207 +376,302 @@ bool TcpClient::setRecordConfigMessage(stDataRecordConfigMsg& msg, uint8_t messa
     return true;
 }
 
-bool TcpClient::sendLoggingMessage(uint8_t messageType, Backend& backend, int idx) {
+bool TcpClient::serializeLoggingMessage(uint8_t messageType, std::string& frame, uint64_t& sequenceNumber) {
     std::ostringstream archive_stream;
     boost::archive::text_oarchive archive(archive_stream);
-    int socketIdx = 1;
     stDataRecordConfigMsg msg;
     if (!setRecordConfigMessage(msg, messageType)) {
         return false;
     }
     archive << msg;
-    socketIdx = 1;
-    std::cout << "Socket index: " << socketIdx << std::endl;
+    sequenceNumber = msg.header.sequenceNumber;
 
     std::string outbound_data_ = archive_stream.str();
+    if (!frameControlMessage(outbound_data_, frame)) {
+        return false;
+    }
+
+    std::cout << "Outbound header: " << frame.substr(0, header_length) << std::endl;
+    std::cout << "Outbound data: " << outbound_data_ << std::endl;
+    return true;
+}
+
+// A bare Header, the same shape as the acks, and nothing echoed to stdout: it
+// goes out every heartbeat interval
+bool TcpClient::serializeHeartbeat(std::string& frame, uint64_t& sequenceNumber) {
+    std::ostringstream archive_stream;
+    boost::archive::text_oarchive archive(archive_stream);
+    Header header = setHeader(MessageType::LINK);
+    archive << header;
+    sequenceNumber = header.sequenceNumber;
+    return frameControlMessage(archive_stream.str(), frame);
+}
+
+bool TcpClient::frameControlMessage(const std::string& body, std::string& frame) {
     std::ostringstream header_stream;
-    header_stream << std::setw(header_length) << std::hex << outbound_data_.size();
+    header_stream << std::setw(header_length) << std::hex << body.size();
 
     if (!header_stream || header_stream.str().size() != header_length) {
         std::cerr << "Incorrect header length" << std::endl;
         return false;
     }
-    std::string outbound_header_ = header_stream.str();
 
-    std::cout << "Outbound header: " << outbound_header_ << std::endl;
-    std::cout << "Outbound data: " << outbound_data_ << std::endl;
-
-    if (backend.ready && backend.sockets[socketIdx]->is_open()) {
-        auto& socket = backend.sockets[socketIdx];
-        try {
-            auto executor = socket->get_executor();
-            auto handler = [this, &backend, idx](const boost::system::error_code& error, std::size_t bytes_transferred) {
-                if (error) {
-                    std::cerr << "Async write error: " << error.message() << std::endl;
-                } else {
-                    std::cout << "Async write completed: " << bytes_transferred << " bytes" << std::endl;
-                }
-            };
-
-            boost::asio::async_write(*socket, 
-                boost::asio::buffer(outbound_header_),
-                boost::asio::bind_executor(executor, handler));
+    frame = header_stream.str() + body;
+    return true;
+}
 
-            boost::asio::async_write(*socket, 
-                boost::asio::buffer(outbound_data_),
-                boost::asio::bind_executor(executor, handler));
+namespace {
+    using Clock = std::chrono::steady_clock;
 
-        } catch (const std::exception& e) {
-            std::cerr << "Error sending message: " << e.what() << std::endl;
-            socket = nullptr;
-            return false;
-        }
+    double elapsedMs(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
     }
-    else if (backend.ready) {
-        std::cerr << "Socket is closed" << std::endl;
-        backend.ready = false;
-        return false;
+}
+
+struct FanOutState {
+    std::mutex mutex;
+    uint8_t messageType = 0;
+    uint64_t sequenceNumber = 0;
+    Clock::time_point start;
+    std::vector<Clock::time_point> sentAt;
+    std::vector<Clock::time_point> ackedAt;
+    std::vector<bool> pending;
+    std::vector<bool> sent;
+    std::vector<bool> acked;
+    bool finished = false;
+    TcpClient::FanOutDone done;
+
+    bool settled() const { return std::none_of(pending.begin(), pending.end(), [](bool p) { return p; }); }
+};
+
+void TcpClient::broadcastLoggingMessage(uint8_t messageType, std::chrono::milliseconds deadline, FanOutDone done) {
+    auto state = std::make_shared<FanOutState>();
+    size_t count = backends.size();
+    state->messageType = messageType;
+    state->done = std::move(done);
+    state->sentAt.resize(count);
+    state->ackedAt.resize(count);
+    state->pending.assign(count, true);
+    state->sent.assign(count, false);
+    state->acked.assign(count, false);
+
+    // Serialized once; every backend gets the same bytes and sequence number
+    auto frame = std::make_shared<std::string>();
+    if (!serializeLoggingMessage(messageType, *frame, state->sequenceNumber)) {
+        state->pending.assign(count, false);
+        boost::asio::post(*io_context, [this, state]() { finishFanOut(state); });
+        return;
     }
-    else {
-        std::cerr << "Backend is not ready" << std::endl;
-        return false;
+    {
+        std::lock_guard<std::mutex> lock(fanOutMutex);
+        activeFanOuts.push_back(state);
     }
-    return true;
-} 
-
-void TcpClient::sendData() {
-    // TODO: Implement
-    while (true) {
-        if (sendStatus == 1) {
-            for (auto& backend : backends) {
-                writeHeader(backend, MessageType::LINK);
-                std::cout << "[SEND] LINK" << std::endl;
+
+    state->start = Clock::now();
+    // Backends that never answer are given up on here
+    auto timer = std::make_shared<boost::asio::steady_timer>(*io_context, deadline);
+    timer->async_wait([this, state, timer](const boost::system::error_code&) {
+        finishFanOut(state);
+    });
+    for (size_t i = 0; i < count; ++i) {
+        sessions[i]->sendCommand(frame, [this, state, i](bool ok) {
+            bool settled;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->sent[i] = ok;
+                state->sentAt[i] = Clock::now();
+                if (!ok) state->pending[i] = false;
+                settled = state->settled();
             }
-            sendStatus = 2;
-        }
-        else if (sendStatus == 3) {
-            for (auto& backend : backends) {
-                writeHeader(backend, MessageType::REC_INFO);
-                std::cout << "[SEND] REC_INFO" << std::endl;
+            if (settled) finishFanOut(state);
+        });
+    }
+}
+
+void TcpClient::finishFanOut(const std::shared_ptr<FanOutState>& state) {
+    {
+        std::lock_guard<std::mutex> lock(fanOutMutex);
+        activeFanOuts.erase(std::remove(activeFanOuts.begin(), activeFanOuts.end(), state), activeFanOuts.end());
+    }
+
+    size_t count = state->pending.size();
+    FanOutResult result;
+    result.sent.assign(count, false);
+    result.acked.assign(count, false);
+    result.sendLatencyMs.assign(count, 0.0);
+    result.ackLatencyMs.assign(count, 0.0);
+    {
+        // The last answer and the deadline may both get here; the first one reports
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->finished) return;
+        state->finished = true;
+
+        double firstSend = 0, lastSend = 0, firstAck = 0, lastAck = 0;
+        bool anySent = false, anyAcked = false;
+        for (size_t i = 0; i < count; ++i) {
+            if (state->sent[i]) {
+                double ms = elapsedMs(state->start, state->sentAt[i]);
+                result.sent[i] = true;
+                result.sendLatencyMs[i] = ms;
+                firstSend = anySent ? std::min(firstSend, ms) : ms;
+                lastSend = anySent ? std::max(lastSend, ms) : ms;
+                anySent = true;
             }
-            sendStatus = 4;
-        }
-        else if (sendStatus == 5) {
-            int idx = 0;
-            for (auto& backend : backends) {
-                sendDataRequestMessage(backend, idx++);
-                std::cout << "[SEND] DATA_SEND_REQUEST" << std::endl;
+            if (state->acked[i]) {
+                double ms = elapsedMs(state->start, state->ackedAt[i]);
+                result.acked[i] = true;
+                result.ackLatencyMs[i] = ms;
+                firstAck = anyAcked ? std::min(firstAck, ms) : ms;
+                lastAck = anyAcked ? std::max(lastAck, ms) : ms;
+                anyAcked = true;
             }
-            sendStatus = 6;
         }
+        result.sendSpreadMs = lastSend - firstSend;
+        result.ackSpreadMs = lastAck - firstAck;
     }
+
+    std::cout << "[FANOUT] type " << static_cast<int>(state->messageType)
+              << " sent " << std::count(result.sent.begin(), result.sent.end(), true) << "/" << count
+              << " acked " << std::count(result.acked.begin(), result.acked.end(), true) << "/" << count
+              << " send spread " << result.sendSpreadMs << " ms"
+              << " ack spread " << result.ackSpreadMs << " ms" << std::endl;
+    if (state->done) state->done(result);
 }
 
-std::vector<char*> TcpClient::receiveAll(Backend& backend, const size_t bufferSize, size_t recvSize) {
+void TcpClient::abandonFanOuts() {
+    // Commands still waiting for ACKs report to nobody; their owner is going away
+    std::lock_guard<std::mutex> lock(fanOutMutex);
+    for (auto& state : activeFanOuts) {
+        std::lock_guard<std::mutex> stateLock(state->mutex);
+        state->finished = true;
+    }
+    activeFanOuts.clear();
+}
 
-    auto executor = backend.sockets[0]->get_executor();
-    auto handler = [this](const boost::system::error_code& error, std::size_t bytes_transferred) {
-        if (error) {
-            std::cerr << "Async read error: " << error.message() << std::endl;
+void TcpClient::handleAck(size_t idx, uint64_t sequenceNumber) {
+    std::shared_ptr<FanOutState> state;
+    {
+        std::lock_guard<std::mutex> lock(fanOutMutex);
+        for (const auto& active : activeFanOuts) {
+            if (active->sequenceNumber == sequenceNumber) state = active;
         }
-    };
+    }
+    // ACKs for commands nobody waits for any more are ignored
+    if (!state) {
+        return;
+    }
+    bool settled;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->ackedAt[idx] = Clock::now();
+        state->acked[idx] = true;
+        state->pending[idx] = false;
+        settled = state->settled();
+    }
+    if (settled) finishFanOut(state);
+}
 
-    std::vector<char*> data;
-    char* part = new char[bufferSize];
+void TcpClient::dispatchFrame(size_t backendIdx, uint8_t dataType, ProtocolParser& parser) {
+    AllocCounter::FrameScope allocScope;
+    TraceSpan span("dispatch");
+    const auto& header = parser.header();
+    const auto& sensorMsg = parser.sensorMessage();
+    uint64_t traceId = Tracer::makeTraceId(header.timestamp, sensorMsg.mFrameNumber);
+    Tracer::setCurrentTraceId(traceId);
+    span.setTraceId(traceId);
+
+    // Small messages arrive in one piece, so their arrival minima track the clock;
+    // large payloads would add their transfer time to the one-way delay
+    FrameTiming timing;
+    timing.receivedNs = Tracer::now();
+    ClockSync& clock = *clockSyncs[backendIdx];
+    if (sensorMsg.mPayloadSize <= kMaxBodyLength) {
+        clock.addArrival(header.timestamp, timing.receivedNs);
+    }
+    ClockMapping mapping = clock.mapping();
+    if (mapping.valid) {
+        timing.sentNs = mapping.toLocal(header.timestamp);
+        timing.capturedNs = mapping.toLocal(sensorMsg.mTimestamp);
+    } else {
+        timing.sentNs = Tracer::instance().fromWallClockMs(header.timestamp);
+        timing.capturedNs = Tracer::instance().fromWallClockMs(sensorMsg.mTimestamp);
+    }
+    if (Tracer::enabled() && timing.sentNs < timing.receivedNs) {
+        // Backend send time to the end of our read
+        Tracer::instance().record("backend_to_read", traceId, timing.sentNs, timing.receivedNs);
+    }
 
-    while (true) {
+    auto payload = parser.takePayload();
+    if (!payload) {
+        return;  // dropped by the memory governor
+    }
 
-        if (recvSize - strlen(part) < bufferSize) {
-            boost::asio::async_read(*backend.sockets[0], boost::asio::buffer(part, recvSize - strlen(part) - 1),
-                boost::asio::bind_executor(executor, handler));
-            data.push_back(part);
-            break;
+    // A frozen camera resends the same bytes; the hash of the previous frame
+    // decides before anything downstream spends time on it
+    bool repeated = false;
+    if (sensorMsg.mSensorType == 1 && sensorMsg.mChannel < channelRepeats.size()) {
+        uint64_t hash;
+        {
+            TraceSpan hashSpan("hash", traceId);
+            hash = hashPayload(payload.get(), sensorMsg.mPayloadSize);
         }
-
-        boost::asio::async_read(*backend.sockets[0], boost::asio::buffer(part, bufferSize),
-            boost::asio::bind_executor(executor, handler));
-        data.push_back(part);
-
-        if (strlen(part) < bufferSize) {
-            break;
+        ChannelRepeat& repeat = channelRepeats[sensorMsg.mChannel];
+        repeated = repeat.lastHash.exchange(hash, std::memory_order_relaxed) == hash;
+        if (repeated) {
+            receiveStats.duplicates.fetch_add(1, std::memory_order_relaxed);
+            if (repeat.repeats.fetch_add(1, std::memory_order_relaxed) + 1 == kStallRepeats) {
+                std::cerr << "[STALL] channel " << static_cast<int>(sensorMsg.mChannel)
+                          << " repeating frame " << sensorMsg.mFrameNumber << std::endl;
+            }
+        } else if (repeat.repeats.exchange(0, std::memory_order_relaxed) >= kStallRepeats) {
+            std::cout << "[STALL] channel " << static_cast<int>(sensorMsg.mChannel) << " recovered" << std::endl;
         }
     }
 
-    return data;
-}
-
-void TcpClient::receiveData() {
-    while (true) {
-        if (sendStatus == 2) {
-            sleep(1);
-            int idx = 0;
-            auto flag = false;
-            std::cout << "[RECV] LINK_ACK" << std::endl;
-            for (auto& backend : backends) {
-                auto header = getReceivedHeader(backend, idx);
-                auto body = receiveBody(backend, idx++, header.bodyLength);
-                if (header.messageType == MessageType::LINK_ACK) {
-                    if (!flag) {
-                        flag = true;
-                    }
-                    else {
-                        sendStatus = 3;
-                    }
-                }
-            }
-            if (!flag) {
-                std::cerr << "Link ACK not received" << std::endl;
-                // sendStatus = 1;
-            }
-            else
-            {
-                sendStatus = 3;
-            }
+    // Relay clients and the recorder share the reassembly buffer; it is only
+    // converted when one of them wants the message
+    std::shared_ptr<const char[]> shared;
+    const char* data = payload.get();
+    auto share = [&]() {
+        if (!shared) shared = std::shared_ptr<const char[]>(std::move(payload));
+        return shared;
+    };
+    if (!relays.empty() && relays[backendIdx]->wants(dataType, sensorMsg.mChannel)) {
+        relays[backendIdx]->publish(parser, dataType, share());
+    }
+    if (sensorMsg.mSensorType == 1 && repeated) {
+        return;  // downstream viewers still get every frame; the tile already shows this one
+    }
+    if (sensorMsg.mSensorType == 1) {
+        if (auto activeRecorder = std::atomic_load(&recorder)) {
+            activeRecorder->record(sensorMsg, share());
         }
-        else if (sendStatus == 4) {
-            sleep(1);
-            std::cout << "[RECV] REC_INFO_ACK" << std::endl;
-            int offset = 7;
-            int idx = 0;
-            for (auto& backend : backends) {
-                auto header = getReceivedHeader(backend, idx);
-                auto body = receiveBody(backend, idx++, header.bodyLength);
-            }
-            sendStatus = 5;
+    }
+
+    if (sensorMsg.mSensorType >= 1 && sensorMsg.mSensorType <= 3) {
+        // Runs on an io thread, where nothing above would catch a decoder error;
+        // one bad frame must not take the whole app down
+        try {
+            controlApp->processData(data, sensorMsg, timing);
+        } catch (const std::exception& e) {
+            receiveStats.dropped.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "[DECODE] channel " << static_cast<int>(sensorMsg.mChannel)
+                      << ": frame " << sensorMsg.mFrameNumber << " dropped: " << e.what() << std::endl;
         }
-        else if (sendStatus == 6) {
-            usleep(500000);
-            std::cout << "[RECV] DATA_SENSOR" << std::endl;
-            int idx = 0;
-            for (auto& backend : backends) {
-                auto header = getReceivedHeader(backend, idx);
-                auto body = receiveBody(backend, idx++, header.bodyLength);
-
-                if (header.messageType == MessageType::DATA_SENSOR) {
-                    char* newBody = new char[header.bodyLength];
-                    memcpy(newBody, header.mResult, 1);
-                    memcpy(newBody + 1, body, header.bodyLength - 1);
-                    stDataSensorReqMsg* dataSensorReqMsg = reinterpret_cast<stDataSensorReqMsg*>(newBody);
-                    std::cout << "============ Data Sensor Request Message =============" << std::endl;
-                    std::cout << "Data Sensor Request Message: " << dataSensorReqMsg->mCurrentNumber << std::endl;
-                    std::cout << "Data Sensor Request Message: " << dataSensorReqMsg->mFrameNumber << std::endl;
-                    std::cout << "Data Sensor Request Message: " << dataSensorReqMsg->mTimestamp << std::endl;
-                    std::cout << "Data Sensor Request Message: " << dataSensorReqMsg->mSensorType << std::endl;
-                    std::cout << "Data Sensor Request Message: " << dataSensorReqMsg->mChannel << std::endl;
-                    std::cout << "Data Sensor Request Message: " << dataSensorReqMsg->mImgWidth << std::endl;
-                    std::cout << "Data Sensor Request Message: " << dataSensorReqMsg->mImgHeight << std::endl;
-                    std::cout << "Data Sensor Request Message: " << dataSensorReqMsg->mImgDepth << std::endl;
-                    std::cout << "Data Sensor Request Message: " << dataSensorReqMsg->mImgFormat << std::endl;
-                    std::cout << "Data Sensor Request Message: " << dataSensorReqMsg->mNumPoints << std::endl;
-                    std::cout << "Data Sensor Request Message: " << dataSensorReqMsg->mPayloadSize << std::endl;
-                    std::cout << "=========================================================" << std::endl;
-
-                    if (dataSensorReqMsg->mSensorType == 1) {
-                        auto image_buffer = receiveBody(backend, idx, dataSensorReqMsg->mPayloadSize);
-                        controlApp->processData(image_buffer, 1, dataSensorReqMsg->mImgWidth, dataSensorReqMsg->mImgHeight);
-                    }
-                    else if (dataSensorReqMsg->mSensorType == 2) {
-                        // TODO: Implement
-                    }
-                    
-                    
-                }
-            }
+    }
+    else if (sensorMsg.mSensorType == 4 || sensorMsg.mSensorType == 5) {
+        TelemetryRecord record{};
+        record.timestamp = sensorMsg.mTimestamp;
+        record.backend = static_cast<uint16_t>(backendIdx);
+        if (sensorMsg.mSensorType == 4) {
+            record.kind = TelemetryRecord::Resource;
+            memcpy(&record.resource, data, sizeof(record.resource));
+        } else {
+            record.kind = TelemetryRecord::Debug;
+            record.level = static_cast<uint8_t>(data[0]);
+            size_t length = std::min<size_t>(sensorMsg.mPayloadSize - 1, sizeof(record.text) - 1);
+            memcpy(record.text, data + 1, length);
         }
+        telemetryRings[backendIdx]->push(record);
     }
-}   
\ No newline at end of file
+}
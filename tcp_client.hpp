@@ -1,13 +1,45 @@
 #pragma once
 
 #include <vector>
+#include <array>
 #include <memory>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <thread>
 #include <boost/asio.hpp>
 #include "messages.hpp"
 #include "control_app.hpp"
+#include "frame_pool.hpp"
+#include "protocol_parser.hpp"
+#include "backend_session.hpp"
+#include "telemetry.hpp"
+#include "clock_sync.hpp"
+#include "relay_server.hpp"
+#include "session_file.hpp"
+#include "sensor_channels.hpp"
+#include "link_health.hpp"
 
 class ControlApp;
 struct Backend;
+struct FanOutState;
+
+// Outcome of one command sent to every backend, indexed like getBackends().
+// Latencies are measured from the moment the fan-out started.
+struct FanOutResult {
+    std::vector<bool> sent;
+    std::vector<bool> acked;
+    std::vector<double> sendLatencyMs;
+    std::vector<double> ackLatencyMs;
+    double sendSpreadMs = 0.0;
+    double ackSpreadMs = 0.0;
+
+    bool allSent() const { return !sent.empty() && std::all_of(sent.begin(), sent.end(), [](bool b) { return b; }); }
+    bool allAcked() const { return !acked.empty() && std::all_of(acked.begin(), acked.end(), [](bool b) { return b; }); }
+};
 
 class TcpClient {
 public:
@@ -17,25 +49,93 @@ public:
     void initializeBackends();
     void cleanupSockets();
     bool connectToServer();
-    bool sendLoggingMessage(uint8_t messageType, Backend& backend, int idx);
-    bool sendDataRequestMessage(Backend& backend, int idx);
-    Protocol_Header getReceivedHeader(Backend& backend, int idx);
-    void sendData();
-    void receiveData();
+    void reconfigureBackend(size_t idx, const std::string& host, uint16_t dataPort, uint16_t controlPort);
+    SessionState sessionState(size_t idx) const;
+    // Sends the command to every backend and returns at once. done runs on an io
+    // thread with the outcome, once every backend answered or the deadline passed.
+    using FanOutDone = std::function<void(const FanOutResult& result)>;
+    void broadcastLoggingMessage(uint8_t messageType, std::chrono::milliseconds deadline, FanOutDone done);
+    void throttleChannel(uint8_t channel, bool throttle);
+    // Camera channels to stream cut to a region; replaces the previous set and
+    // re-sends the data requests if it changed. Empty streams whole frames again.
+    void setChannelRois(std::vector<stChannelRoi> rois);
     std::vector<Backend>& getBackends() { return backends; }
     std::shared_ptr<boost::asio::io_context> getIoContext() { return io_context; }
+    const ReceiveStats& getReceiveStats() const { return receiveStats; }
+    const TelemetryRing& getTelemetry(size_t idx) const { return *telemetryRings[idx]; }
+    ClockSync& getClockSync(size_t idx) { return *clockSyncs[idx]; }
+    uint32_t getRequestedChannels() const { return requestedChannels; }
+    LinkHealth& getLinkHealth(size_t idx) { return *linkHealth[idx]; }
+    const HeartbeatConfig& getHeartbeatConfig() const { return heartbeat; }
+    // Camera frames go to the recorder while one is set; nullptr stops recording
+    void setRecorder(std::shared_ptr<SessionRecorder> next) { std::atomic_store(&recorder, std::move(next)); }
+    // True while a camera channel keeps sending the same image
+    bool isStalled(uint8_t channel) const;
+
+    // Called by BackendSession on its strand
+    std::string encodeHeader(MessageType msgType);
+    std::string encodeDataRequest(uint8_t dataType, uint32_t channelMask);
+    const std::vector<StreamSpec>& getStreamSpecs() const { return streamSpecs; }
+    bool serializeLoggingMessage(uint8_t messageType, std::string& frame, uint64_t& sequenceNumber);
+    bool serializeHeartbeat(std::string& frame, uint64_t& sequenceNumber);
+    void dispatchFrame(size_t backendIdx, uint8_t dataType, ProtocolParser& parser);
+    void handleAck(size_t idx, uint64_t sequenceNumber);
+    FramePool& getPayloadPool(bool latencySensitive) { return latencySensitive ? messagePool : payloadPool; }
+    ReceiveStats& getMutableReceiveStats() { return receiveStats; }
 
 private:
+    using WorkGuard = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+
     Header setHeader(uint8_t messageType);
-    void writeHeader(Backend& backend, MessageType msgType);
     void parseHeader(char* headerBuffer, Header& header);
-    bool setDataRequestMessage(stDataRequestMsg& msg, uint8_t messageType);
+    bool setDataRequestMessage(stDataRequestMsg& msg, uint8_t messageType, uint8_t dataType, uint32_t channelMask);
     bool setRecordConfigMessage(stDataRecordConfigMsg& msg, uint8_t messageType);
-    std::vector<char*> receiveAll(Backend& backend, const size_t bufferSize, size_t recvSize);
+    bool frameControlMessage(const std::string& body, std::string& frame);
 
     std::vector<Backend> backends;
     std::shared_ptr<boost::asio::io_context> io_context;
-    uint32_t messageCounter;
-    int sendStatus = 1;
+    std::atomic<uint32_t> messageCounter;
     ControlApp* controlApp;
-}; 
\ No newline at end of file
+
+    FramePool payloadPool{"reassembly", 128u << 20};
+    FramePool messagePool{"messages", 8u << 20};  // small streams never wait on camera payloads
+    ReceiveStats receiveStats;
+    std::vector<std::shared_ptr<BackendSession>> sessions;
+    bool sessionsStarted = false;
+    std::unique_ptr<WorkGuard> workGuard;
+    std::vector<std::thread> ioThreads;
+
+    void finishFanOut(const std::shared_ptr<FanOutState>& state);
+    void abandonFanOuts();
+
+    std::mutex fanOutMutex;
+    std::vector<std::shared_ptr<FanOutState>> activeFanOuts;  // awaiting ACKs, matched by sequence number
+
+    uint32_t requestedChannels = sensor_channels::mask<eSensorChannel::LIDAR_ROOF_CENTER>();
+    // One data connection each; the first carries the session handshake state
+    std::vector<StreamSpec> streamSpecs{
+        {eDataType::SENSOR, 0, false, "sensor"},
+        {eDataType::RECONGITION_RESULT, 0, true, "recognition"},
+        {eDataType::RESOURCE_INFO, 0, true, "resource"},
+        {eDataType::DEBUG_MESSAGE, 0, true, "debug"},
+    };
+    std::vector<std::unique_ptr<TelemetryRing>> telemetryRings;
+    std::vector<std::unique_ptr<ClockSync>> clockSyncs;
+    std::vector<std::unique_ptr<LinkHealth>> linkHealth;
+    HeartbeatConfig heartbeat;  // CONTROL_APP_HEARTBEAT_MS / CONTROL_APP_HEARTBEAT_MISSES
+    std::atomic<uint32_t> throttledChannels{0};
+    std::mutex roiMutex;
+    std::vector<stChannelRoi> channelRois;
+    // One per backend when CONTROL_APP_RELAY_PORT is set; backend i is served on that port + i
+    std::vector<std::unique_ptr<RelayServer>> relays;
+    std::shared_ptr<SessionRecorder> recorder;  // std::atomic_load/store only
+
+    // Payload hash of the last camera frame per channel; identical frames are
+    // counted instead of converted, painted and recorded again
+    struct ChannelRepeat {
+        std::atomic<uint64_t> lastHash{0};
+        std::atomic<uint32_t> repeats{0};
+    };
+    static constexpr uint32_t kStallRepeats = 15;  // about half a second at 30 fps
+    std::array<ChannelRepeat, static_cast<size_t>(eSensorChannel::CHANNEL_MAX)> channelRepeats;
+};
@@ -0,0 +1,43 @@
+#include "telemetry.hpp"
+#include <cstring>
+
+void TelemetryRing::push(const TelemetryRecord& record) {
+    uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = entries[index % kCapacity];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.record, &record, sizeof(record));
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+size_t TelemetryRing::drain(uint64_t& cursor, std::vector<TelemetryRecord>& out) const {
+    uint64_t end = head.load(std::memory_order_acquire);
+    size_t lost = 0;
+    if (end - cursor > kCapacity) {
+        lost = end - kCapacity - cursor;
+        cursor = end - kCapacity;
+    }
+
+    for (; cursor < end; ++cursor) {
+        const Slot& slot = entries[cursor % kCapacity];
+        uint64_t published = 2 * cursor + 2;
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before < published) {
+            break;  // claimed but not yet written; pick it up next time
+        }
+        if (before > published) {
+            ++lost;
+            continue;
+        }
+
+        TelemetryRecord copy;
+        std::memcpy(&copy, &slot.record, sizeof(copy));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != published) {
+            ++lost;
+            continue;
+        }
+        out.push_back(copy);
+    }
+    return lost;
+}
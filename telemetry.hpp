@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "messages.hpp"
+
+// One parsed RESOURCE_INFO or DEBUG_MESSAGE record.
+struct TelemetryRecord {
+    enum Kind : uint8_t { Resource, Debug };
+
+    uint64_t timestamp;  // backend wall clock, ms
+    uint16_t backend;
+    uint8_t kind;
+    uint8_t level;       // debug severity: 0 info, 1 warning, 2 error
+    stResourceInfo resource;
+    char text[128];      // NUL-terminated, truncated
+};
+
+// Fixed-size ring of one backend's telemetry. Writers (the backend's stream
+// strands) claim a slot with one fetch_add and publish it through a per-slot
+// sequence number; the GUI reader copies slots without locking and skips
+// whatever was overwritten before it got there.
+class TelemetryRing {
+public:
+    static constexpr size_t kCapacity = 1024;
+
+    void push(const TelemetryRecord& record);
+
+    // Appends every record published after cursor and advances it.
+    // Returns how many records were overwritten before they could be read.
+    size_t drain(uint64_t& cursor, std::vector<TelemetryRecord>& out) const;
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};  // 2n+1 while record n is written, 2n+2 once published
+        TelemetryRecord record;
+    };
+
+    std::atomic<uint64_t> head{0};
+    std::array<Slot, kCapacity> entries;
+};
@@ -0,0 +1,132 @@
+#include "telemetry_panel.hpp"
+#include "tcp_client.hpp"
+#include <QDateTime>
+#include <QScrollBar>
+#include <QVBoxLayout>
+
+namespace {
+    constexpr int kPollIntervalMs = 200;
+
+    QString formatResource(const stResourceInfo& info) {
+        return QString("CPU %1% | MEM %2 MB | DISK %3 GB | %4 C | dropped %5")
+            .arg(info.mCpuLoad, 0, 'f', 0)
+            .arg(info.mMemoryUsedMB, 0, 'f', 0)
+            .arg(info.mDiskFreeGB, 0, 'f', 1)
+            .arg(info.mTemperature, 0, 'f', 0)
+            .arg(info.mDroppedFrames);
+    }
+}
+
+TelemetryModel::TelemetryModel(std::vector<QString> backendNames, QObject* parent) :
+    QAbstractListModel(parent), backendNames(std::move(backendNames)) {
+}
+
+int TelemetryModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(rows.size());
+}
+
+QVariant TelemetryModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= static_cast<int>(rows.size())) {
+        return QVariant();
+    }
+    const TelemetryRecord& record = rows[index.row()];
+
+    if (role == Qt::ForegroundRole) {
+        if (record.kind == TelemetryRecord::Debug && record.level == 1) return QColor("orange");
+        if (record.kind == TelemetryRecord::Debug && record.level >= 2) return QColor(Qt::red);
+        return QVariant();
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    QString time = QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(record.timestamp)).toString("HH:mm:ss.zzz");
+    QString backend = record.backend < backendNames.size() ? backendNames[record.backend] : QString("?");
+    if (record.kind == TelemetryRecord::Resource) {
+        return QString("%1 %2  %3").arg(time).arg(backend).arg(formatResource(record.resource));
+    }
+    static const char* levels[] = {"INFO", "WARN", "ERROR"};
+    return QString("%1 %2  %3 %4").arg(time).arg(backend)
+        .arg(levels[std::min<int>(record.level, 2)]).arg(QString::fromUtf8(record.text));
+}
+
+void TelemetryModel::append(const std::vector<TelemetryRecord>& records) {
+    if (records.empty()) return;
+
+    size_t incoming = std::min<size_t>(records.size(), kMaxRows);
+    size_t overflow = rows.size() + incoming > kMaxRows ? rows.size() + incoming - kMaxRows : 0;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, static_cast<int>(overflow) - 1);
+        rows.erase(rows.begin(), rows.begin() + overflow);
+        endRemoveRows();
+    }
+
+    int first = static_cast<int>(rows.size());
+    beginInsertRows(QModelIndex(), first, first + static_cast<int>(incoming) - 1);
+    rows.insert(rows.end(), records.end() - incoming, records.end());
+    endInsertRows();
+}
+
+TelemetryPanel::TelemetryPanel(TcpClient& client, QWidget* parent) :
+    QWidget(parent), client(client) {
+    const auto& backends = client.getBackends();
+    std::vector<QString> names;
+    for (const auto& backend : backends) {
+        names.push_back(QString::fromStdString(backend.name));
+    }
+    cursors.assign(backends.size(), 0);
+    latestResource.assign(backends.size(), QString("-"));
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    resourceLabel = new QLabel("Resources: -", this);
+    resourceLabel->setProperty("role", "detail");
+    layout->addWidget(resourceLabel);
+
+    // Uniform rows let the view lay out and paint only what is on screen
+    model = new TelemetryModel(std::move(names), this);
+    view = new QListView(this);
+    view->setModel(model);
+    view->setUniformItemSizes(true);
+    view->setLayoutMode(QListView::Batched);
+    view->setBatchSize(200);
+    view->setMinimumHeight(160);
+    layout->addWidget(view);
+
+    pollTimer = new QTimer(this);
+    connect(pollTimer, &QTimer::timeout, this, &TelemetryPanel::poll);
+    pollTimer->start(kPollIntervalMs);
+}
+
+void TelemetryPanel::poll() {
+    pending.clear();
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        size_t first = pending.size();
+        lostRecords += client.getTelemetry(i).drain(cursors[i], pending);
+        for (size_t j = first; j < pending.size(); ++j) {
+            if (pending[j].kind == TelemetryRecord::Resource) {
+                latestResource[i] = formatResource(pending[j].resource);
+            }
+        }
+    }
+    if (pending.empty()) return;
+
+    QScrollBar* scrollBar = view->verticalScrollBar();
+    bool following = scrollBar->value() == scrollBar->maximum();
+    model->append(pending);
+    if (following) {
+        view->scrollToBottom();
+    }
+
+    const auto& backends = client.getBackends();
+    QString summary;
+    for (size_t i = 0; i < latestResource.size(); ++i) {
+        if (i > 0) summary += QString("    ");
+        summary += QString::fromStdString(backends[i].name) + QString(": ") + latestResource[i];
+    }
+    if (lostRecords > 0) {
+        summary += QString("    (%1 records lost)").arg(static_cast<unsigned long long>(lostRecords));
+    }
+    resourceLabel->setText(summary);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QLabel>
+#include <QListView>
+#include <QTimer>
+#include <QWidget>
+#include <deque>
+#include <vector>
+#include "telemetry.hpp"
+
+class TcpClient;
+
+// Rows of backend telemetry, formatted only when the view asks for a visible row.
+class TelemetryModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    static constexpr int kMaxRows = 5000;
+
+    explicit TelemetryModel(std::vector<QString> backendNames, QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    void append(const std::vector<TelemetryRecord>& records);
+
+private:
+    std::vector<QString> backendNames;
+    std::deque<TelemetryRecord> rows;
+};
+
+// RESOURCE_INFO / DEBUG_MESSAGE log of every backend. Polls the per-backend
+// rings on a timer, so bursts of debug output cost one model update per tick.
+class TelemetryPanel : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit TelemetryPanel(TcpClient& client, QWidget* parent = nullptr);
+
+private slots:
+    void poll();
+
+private:
+    TcpClient& client;
+    TelemetryModel* model;
+    QListView* view;
+    QLabel* resourceLabel;
+    QTimer* pollTimer;
+    std::vector<uint64_t> cursors;
+    std::vector<TelemetryRecord> pending;
+    std::vector<QString> latestResource;
+    size_t lostRecords = 0;
+};
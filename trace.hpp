@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Optional per-frame tracing. Spans go to per-thread rings without locks and are
+// flushed as Chrome trace JSON (chrome://tracing, ui.perfetto.dev) on demand.
+// While disabled a span costs one relaxed atomic load.
+class Tracer {
+public:
+    struct Event {
+        const char* name;   // must be a string literal
+        uint64_t traceId;
+        uint64_t beginNs;
+        uint64_t endNs;
+    };
+
+    static Tracer& instance();
+
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+    void setEnabled(bool on);
+
+    static uint64_t now();
+    // Maps a backend wall-clock timestamp (ms since epoch) onto the trace clock.
+    uint64_t fromWallClockMs(uint64_t ms) const;
+    int64_t wallClockOffsetNs() const { return wallOffsetNs; }
+
+    static uint64_t makeTraceId(uint64_t headerTimestamp, uint32_t frameNumber) {
+        return (headerTimestamp << 20) ^ frameNumber;
+    }
+    static void setCurrentTraceId(uint64_t id) { currentTraceId = id; }
+    static uint64_t currentId() { return currentTraceId; }
+
+    void record(const char* name, uint64_t traceId, uint64_t beginNs, uint64_t endNs);
+    bool flush(const std::string& path);
+
+private:
+    static constexpr size_t kRingSize = 1 << 16;
+
+    struct ThreadRing {
+        uint32_t tid;
+        std::atomic<uint64_t> head{0};
+        std::array<Event, kRingSize> events;
+    };
+
+    Tracer();
+    ThreadRing* ring();
+
+    static std::atomic<bool> active;
+    static thread_local uint64_t currentTraceId;
+
+    std::mutex ringsMutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    int64_t wallOffsetNs;
+};
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, uint64_t traceId = Tracer::currentId()) :
+        name(name), traceId(traceId), beginNs(Tracer::enabled() ? Tracer::now() : 0) {}
+    ~TraceSpan() { end(); }
+
+    void setTraceId(uint64_t id) { traceId = id; }
+    void end() {
+        if (beginNs && Tracer::enabled()) {
+            Tracer::instance().record(name, traceId, beginNs, Tracer::now());
+        }
+        beginNs = 0;
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    uint64_t traceId;
+    uint64_t beginNs;
+};
@@ -0,0 +1,283 @@
+#include "video_export.hpp"
+#include "pixel_formats.hpp"
+#include "session_file.hpp"
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <opencv2/opencv.hpp>
+
+namespace {
+    constexpr size_t kDepth = 4;  // frames in flight between two stages of one channel
+
+    template <typename T>
+    class BoundedQueue {
+    public:
+        // False once closed
+        bool push(T item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this]() { return closed || items.size() < kDepth; });
+            if (closed) return false;
+            items.push_back(item);
+            notEmpty.notify_one();
+            return true;
+        }
+
+        // False once closed and drained
+        bool pop(T& item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+            if (items.empty()) return false;
+            item = items.front();
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            notEmpty.notify_all();
+            notFull.notify_all();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+        std::deque<T> items;
+        bool closed = false;
+    };
+
+    struct RawFrame {
+        SessionRecordHeader header;
+        std::vector<uint8_t> payload;
+    };
+
+    // Frame rate from the index timestamps; the container needs one up front
+    double estimateFps(const std::vector<SessionIndexEntry>& index) {
+        if (index.size() < 2 || index.back().timestamp <= index.front().timestamp) return 30.0;
+        double fps = (index.size() - 1) * 1000.0 / (index.back().timestamp - index.front().timestamp);
+        return std::min(120.0, std::max(1.0, fps));
+    }
+}
+
+// Frames circulate between a free and a ready queue per stage boundary, so a
+// channel reuses the same kDepth payload buffers and BGR images for the whole export.
+struct VideoExporter::Channel {
+    uint8_t id = 0;
+    uint64_t total = 0;
+    double fps = 30.0;
+    std::atomic<uint64_t> done{0};
+    std::atomic<bool> finished{false};
+
+    std::array<RawFrame, kDepth> raws;
+    std::array<cv::Mat, kDepth> images;
+    BoundedQueue<RawFrame*> freeRaw;
+    BoundedQueue<RawFrame*> readyRaw;
+    BoundedQueue<cv::Mat*> freeImage;
+    BoundedQueue<cv::Mat*> readyImage;
+
+    std::thread reader;
+    std::thread converter;
+    std::thread encoder;
+
+    void shutdown() {
+        freeRaw.close();
+        readyRaw.close();
+        freeImage.close();
+        readyImage.close();
+    }
+};
+
+VideoExporter::VideoExporter(const std::string& sessionDirectory, const std::string& outputDirectory) :
+    sessionDir(sessionDirectory), outputDir(outputDirectory) {
+}
+
+VideoExporter::~VideoExporter() {
+    cancel();
+    for (auto& channel : channels) {
+        if (channel->reader.joinable()) channel->reader.join();
+        if (channel->converter.joinable()) channel->converter.join();
+        if (channel->encoder.joinable()) channel->encoder.join();
+    }
+}
+
+bool VideoExporter::start() {
+    std::error_code error;
+    std::filesystem::create_directories(outputDir, error);
+    if (error) {
+        fail("cannot create " + outputDir + ": " + error.message());
+        return false;
+    }
+
+    for (uint8_t id : session::recordedChannels(sessionDir)) {
+        auto channel = std::make_unique<Channel>();
+        channel->id = id;
+        std::vector<SessionIndexEntry> index;
+        if (FILE* file = std::fopen(session::indexPath(sessionDir, id).c_str(), "rb")) {
+            SessionIndexEntry entry;
+            while (std::fread(&entry, sizeof(entry), 1, file) == 1) {
+                index.push_back(entry);
+            }
+            std::fclose(file);
+        }
+        channel->total = index.size();
+        channel->fps = estimateFps(index);
+        channels.push_back(std::move(channel));
+    }
+    if (channels.empty()) {
+        fail("no recorded channels in " + sessionDir);
+        return false;
+    }
+
+    started = std::chrono::steady_clock::now();
+    for (auto& owned : channels) {
+        Channel* channel = owned.get();
+        for (size_t i = 0; i < kDepth; ++i) {
+            channel->freeRaw.push(&channel->raws[i]);
+            channel->freeImage.push(&channel->images[i]);
+        }
+
+        channel->reader = std::thread([this, channel]() {
+            FILE* file = std::fopen(session::dataPath(sessionDir, channel->id).c_str(), "rb");
+            if (!file) {
+                fail("cannot open channel " + std::to_string(channel->id));
+                channel->shutdown();
+                return;
+            }
+            RawFrame* frame;
+            std::vector<char> stored;  // compressed body, reused
+            while (!cancelled && channel->freeRaw.pop(frame)) {
+                if (std::fread(&frame->header, sizeof(frame->header), 1, file) != 1 ||
+                    !session::validRecord(frame->header)) {
+                    break;  // end of file, or a torn last record
+                }
+                frame->payload.resize(frame->header.sensor.mPayloadSize);
+                if (frame->header.magic == session::kRecordMagic) {
+                    if (std::fread(frame->payload.data(), 1, frame->payload.size(), file) != frame->payload.size()) {
+                        break;
+                    }
+                } else {
+                    stored.resize(frame->header.storedSize);
+                    if (std::fread(stored.data(), 1, stored.size(), file) != stored.size()) {
+                        break;
+                    }
+                    if (!session::decodePayload(frame->header, stored.data(), frame->payload.data())) {
+                        fail("channel " + std::to_string(channel->id) + ": cannot decode record");
+                        break;
+                    }
+                }
+                if (!channel->readyRaw.push(frame)) {
+                    break;
+                }
+            }
+            std::fclose(file);
+            channel->readyRaw.close();
+        });
+
+        channel->converter = std::thread([this, channel]() {
+            const PixelKernel* kernel = nullptr;
+            RawFrame* frame;
+            cv::Mat* image;
+            while (channel->readyRaw.pop(frame)) {
+                const stDataSensorReqMsg& sensor = frame->header.sensor;
+                if (!kernel || static_cast<uint8_t>(kernel->format) != sensor.mImgFormat ||
+                    kernel->depth != sensor.mImgDepth) {
+                    kernel = findPixelKernel(sensor.mImgFormat, sensor.mImgDepth);
+                }
+                if (!kernel || frame->payload.size() < kernel->payloadSize(sensor.mImgWidth, sensor.mImgHeight)) {
+                    fail("channel " + std::to_string(channel->id) + ": unsupported frame");
+                    channel->shutdown();
+                    return;
+                }
+                if (!channel->freeImage.pop(image)) break;
+                kernel->convert(frame->payload.data(), sensor.mImgWidth, sensor.mImgHeight, *image);
+                channel->freeRaw.push(frame);
+                if (!channel->readyImage.push(image)) break;
+            }
+            channel->readyImage.close();
+        });
+
+        channel->encoder = std::thread([this, channel]() {
+            std::string path = (std::filesystem::path(outputDir) /
+                ("channel_" + std::to_string(channel->id) + ".avi")).string();
+            cv::VideoWriter writer;
+            cv::Size size;
+            cv::Mat resized;
+            cv::Mat* image;
+            while (channel->readyImage.pop(image)) {
+                if (!writer.isOpened()) {
+                    size = image->size();
+                    if (!writer.open(path, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), channel->fps, size)) {
+                        fail("cannot write " + path);
+                        channel->shutdown();
+                        break;
+                    }
+                }
+                // A container has one frame size; later geometry changes are scaled to it
+                if (image->size() != size) {
+                    cv::resize(*image, resized, size);
+                    writer.write(resized);
+                } else {
+                    writer.write(*image);
+                }
+                channel->freeImage.push(image);
+                channel->done.fetch_add(1, std::memory_order_relaxed);
+            }
+            writer.release();
+            channel->finished = true;
+
+            bool all = true;
+            for (const auto& other : channels) {
+                all = all && other->finished;
+            }
+            if (all) {
+                finishedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - started).count();
+                std::cout << "[EXPORT] " << sessionDir << " -> " << outputDir << " done" << std::endl;
+            }
+        });
+    }
+    std::cout << "[EXPORT] " << channels.size() << " channels from " << sessionDir << std::endl;
+    return true;
+}
+
+void VideoExporter::cancel() {
+    cancelled = true;
+    for (auto& channel : channels) {
+        channel->shutdown();
+    }
+}
+
+ExportProgress VideoExporter::progress() const {
+    ExportProgress result;
+    result.channels = channels.size();
+    for (const auto& channel : channels) {
+        result.framesDone += channel->done.load(std::memory_order_relaxed);
+        result.framesTotal += channel->total;
+        result.channelsDone += channel->finished ? 1 : 0;
+    }
+    result.finished = !channels.empty() && result.channelsDone == channels.size();
+    int64_t elapsedNs = finishedNs.load();
+    if (elapsedNs == 0 && !channels.empty()) {
+        elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - started).count();
+    }
+    result.seconds = elapsedNs / 1e9;
+
+    std::lock_guard<std::mutex> lock(errorMutex);
+    result.error = firstError;
+    return result;
+}
+
+void VideoExporter::fail(const std::string& message) {
+    std::cerr << "[EXPORT] " << message << std::endl;
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (firstError.empty()) {
+        firstError = message;
+    }
+}
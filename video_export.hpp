@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ExportProgress {
+    size_t channels = 0;
+    size_t channelsDone = 0;
+    uint64_t framesDone = 0;
+    uint64_t framesTotal = 0;
+    double seconds = 0.0;
+    bool finished = false;
+    std::string error;  // first failure, if any
+
+    double framesPerSecond() const { return seconds > 0.0 ? framesDone / seconds : 0.0; }
+};
+
+// Turns every recorded camera channel of a session into its own video file.
+// Each channel runs a read -> convert -> encode pipeline on three threads
+// joined by small bounded queues, and channels run side by side, so an export
+// scales with cores instead of working through the channels one at a time.
+class VideoExporter {
+public:
+    VideoExporter(const std::string& sessionDirectory, const std::string& outputDirectory);
+    ~VideoExporter();
+
+    // False if the session has no camera channels or the output cannot be created
+    bool start();
+    void cancel();
+    ExportProgress progress() const;
+
+    VideoExporter(const VideoExporter&) = delete;
+    VideoExporter& operator=(const VideoExporter&) = delete;
+
+private:
+    struct Channel;
+
+    void fail(const std::string& message);
+
+    std::string sessionDir;
+    std::string outputDir;
+    std::vector<std::unique_ptr<Channel>> channels;
+    std::chrono::steady_clock::time_point started;
+    std::atomic<int64_t> finishedNs{0};
+    std::atomic<bool> cancelled{false};
+
+    mutable std::mutex errorMutex;
+    std::string firstError;
+};